@@ -152,6 +152,9 @@ fun propBool(name: String, default: Boolean = false): Boolean =
 val testInputs = providers.gradleProperty("testInputs").orNull ?: testProps.getProperty("testInputs")!!
 val testExpectedOutputs = providers.gradleProperty("testExpectedOutputs").orNull ?: testProps.getProperty("testExpectedOutputs")!!
 
+// The golden model kernel-test can check the kernel against instead (see kernel-test/util/reference.h)
+val testReferenceModel: String? = testProps.getProperty("referenceModel")?.trim()
+
 val retime = propBool("retime", true)
 
 // GAPL: this is the only value a person should ever need to edit to change clk_200's speed. It's
@@ -957,6 +960,60 @@ val kernelTestHeaders = fileTree(kernelTestDir) {
 val verilatorKernelOutDir = layout.buildDirectory.dir("verilator/kernel-test")
 val verilatorKernelExe = verilatorKernelOutDir.map { it.asFile.resolve("kernel_test") }
 
+// Verilator's multithreaded model: -PverilatorThreads=<n> simulates on n threads (Verilator's own
+// default is 1), and -PverilatorTraceThreads=<n> moves waveform writing onto threads of its own
+// (which Verilator only supports for FST). Read at execution time, so -P... works reliably.
+fun verilatorThreadsProp(): String? = providers.gradleProperty("verilatorThreads").orNull?.trim()
+fun verilatorTraceThreadsProp(): String? = providers.gradleProperty("verilatorTraceThreads").orNull?.trim()
+
+// Waveform format: -PverilatorTraceFormat=vcd (the default) or fst (compressed, and far cheaper to
+// write for a long run). Verilator builds a model to trace in one or the other, and
+// kernel-test/test.cpp picks the matching writer, so this is also the waveform file's extension.
+fun verilatorTraceFormatProp(): String {
+    val format = providers.gradleProperty("verilatorTraceFormat").orNull?.trim()?.lowercase() ?: "vcd"
+    if (format != "fst" && format != "vcd") throw GradleException("-PverilatorTraceFormat must be fst or vcd, not $format")
+    return format
+}
+
+// The script that has Verilator build kernel_test from vProc and kernel-test's C++ into outDir
+fun verilatorKernelBuildScript(outDir: File, vProc: File, threads: String?, traceThreads: String?, traceFormat: String): String {
+    val top = "packet_body_processor"
+
+    val cppArgs = kernelTestCppSources.joinToString(" ") { "\"${it.absolutePath}\"" }
+    val incDirs = listOf(
+        kernelTestDir,
+        kernelTestDir.resolve("util")
+    ).filter { it.exists() }
+        .joinToString(" ") { "-I\\\"${it.absolutePath}\\\"" }
+
+    // Verilator only writes FST on trace threads; with VCD it fails the build
+    if (traceThreads != null && traceFormat != "fst")
+        throw GradleException("-PverilatorTraceThreads needs -PverilatorTraceFormat=fst")
+
+    val threadArgs = listOfNotNull(
+        threads?.let { "--threads $it" },
+        traceThreads?.let { "--trace-threads $it" }
+    ).joinToString(" ")
+
+    val traceArg = if (traceFormat == "fst") "--trace-fst" else "--trace"
+
+    return """
+        set -euo pipefail
+
+        "$verilatorBin" --version
+
+        # Build into: $outDir
+        "$verilatorBin" -Wall -Wno-DECLFILENAME -Wno-UNUSEDSIGNAL $traceArg --cc $threadArgs \
+          --top-module "$top" \
+          --Mdir "$outDir" \
+          "$vProc" \
+          --exe $cppArgs \
+          -CFLAGS "-std=c++17 $incDirs" \
+          --build -j 0 \
+          -o kernel_test
+    """.trimIndent()
+}
+
 tasks.register<Exec>("buildKernelTest") {
     group = "verilator"
     description = "Build kernel-test Verilator executable from generated GAPL Verilog + C++ wrapper"
@@ -984,36 +1041,18 @@ tasks.register<Exec>("buildKernelTest") {
     // the correctness risk for this fast-changing, same-path output.
     environment("CCACHE_DISABLE", "1")
 
+    // Changing the thread count or the trace format has to rebuild the model
+    inputs.property("verilatorThreads", providers.gradleProperty("verilatorThreads").orElse(""))
+    inputs.property("verilatorTraceThreads", providers.gradleProperty("verilatorTraceThreads").orElse(""))
+    inputs.property("verilatorTraceFormat", providers.gradleProperty("verilatorTraceFormat").orElse(""))
+
     doFirst {
         val outDir = verilatorKernelOutDir.get().asFile
         outDir.mkdirs()
 
-        val top = "packet_body_processor"
-
-        val vProc = vProcProvider.get()
-
-        val cppArgs = kernelTestCppSources.joinToString(" ") { "\"${it.absolutePath}\"" }
-        val incDirs = listOf(
-            kernelTestDir,
-            kernelTestDir.resolve("util")
-        ).filter { it.exists() }
-            .joinToString(" ") { "-I\\\"${it.absolutePath}\\\"" }
-
-        commandLine(bash("""
-            set -euo pipefail
-
-            "$verilatorBin" --version
-
-            # Build into: $outDir
-            "$verilatorBin" -Wall -Wno-DECLFILENAME -Wno-UNUSEDSIGNAL --trace --cc \
-              --top-module "$top" \
-              --Mdir "$outDir" \
-              "$vProc" \
-              --exe $cppArgs \
-              -CFLAGS "-std=c++17 $incDirs" \
-              --build -j 0 \
-              -o kernel_test
-        """.trimIndent()))
+        commandLine(bash(verilatorKernelBuildScript(
+            outDir, vProcProvider.get(), verilatorThreadsProp(), verilatorTraceThreadsProp(), verilatorTraceFormatProp()
+        )))
     }
 }
 
@@ -1040,23 +1079,229 @@ tasks.register<Exec>("runKernelTest") {
         val inputs = splitCsv(testInputsProp)
         val expected = splitCsv(testExpectedProp)
 
-        // Waveform output (VCD, since --trace)
+        // Waveform output, in whichever format buildKernelTest traced in
         val waveFile = layout.buildDirectory
-            .file("verilator/kernel-test/kernel_test.vcd")
+            .file("verilator/kernel-test/kernel_test.${verilatorTraceFormatProp()}")
             .get().asFile
         waveFile.parentFile.mkdirs()
 
-        // Build argv: -i <...> ... -o <...> ... -w <file>
+        // Cycle-level profile (per-packet cycles, pipeline depth/latency/initiation interval and
+        // occupancy histograms), for comparing variations without synthesizing them
+        val profileFile = layout.buildDirectory
+            .file("verilator/kernel-test/kernel_test_profile.json")
+            .get().asFile
+
+        // Build argv: -i <...> ... -o <...> ... -w <file> -j <file>
         val args = mutableListOf<String>()
         inputs.forEach { args += listOf("-i", it) }
-        expected.forEach { args += listOf("-o", it) }
+
+        // -PkernelTestRandomPackets=<n> checks the kernel against test.properties' referenceModel
+        // rather than its expected outputs, on its inputs and n random packets besides - up to
+        // -PkernelTestRandomMaxBytes=<bytes> long (64 by default), seeded by -PkernelTestRandomSeed=<n>
+        val randomPackets = providers.gradleProperty("kernelTestRandomPackets").orNull?.trim()
+        if (randomPackets != null) {
+            val model = testReferenceModel
+                ?: throw GradleException("-PkernelTestRandomPackets needs a referenceModel in ${testPropsFile.path}")
+            args += listOf("-R", model, "-N", randomPackets)
+            providers.gradleProperty("kernelTestRandomMaxBytes").orNull?.trim()?.let { args += listOf("-L", it) }
+            providers.gradleProperty("kernelTestRandomSeed").orNull?.trim()?.let { args += listOf("-S", it) }
+        } else {
+            expected.forEach { args += listOf("-o", it) }
+        }
         args += listOf("-w", waveFile.absolutePath)
+        args += listOf("-j", profileFile.absolutePath)
+
+        // Only some of the run makes it into the waveform with -PkernelTestTraceCycles=<start>:<stop>,
+        // -PkernelTestTracePacket=<index> (while that packet is in the kernel) or
+        // -PkernelTestTraceMismatch=<cycles> (the first packet that doesn't match, and that many cycles
+        // before it, by replaying the run once it's known) - see kernel-test/util/trace.h
+        providers.gradleProperty("kernelTestTraceCycles").orNull?.trim()?.let { args += listOf("-c", it) }
+        providers.gradleProperty("kernelTestTracePacket").orNull?.trim()?.let { args += listOf("-k", it) }
+        providers.gradleProperty("kernelTestTraceMismatch").orNull?.trim()?.let { args += listOf("-m", it) }
+
+        // -PkernelTestQuiet=true only prints the beats that don't match, and a summary
+        if (providers.gradleProperty("kernelTestQuiet").orNull?.trim()?.toBooleanStrictOrNull() == true) args += "-q"
+
+        // -PkernelTestStream=true streams the packets back to back instead of resetting the kernel
+        // between them, -PkernelTestPacketGap=<cycles> spacing them out. While streaming,
+        // -PkernelTestInputStalls / -PkernelTestOutputStalls=<pattern> (see kernel-test/util/stall.h)
+        // starve its input and push back on its output, -PkernelTestStallSeed=<n> seeding them.
+        if (providers.gradleProperty("kernelTestStream").orNull?.trim()?.toBooleanStrictOrNull() == true) {
+            args += "-s"
+            providers.gradleProperty("kernelTestPacketGap").orNull?.trim()?.let { args += listOf("-g", it) }
+            providers.gradleProperty("kernelTestInputStalls").orNull?.trim()?.let { args += listOf("-b", it) }
+            providers.gradleProperty("kernelTestOutputStalls").orNull?.trim()?.let { args += listOf("-p", it) }
+            providers.gradleProperty("kernelTestStallSeed").orNull?.trim()?.let { args += listOf("-r", it) }
+        }
 
         workingDir = outDir
         commandLine(listOf(exe.absolutePath) + args)
     }
 }
 
+// Streams test.properties' packets through the kernel once per stall pattern, and sums up the
+// throughput and latency each one gets - how the kernel holds up when the output queues push back
+// or the input runs dry, without a trip through Vivado. -PkernelTestStallPatterns overrides the
+// patterns, as a semicolon-separated list of "<input pattern>,<output pattern>" pairs.
+//
+// Streaming never resets the kernel, so test.properties' expected outputs (written for a reset
+// before every packet) don't hold for a stateful kernel like cms or regex. Each run is checked
+// against the application's referenceModel instead, which is stepped every cycle and so holds
+// under any stalls. An application without one only gets its throughput measured.
+tasks.register("runKernelTestStallSweep") {
+    group = "verilator"
+    description = "Stream kernel-test's packets under a series of stall patterns and compare throughput"
+    dependsOn("buildKernelTest")
+    outputs.upToDateWhen { false } // always run
+
+    doLast {
+        val outDir = verilatorKernelOutDir.get().asFile
+        val exe = verilatorKernelExe.get()
+        if (!exe.exists()) throw GradleException("kernel-test executable not found at ${exe.absolutePath}")
+
+        fun splitCsv(s: String): List<String> =
+            s.split(',')
+                .map { it.trim() }
+                .filter { it.isNotEmpty() }
+
+        val vectorArgs = mutableListOf<String>()
+        splitCsv(testInputs.trim()).forEach { vectorArgs += listOf("-i", it) }
+
+        val model = testReferenceModel
+        if (model != null) {
+            vectorArgs += listOf("-R", model)
+        } else {
+            println("[runKernelTestStallSweep] No referenceModel in ${testPropsFile.path}, so the outputs aren't checked")
+        }
+
+        val patterns = (providers.gradleProperty("kernelTestStallPatterns").orNull
+            ?: "none,none;random:25,none;none,random:25;none,periodic:3:1;none,bursty:25:16;bursty:25:16,bursty:25:16")
+            .split(';')
+            .map { it.trim() }
+            .filter { it.isNotEmpty() }
+            .map { pair ->
+                val fields = pair.split(',').map { it.trim() }
+                if (fields.size != 2) throw GradleException("Stall pattern pairs look like <input>,<output>, not $pair")
+                fields[0] to fields[1]
+            }
+
+        val seed = providers.gradleProperty("kernelTestStallSeed").orNull?.trim() ?: "1"
+
+        val summary = mutableListOf<String>()
+        for ((input, output) in patterns) {
+            val out = java.io.ByteArrayOutputStream()
+            val result = project.exec {
+                isIgnoreExitValue = true
+                workingDir = outDir
+                commandLine(listOf(exe.absolutePath) + vectorArgs + listOf("-q", "-s", "-b", input, "-p", output, "-r", seed))
+                standardOutput = out
+                errorOutput = java.io.OutputStream.nullOutputStream()
+            }
+
+            val report = out.toString()
+            fun field(name: String) =
+                Regex("""^\s*${Regex.escape(name)}:\s*(\S+)""", RegexOption.MULTILINE).find(report)?.groupValues?.get(1) ?: "-"
+
+            summary += String.format(
+                "%-24s %-24s %14s %14s %10s %10s %s",
+                input, output, field("Input beats/cycle"), field("Output beats/cycle"), field("Mean"), field("Max"),
+                when {
+                    model == null -> "unchecked"
+                    result.exitValue == 0 -> "pass"
+                    else -> "FAIL"
+                }
+            )
+        }
+
+        println(String.format(
+            "%-24s %-24s %14s %14s %10s %10s %s",
+            "Input stalls", "Output stalls", "In beats/cyc", "Out beats/cyc", "Lat mean", "Lat max", "Result"
+        ))
+        summary.forEach { println(it) }
+    }
+}
+
+// Builds kernel_test once per Verilator thread count (1, 2, 4 and 8, or -PkernelTestBenchmarkThreads=
+// <n,n,...>), each into its own directory, streams the same packets through each
+// (test.properties' vectors, -PkernelTestBenchmarkRepeat times over, 100000 by default), and tabulates
+// simulated cycles per second - which thread count the nightly regression should build with.
+//
+// Only the speed of the streamed run is measured: a stateful kernel like cms carries its state from
+// one pass to the next, so test.properties' expected outputs only hold for the first. Whether each
+// build gets the right answers is checked separately, on the vectors once over, as runKernelTest
+// does.
+tasks.register("benchmarkKernelTestThreads") {
+    group = "verilator"
+    description = "Compare kernel-test simulation speed across Verilator thread counts"
+    dependsOn("generateGaplVerilog")
+    outputs.upToDateWhen { false } // always run
+
+    val vProcProvider = gaplVerilogOut.map { it.asFile.resolve(targetVerilogName(gaplTargetFile)) }
+
+    doLast {
+        fun splitCsv(s: String): List<String> =
+            s.split(',')
+                .map { it.trim() }
+                .filter { it.isNotEmpty() }
+
+        val threadCounts = splitCsv(providers.gradleProperty("kernelTestBenchmarkThreads").orNull ?: "1,2,4,8")
+        val repeat = providers.gradleProperty("kernelTestBenchmarkRepeat").orNull?.trim() ?: "100000"
+
+        val vectorArgs = mutableListOf<String>()
+        splitCsv(testInputs.trim()).forEach { vectorArgs += listOf("-i", it) }
+        splitCsv(testExpectedOutputs.trim()).forEach { vectorArgs += listOf("-o", it) }
+
+        val simulatedPattern = Regex("""Simulated (\d+) clock cycles in (\S+) s \((\S+) cycles/s\)""")
+
+        val summary = mutableListOf<String>()
+        for (threads in threadCounts) {
+            val outDir = layout.buildDirectory.dir("verilator/kernel-test-threads-$threads").get().asFile
+            outDir.mkdirs()
+
+            println("[benchmarkKernelTestThreads] Building with --threads $threads into $outDir")
+            project.exec {
+                // See buildKernelTest for why not through ccache
+                environment("CCACHE_DISABLE", "1")
+                commandLine(bash(verilatorKernelBuildScript(outDir, vProcProvider.get(), threads, null, verilatorTraceFormatProp())))
+            }
+
+            val exe = outDir.resolve("kernel_test").absolutePath
+
+            val check = project.exec {
+                isIgnoreExitValue = true
+                workingDir = outDir
+                commandLine(listOf(exe) + vectorArgs + listOf("-q"))
+                standardOutput = java.io.OutputStream.nullOutputStream()
+                errorOutput = java.io.OutputStream.nullOutputStream()
+            }
+
+            // Fails the output check past the first pass wherever the kernel keeps state, so only its
+            // timing is used
+            val out = java.io.ByteArrayOutputStream()
+            project.exec {
+                isIgnoreExitValue = true
+                workingDir = outDir
+                commandLine(listOf(exe) + vectorArgs + listOf("-q", "-s", "-n", repeat))
+                standardOutput = out
+                errorOutput = java.io.OutputStream.nullOutputStream()
+            }
+
+            val simulated = simulatedPattern.find(out.toString())
+            summary += String.format(
+                "%8s %14s %12s %16s %s",
+                threads,
+                simulated?.groupValues?.get(1) ?: "-",
+                simulated?.groupValues?.get(2) ?: "-",
+                simulated?.groupValues?.get(3) ?: "-",
+                if (check.exitValue == 0) "pass" else "FAIL"
+            )
+        }
+
+        println(String.format("%8s %14s %12s %16s %s", "Threads", "Cycles", "Seconds", "Cycles/s", "Check"))
+        summary.forEach { println(it) }
+    }
+}
+
 // simengine counterpart to buildKernelTest/runKernelTest above: runs the SAME test.properties
 // packet vectors against packet_body_processor directly through simengine's Engine, bypassing
 // Verilog/Verilator (and the compiler entirely - it reads gaplTargetFile's source directly, not
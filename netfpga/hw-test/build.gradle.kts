@@ -8,10 +8,32 @@ val executableName = "generator"
 
 val sources = listOf(
     "main.cpp",
+    "traffic/benchmark.cpp",
+    "traffic/profile.cpp",
+    "traffic/receiver.cpp",
+    "traffic/soak.cpp",
+    "traffic/soft_dut.cpp",
+    "traffic/transmitter.cpp",
+    "traffic/trial.cpp",
+    "traffic/verifier.cpp",
+    "network/fanout.cpp",
+    "network/filter.cpp",
+    "network/flow.cpp",
     "network/packet.cpp",
+    "network/packet_template.cpp",
     "network/socket.cpp",
+    "network/rx_ring.cpp",
+    "network/stamp.cpp",
+    "network/tx_batch.cpp",
+    "network/uring.cpp",
+    "network/xdp.cpp",
+    "util/affinity.cpp",
     "util/hex.cpp",
+    "util/histogram.cpp",
+    "util/log.cpp",
     "util/options.cpp",
+    "util/pacer.cpp",
+    "util/pcap.cpp",
     "util/string_utils.cpp",
 )
 
@@ -46,6 +68,7 @@ tasks.register<Exec>("buildTest") {
 
         val cmd = mutableListOf(
             "g++",
+            "-O2",
             "-pthread",
             "-o",
             outFile.absolutePath
@@ -61,7 +84,13 @@ tasks.named("build") {
     dependsOn("buildTest")
 }
 
-fun loadGeneratorArgsFromConfig(): List<String> {
+// The self-test runs entirely inside this network namespace, so its veth pairs and routes can't
+// disturb the host's own interfaces: gen-tx -> dut-rx, through the soft DUT, dut-tx -> gen-rx
+val selfTestNamespace = "gapl-selftest"
+
+// With selfTest, the interfaces in the config are replaced by the self-test's veth pairs, and the
+// generator runs the soft DUT (see traffic/soft_dut.h) between them
+fun loadGeneratorArgsFromConfig(selfTest: Boolean = false): List<String> {
     if (!generatorConfigFile.exists()) {
         throw GradleException(
             "Config file not found: ${generatorConfigFile.path}. " +
@@ -78,8 +107,8 @@ fun loadGeneratorArgsFromConfig(): List<String> {
             ?: throw GradleException("Missing '$name' in ${generatorConfigFile.path}")
 
     val args = listOf(
-        "-t", prop("transmittingInterface"),
-        "-r", prop("receivingInterface"),
+        "-t", if (selfTest) "gen-tx" else prop("transmittingInterface"),
+        "-r", if (selfTest) "gen-rx" else prop("receivingInterface"),
         "-s", prop("sourceIP"),
         "-d", prop("destinationIP"),
         "-p", prop("port"),
@@ -88,15 +117,111 @@ fun loadGeneratorArgsFromConfig(): List<String> {
     // Optional: if present, the generator installs a static ARP entry for destinationIP itself
     // (requires cap_net_admin, granted to the binary by grantCapabilities), so no manual `arp -s`
     // step or live ARP reply is needed.
-    val destinationMac = (props.getProperty("destinationMac")?.let { listOf("-m", it) } ?: emptyList())
+    // The self-test always needs one: nothing in its namespace answers ARP.
+    val destinationMac = (props.getProperty("destinationMac")?.let { listOf("-m", it) }
+        ?: if (selfTest) listOf("-m", "02:00:00:00:00:02") else emptyList())
+
+    // Optional: receive through a TPACKET_V3 ring (see network/rx_ring.h) rather than one recvfrom
+    // copy per frame - needed to keep up with line rate.
+    val rxRing = if (props.getProperty("rxRing")?.toBoolean() == true) listOf("--rx-ring") else emptyList()
+
+    // Optional: build every packet up front and send them through sendmmsg, batchSize at a time
+    val batchSize = (props.getProperty("batchSize")?.let { listOf("--batch-size", it) } ?: emptyList())
+
+    // Optional: load mode - replay the inputs in a loop for loadCount packets or loadDuration
+    // seconds, paced to loadRatePps or loadRateGbps, letting loadBurst packets out back to back
+    fun optionalArg(name: String, flag: String) = props.getProperty(name)?.let { listOf(flag, it) } ?: emptyList()
+    val load = optionalArg("loadCount", "--count") +
+        optionalArg("loadDuration", "--duration") +
+        optionalArg("loadRatePps", "--rate-pps") +
+        optionalArg("loadRateGbps", "--rate-gbps") +
+        optionalArg("loadBurst", "--burst")
+
+    // Optional: stamp each packet with its transmit time and report a latency histogram
+    val latency = if (props.getProperty("latency")?.toBoolean() == true) listOf("--latency") else emptyList()
+
+    // Optional: spread each receiving interface over rxThreads threads (see network/fanout.h),
+    // pinned to rxCpus, with the transmitter pinned to txCpu
+    val receiveThreads = optionalArg("rxThreads", "--rx-threads") +
+        optionalArg("fanout", "--fanout") +
+        optionalArg("rxCpus", "--rx-cpus") +
+        optionalArg("txCpu", "--tx-cpu")
+
+    // Optional: replay pcapIn (a pcap or pcapng trace) instead of the test vectors, at its original
+    // timing if pcapTiming is set, and/or capture everything received to pcapOut
+    val pcap = optionalArg("pcapIn", "--pcap-in") +
+        (if (props.getProperty("pcapTiming")?.toBoolean() == true) listOf("--pcap-timing") else emptyList()) +
+        optionalArg("pcapOut", "--pcap-out")
+
+    // The self-test's soft DUT runs softDutTransform (echo by default), pinned to softDutCpu. The
+    // test vectors' expected outputs are the processor's, not the transform's: echo sends the
+    // inputs straight back, and for the other transforms there's nothing to compare against.
+    val softDutTransform = props.getProperty("softDutTransform") ?: "echo"
+    val softDut = if (selfTest) {
+        listOf("--soft-dut", "dut-rx,dut-tx", "--soft-dut-transform", softDutTransform) +
+            optionalArg("softDutCpu", "--soft-dut-cpu")
+    } else {
+        emptyList()
+    }
+
+    val expectedOutputList = when {
+        !selfTest -> testExpectedOutputs
+        softDutTransform == "echo" -> testInputs
+        else -> null
+    }
+
+    // Optional: send the flows, frame sizes and payloads of a traffic profile (see traffic/profile.h
+    // and profiles/) instead of the test vectors, which are then left out
+    val profile = props.getProperty("profile")?.let { listOf("--profile", file(it).absolutePath) } ?: emptyList()
+
+    val inputs = if (profile.isNotEmpty()) emptyList() else (testInputs?.split(",") ?: emptyList()).flatMap { listOf("-i", it) }
+    val expectedOutputs = if (profile.isNotEmpty()) emptyList() else (expectedOutputList?.split(",") ?: emptyList()).flatMap { listOf("-o", it) }
+
+    // Optional: send and receive through AF_XDP (see network/xdp.h), receiving from xdpQueue onwards,
+    // optionally forcing copy mode (xdpCopy) or generic XDP (xdpSkb)
+    val xdp = (if (props.getProperty("xdp")?.toBoolean() == true) listOf("--xdp") else emptyList()) +
+        optionalArg("xdpQueue", "--xdp-queue") +
+        (if (props.getProperty("xdpCopy")?.toBoolean() == true) listOf("--xdp-copy") else emptyList()) +
+        (if (props.getProperty("xdpSkb")?.toBoolean() == true) listOf("--xdp-skb") else emptyList())
+
+    // Optional: send and receive through io_uring (see network/uring.h) instead of sendmmsg and recvfrom
+    val ioUring = if (props.getProperty("ioUring")?.toBoolean() == true) listOf("--io-uring") else emptyList()
+
+    // Optional: how much of each frame to log (logLevel: quiet, errors, frames or dump) and where to
+    // (logFile, as JSON lines)
+    val logging = optionalArg("logLevel", "--log-level") +
+        (props.getProperty("logFile")?.let { listOf("--log-file", file(it).absolutePath) } ?: emptyList())
+
+    // Optional: soak - run until interrupted (or for loadCount/loadDuration), reporting live counters
+    // every soakInterval seconds, to soakMetrics as CSV and on prometheusPort too if they're set
+    val soak = (if (props.getProperty("soak")?.toBoolean() == true) listOf("--soak") else emptyList()) +
+        optionalArg("soakInterval", "--soak-interval") +
+        (props.getProperty("soakMetrics")?.let { listOf("--soak-metrics", file(it).absolutePath) } ?: emptyList()) +
+        optionalArg("prometheusPort", "--prometheus-port")
+
+    return args + destinationMac + rxRing + batchSize + load + latency + receiveThreads + pcap + xdp + ioUring + softDut + profile + logging + soak + inputs + expectedOutputs
+}
+
+// The benchmark's settings, all optional: benchmarkSizes (frame sizes, comma separated),
+// benchmarkTrial (seconds per trial), lineRateGbps, benchmarkResolution and benchmarkLoss (percent)
+fun loadBenchmarkArgsFromConfig(reportPath: String): List<String> {
+    val props = Properties().apply {
+        generatorConfigFile.inputStream().use { load(it) }
+    }
 
-    val inputs = (testInputs?.split(",") ?: emptyList()).flatMap { listOf("-i", it) }
-    val expectedOutputs = (testExpectedOutputs?.split(",") ?: emptyList()).flatMap { listOf("-o", it) }
+    fun optionalArg(name: String, flag: String) = props.getProperty(name)?.let { listOf(flag, it) } ?: emptyList()
 
-    return args + destinationMac + inputs + expectedOutputs
+    return listOf("--benchmark", "--benchmark-report", reportPath) +
+        optionalArg("benchmarkSizes", "--benchmark-sizes") +
+        optionalArg("benchmarkTrial", "--benchmark-trial") +
+        optionalArg("lineRateGbps", "--line-rate-gbps") +
+        optionalArg("benchmarkResolution", "--benchmark-resolution") +
+        optionalArg("benchmarkLoss", "--benchmark-loss")
 }
 
-val requiredCapabilities = "cap_net_raw,cap_net_admin=eip"
+// cap_bpf and cap_ipc_lock are only needed for --xdp: loading the XDP program, and pinning a UMEM
+// larger than RLIMIT_MEMLOCK. Listed in the order getcap prints them, so the check below matches.
+val requiredCapabilities = "cap_net_admin,cap_net_raw,cap_ipc_lock,cap_bpf=eip"
 
 fun hasRequiredCapabilities(binary: java.io.File): Boolean {
     if (!binary.exists()) return false
@@ -154,3 +279,88 @@ tasks.register<Exec>("runTest") {
         commandLine(cmd)
     }
 }
+
+tasks.register<Exec>("runBenchmark") {
+    group = "application"
+    description = "Sweep frame sizes and offered load against the programmed board, writing a throughput/latency report"
+    dependsOn("grantCapabilities")
+    dependsOn(":netfpga:programFPGA")
+
+    inputs.file(generatorConfigFile)
+
+    workingDir = projectDir
+
+    // One report per build of the application, so the variations can be compared side by side
+    val variationName = findProperty("programVariationName") as String? ?: "default"
+    val reportPath = layout.buildDirectory.file("benchmark/$programName-$variationName").get().asFile
+
+    doFirst {
+        reportPath.parentFile.mkdirs()
+
+        val argsFromConfig = loadGeneratorArgsFromConfig() + loadBenchmarkArgsFromConfig(reportPath.absolutePath)
+        val exe = generatorBinary.get().asFile.absolutePath
+
+        val cmd = buildList {
+            add(exe)
+            addAll(argsFromConfig)
+        }
+
+        println("Running: ${cmd.joinToString(" ")}")
+        commandLine(cmd)
+    }
+}
+
+tasks.register<Exec>("setupSelfTest") {
+    group = "application"
+    description = "Create the network namespace and veth pairs runSelfTest runs the generator in (uses sudo)"
+
+    doFirst {
+        val props = Properties().apply {
+            generatorConfigFile.inputStream().use { load(it) }
+        }
+        val sourceIP = props.getProperty("sourceIP") ?: throw GradleException("Missing 'sourceIP' in ${generatorConfigFile.path}")
+        val destinationIP = props.getProperty("destinationIP") ?: throw GradleException("Missing 'destinationIP' in ${generatorConfigFile.path}")
+
+        // Recreated from scratch every time, so a half-finished earlier run can't leave it broken.
+        // IPv6 is switched off so that router solicitations and the like don't reach the DUT.
+        val script = """
+            set -e
+            ip netns del $selfTestNamespace 2>/dev/null || true
+            ip netns add $selfTestNamespace
+            ip -n $selfTestNamespace link add gen-tx type veth peer name dut-rx
+            ip -n $selfTestNamespace link add dut-tx type veth peer name gen-rx
+            ip netns exec $selfTestNamespace sysctl -qw net.ipv6.conf.all.disable_ipv6=1
+            ip netns exec $selfTestNamespace sysctl -qw net.ipv6.conf.default.disable_ipv6=1
+            for link in lo gen-tx dut-rx dut-tx gen-rx; do ip -n $selfTestNamespace link set ${'$'}link up; done
+            ip -n $selfTestNamespace addr add $sourceIP/32 dev gen-tx
+            ip -n $selfTestNamespace route add $destinationIP/32 dev gen-tx
+        """.trimIndent()
+
+        commandLine("sudo", "sh", "-c", script)
+    }
+}
+
+tasks.register<Exec>("runSelfTest") {
+    group = "application"
+    description = "Run the traffic generator against a software DUT over veth pairs, without the board (uses sudo)"
+    dependsOn("buildTest", "setupSelfTest")
+
+    inputs.file(generatorConfigFile)
+
+    workingDir = projectDir
+
+    doFirst {
+        val argsFromConfig = loadGeneratorArgsFromConfig(selfTest = true)
+        val exe = generatorBinary.get().asFile.absolutePath
+
+        // Entering the namespace takes root, so this runs under sudo rather than relying on the
+        // capabilities grantCapabilities gives the binary
+        val cmd = buildList {
+            addAll(listOf("sudo", "ip", "netns", "exec", selfTestNamespace, exe))
+            addAll(argsFromConfig)
+        }
+
+        println("Running: ${cmd.joinToString(" ")}")
+        commandLine(cmd)
+    }
+}
@@ -0,0 +1,74 @@
+#include "fanout.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/socket.h>
+
+uint16_t create_fanout_group(int socket_fd, int mode)
+{
+    // With FLAG_UNIQUEID the id has to be passed as 0, and the kernel fills in a free one
+    uint32_t argument = static_cast<uint32_t>(mode | PACKET_FANOUT_FLAG_UNIQUEID) << 16;
+    if (setsockopt(socket_fd, SOL_PACKET, PACKET_FANOUT, &argument, sizeof(argument)) < 0)
+    {
+        perror("Failed to create PACKET_FANOUT group");
+        exit(-1);
+    }
+
+    uint32_t assigned = 0;
+    socklen_t length = sizeof(assigned);
+    if (getsockopt(socket_fd, SOL_PACKET, PACKET_FANOUT, &assigned, &length) < 0)
+    {
+        perror("Failed to read PACKET_FANOUT group id");
+        exit(-1);
+    }
+
+    return static_cast<uint16_t>(assigned & 0xffff);
+}
+
+void join_fanout_group(int socket_fd, uint16_t group_id, int mode)
+{
+    uint32_t argument = (static_cast<uint32_t>(mode) << 16) | group_id;
+    if (setsockopt(socket_fd, SOL_PACKET, PACKET_FANOUT, &argument, sizeof(argument)) < 0)
+    {
+        perror("Failed to join PACKET_FANOUT group");
+        exit(-1);
+    }
+}
+
+int parse_fanout_mode(const std::string& name)
+{
+    if (name == "hash") return PACKET_FANOUT_HASH;
+    if (name == "lb")   return PACKET_FANOUT_LB;
+    if (name == "cpu")  return PACKET_FANOUT_CPU;
+    if (name == "qm")   return PACKET_FANOUT_QM;
+    return -1;
+}
+
+std::string fanout_mode_name(int mode)
+{
+    switch (mode)
+    {
+        case PACKET_FANOUT_HASH: return "hash";
+        case PACKET_FANOUT_LB:   return "lb";
+        case PACKET_FANOUT_CPU:  return "cpu";
+        case PACKET_FANOUT_QM:   return "qm";
+        default:                 return "unknown";
+    }
+}
+
+uint64_t get_receive_drops(int socket_fd)
+{
+    // tpacket_stats is a prefix of tpacket_stats_v3, so this works whether or not the socket has a
+    // TPACKET_V3 ring
+    tpacket_stats stats{};
+    socklen_t length = sizeof(stats);
+
+    if (getsockopt(socket_fd, SOL_PACKET, PACKET_STATISTICS, &stats, &length) < 0)
+    {
+        perror("Failed to read receive socket statistics");
+        exit(-1);
+    }
+
+    return stats.tp_drops;
+}
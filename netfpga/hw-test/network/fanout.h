@@ -0,0 +1,33 @@
+#ifndef TRAFFIC_GENERATOR_FANOUT_H
+#define TRAFFIC_GENERATOR_FANOUT_H
+
+#include <cstdint>
+#include <string>
+
+#include <linux/if_packet.h>
+
+// PACKET_FANOUT spreads the frames arriving on an interface over every AF_PACKET socket in a group,
+// so each socket (and the thread reading it) only sees its share. mode picks which socket a frame
+// goes to:
+//   PACKET_FANOUT_HASH - by flow hash, so each flow stays on one socket, in order
+//   PACKET_FANOUT_LB   - round robin
+//   PACKET_FANOUT_CPU  - by the CPU that received the frame, i.e. by whichever RX queue's interrupt
+//                        landed there
+//   PACKET_FANOUT_QM   - by the NIC RX queue the frame arrived on
+// Hash, CPU and QM all follow the NIC's RSS hash in the end, so they only spread traffic that's made
+// up of more than one flow.
+
+// Puts socket_fd in a new fanout group with an id the kernel picks (so it can't collide with another
+// process's group), and returns that id for the other sockets to join with
+uint16_t create_fanout_group(int socket_fd, int mode);
+void join_fanout_group(int socket_fd, uint16_t group_id, int mode);
+
+// Parses "hash", "lb", "cpu" or "qm" to the matching PACKET_FANOUT_* mode, or returns -1
+int parse_fanout_mode(const std::string& name);
+std::string fanout_mode_name(int mode);
+
+// Frames the kernel has dropped on socket_fd since the last call, because its receive buffer or ring
+// was full
+uint64_t get_receive_drops(int socket_fd);
+
+#endif //TRAFFIC_GENERATOR_FANOUT_H
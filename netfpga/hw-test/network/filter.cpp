@@ -0,0 +1,103 @@
+#include "filter.h"
+
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/in.h>
+
+// Offsets into an untagged Ethernet frame carrying IPv4
+static constexpr uint32_t ETHER_TYPE_OFFSET  = 12;
+static constexpr uint32_t IP_HEADER_OFFSET   = 14;
+static constexpr uint32_t IP_FRAGMENT_OFFSET = IP_HEADER_OFFSET + 6;
+static constexpr uint32_t IP_PROTOCOL_OFFSET = IP_HEADER_OFFSET + 9;
+static constexpr uint32_t IP_SOURCE_OFFSET   = IP_HEADER_OFFSET + 12;
+static constexpr uint32_t IP_DEST_OFFSET     = IP_HEADER_OFFSET + 16;
+
+// Accepted frames are passed up whole
+static constexpr uint32_t ACCEPT_LENGTH = 0x40000;
+
+// Stands in for the jump to the final "drop" instruction until the program is complete and the
+// distance to it is known
+static constexpr uint8_t JUMP_TO_DROP = 0xff;
+
+static void jump_unless_equal(std::vector<sock_filter>& program, uint32_t value)
+{
+    program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, value, 0, JUMP_TO_DROP));
+}
+
+static void jump_unless_in_range(std::vector<sock_filter>& program, uint32_t first, uint32_t last)
+{
+    if (first == last)
+    {
+        jump_unless_equal(program, first);
+        return;
+    }
+
+    program.push_back(BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, first, 0, JUMP_TO_DROP));
+    program.push_back(BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, last, JUMP_TO_DROP, 0));
+}
+
+// Appends the accept and drop instructions, and points every pending jump at the drop
+static std::vector<sock_filter> finish_program(std::vector<sock_filter> program)
+{
+    program.push_back(BPF_STMT(BPF_RET | BPF_K, ACCEPT_LENGTH));
+    program.push_back(BPF_STMT(BPF_RET | BPF_K, 0));
+
+    const size_t drop = program.size() - 1;
+    for (size_t i = 0; i < drop; ++i)
+    {
+        if (BPF_CLASS(program[i].code) != BPF_JMP) continue;
+        if (program[i].jt == JUMP_TO_DROP) program[i].jt = static_cast<uint8_t>(drop - i - 1);
+        if (program[i].jf == JUMP_TO_DROP) program[i].jf = static_cast<uint8_t>(drop - i - 1);
+    }
+
+    return program;
+}
+
+// IPv4, and not something this interface is sending itself
+static std::vector<sock_filter> ipv4_prologue()
+{
+    std::vector<sock_filter> program;
+
+    program.push_back(BPF_STMT(BPF_LD | BPF_H | BPF_ABS, ETHER_TYPE_OFFSET));
+    jump_unless_equal(program, ETH_P_IP);
+
+    program.push_back(BPF_STMT(BPF_LD | BPF_B | BPF_ABS, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_PKTTYPE)));
+    program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PACKET_OUTGOING, JUMP_TO_DROP, 0));
+
+    return program;
+}
+
+std::vector<sock_filter> create_dut_output_filter(const flow_ranges& flows)
+{
+    std::vector<sock_filter> program = ipv4_prologue();
+
+    program.push_back(BPF_STMT(BPF_LD | BPF_B | BPF_ABS, IP_PROTOCOL_OFFSET));
+    jump_unless_equal(program, IPPROTO_UDP);
+
+    // Absolute word loads come out in host order, which is the order the ranges are in too
+    program.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, IP_SOURCE_OFFSET));
+    jump_unless_in_range(program, flows.src_ip.first, flows.src_ip.last);
+
+    program.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, IP_DEST_OFFSET));
+    jump_unless_in_range(program, flows.dest_ip.first, flows.dest_ip.last);
+
+    // Only a first fragment (or an unfragmented packet) has a UDP header to check
+    program.push_back(BPF_STMT(BPF_LD | BPF_H | BPF_ABS, IP_FRAGMENT_OFFSET));
+    program.push_back(BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, JUMP_TO_DROP, 0));
+
+    // X = the IP header length, so the ports can be found past any IP options
+    program.push_back(BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, IP_HEADER_OFFSET));
+
+    program.push_back(BPF_STMT(BPF_LD | BPF_H | BPF_IND, IP_HEADER_OFFSET));
+    jump_unless_in_range(program, flows.src_port.first, flows.src_port.last);
+
+    program.push_back(BPF_STMT(BPF_LD | BPF_H | BPF_IND, IP_HEADER_OFFSET + 2));
+    jump_unless_in_range(program, flows.dst_port.first, flows.dst_port.last);
+
+    return finish_program(std::move(program));
+}
+
+std::vector<sock_filter> create_ipv4_filter()
+{
+    return finish_program(ipv4_prologue());
+}
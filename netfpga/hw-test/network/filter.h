@@ -0,0 +1,25 @@
+#ifndef TRAFFIC_GENERATOR_FILTER_H
+#define TRAFFIC_GENERATOR_FILTER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <linux/filter.h>
+
+#include "flow.h"
+
+// Classic BPF programs for the receive sockets. The kernel runs them on every frame before anything
+// is copied to user space (or into a ring), so everything they reject costs us nothing - no copy, no
+// wakeup, no parse. They also drop frames the interface itself is sending (PACKET_OUTGOING), which a
+// promiscuous ETH_P_ALL socket would otherwise see too.
+
+// Accepts only the DUT's output: untagged IPv4, unfragmented UDP belonging to one of the flows (the
+// packet processor passes the headers through untouched). A range of a single value costs one
+// comparison, a wider one two.
+std::vector<sock_filter> create_dut_output_filter(const flow_ranges& flows);
+
+// Accepts any untagged IPv4 frame - for replayed traces, which can hold anything
+std::vector<sock_filter> create_ipv4_filter();
+
+#endif //TRAFFIC_GENERATOR_FILTER_H
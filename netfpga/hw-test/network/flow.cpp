@@ -0,0 +1,98 @@
+#include "flow.h"
+
+#include <arpa/inet.h>
+
+static bool parse_address(const std::string& text, uint32_t& address)
+{
+    in_addr parsed{};
+    if (inet_pton(AF_INET, text.c_str(), &parsed) != 1) return false;
+
+    address = ntohl(parsed.s_addr);
+    return true;
+}
+
+static bool parse_port(const std::string& text, uint16_t& port)
+{
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+
+    const unsigned long value = std::stoul(text);
+    if (value > 65535) return false;
+
+    port = static_cast<uint16_t>(value);
+    return true;
+}
+
+flow_ranges single_flow(const std::string& src_ip_addr, const std::string& dest_ip_addr, uint16_t port)
+{
+    flow_ranges ranges{};
+    parse_address_range(src_ip_addr, ranges.src_ip);
+    parse_address_range(dest_ip_addr, ranges.dest_ip);
+    ranges.src_port = {port, port};
+    ranges.dst_port = {port, port};
+
+    return ranges;
+}
+
+bool parse_address_range(const std::string& text, address_range& range)
+{
+    const size_t dash = text.find('-');
+    if (dash != std::string::npos)
+    {
+        return parse_address(text.substr(0, dash), range.first)
+            && parse_address(text.substr(dash + 1), range.last)
+            && range.first <= range.last;
+    }
+
+    const size_t slash = text.find('/');
+    if (slash != std::string::npos)
+    {
+        uint32_t address = 0;
+        uint16_t prefix = 0;
+        if (!parse_address(text.substr(0, slash), address) || !parse_port(text.substr(slash + 1), prefix) || prefix > 32)
+            return false;
+
+        const uint32_t mask = prefix == 0 ? 0 : ~0u << (32 - prefix);
+        range.first = address & mask;
+        range.last = address | ~mask;
+        return true;
+    }
+
+    if (!parse_address(text, range.first)) return false;
+    range.last = range.first;
+    return true;
+}
+
+bool parse_port_range(const std::string& text, port_range& range)
+{
+    const size_t dash = text.find('-');
+    if (dash == std::string::npos)
+    {
+        if (!parse_port(text, range.first)) return false;
+        range.last = range.first;
+        return true;
+    }
+
+    return parse_port(text.substr(0, dash), range.first)
+        && parse_port(text.substr(dash + 1), range.last)
+        && range.first <= range.last;
+}
+
+std::string address_to_string(uint32_t address)
+{
+    char text[INET_ADDRSTRLEN];
+    const in_addr parsed{htonl(address)};
+    inet_ntop(AF_INET, &parsed, text, sizeof(text));
+    return text;
+}
+
+std::string address_range_to_string(const address_range& range)
+{
+    if (range.first == range.last) return address_to_string(range.first);
+    return address_to_string(range.first) + "-" + address_to_string(range.last);
+}
+
+std::string port_range_to_string(const port_range& range)
+{
+    if (range.first == range.last) return std::to_string(range.first);
+    return std::to_string(range.first) + "-" + std::to_string(range.last);
+}
@@ -0,0 +1,43 @@
+#ifndef TRAFFIC_GENERATOR_FLOW_H
+#define TRAFFIC_GENERATOR_FLOW_H
+
+#include <cstdint>
+#include <string>
+
+// Inclusive ranges of IPv4 addresses and of ports, in host order
+struct address_range
+{
+    uint32_t first;
+    uint32_t last;
+};
+
+struct port_range
+{
+    uint16_t first;
+    uint16_t last;
+};
+
+// Every UDP 5-tuple a test's packets can carry - and so every one the DUT's output can, since the
+// packet processor passes the headers through untouched
+struct flow_ranges
+{
+    address_range src_ip;
+    address_range dest_ip;
+    port_range src_port;
+    port_range dst_port;
+};
+
+// Just the one flow the generator sends without a profile: -s to -d, with -p as both ports
+flow_ranges single_flow(const std::string& src_ip_addr, const std::string& dest_ip_addr, uint16_t port);
+
+// Accepts a.b.c.d, a.b.c.d-e.f.g.h or a.b.c.d/prefix. Returns false if text is none of those.
+bool parse_address_range(const std::string& text, address_range& range);
+
+// Accepts n or n-m. Returns false if text is neither.
+bool parse_port_range(const std::string& text, port_range& range);
+
+std::string address_to_string(uint32_t address);
+std::string address_range_to_string(const address_range& range);
+std::string port_range_to_string(const port_range& range);
+
+#endif //TRAFFIC_GENERATOR_FLOW_H
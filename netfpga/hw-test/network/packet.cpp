@@ -8,13 +8,14 @@
 #include <string>
 #include <cstring>
 #include <cstdint>
-#include <vector>
 #include <netinet/if_ether.h>
 #include <netinet/ip.h>
 #include <netinet/udp.h>
 #include <arpa/inet.h>
 #include <net/ethernet.h>
 
+#include "packet_template.h"
+
 uint16_t checksum16(const void* data, size_t len) {
     const uint8_t* p = static_cast<const uint8_t*>(data);
     uint32_t sum = 0;
@@ -37,6 +38,19 @@ uint16_t checksum16(const void* data, size_t len) {
     return static_cast<uint16_t>(~sum);
 }
 
+uint16_t checksum16_update(uint16_t checksum, uint16_t old_word, uint16_t new_word)
+{
+    // HC' = ~(~HC + ~m + m'), in one's complement arithmetic
+    uint32_t sum = static_cast<uint16_t>(~checksum);
+    sum += static_cast<uint16_t>(~old_word);
+    sum += new_word;
+
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return static_cast<uint16_t>(~sum);
+}
+
 struct iphdr create_ip_header(const std::string& src_ip_addr, const std::string& dest_ip_addr, size_t data_size)
 {
     struct iphdr header;
@@ -50,8 +64,8 @@ struct iphdr create_ip_header(const std::string& src_ip_addr, const std::string&
     header.ttl = 255;  // Time to live
 
     // A bit hacky, but it should be fine for now
-    static uint id = 0;
-    header.id = htonl(id++);
+    static uint16_t id = 0;
+    header.id = htons(id++);
 
     // These are values that we're kinda just ignoring
     header.tos = 0;
@@ -60,7 +74,7 @@ struct iphdr create_ip_header(const std::string& src_ip_addr, const std::string&
     header.tot_len = htons(sizeof(struct iphdr) + data_size);  // Total length
 
     header.check = 0;
-    header.check = checksum16((const uint16_t*)(&header), sizeof(header));
+    header.check = htons(checksum16(&header, sizeof(header)));
 
     return header;
 }
@@ -96,19 +110,10 @@ void create_udp_packet(char* buffer, const std::string& src_ip_addr, const std::
 
 void create_padded_udp_packet(char* buffer, const std::string& src_ip_addr, const std::string& dest_ip_addr, uint16_t src_port, uint16_t dst_port, const char* data, size_t data_size, size_t& packet_size)
 {
-    constexpr size_t ETH_HDR_LEN  = 14;
-    constexpr size_t IPV4_HDR_LEN = 20;
-    constexpr size_t UDP_HDR_LEN  = 8;
+    static uint16_t id = 0;
 
-    const size_t header_size = ETH_HDR_LEN + IPV4_HDR_LEN + UDP_HDR_LEN;
-
-    const size_t padding = (32 - (header_size % 32)) % 32;
-
-    const size_t padded_size = padding + data_size;
-    std::vector<char> padded_payload(padded_size, 0);
-    std::memcpy(padded_payload.data() + padding, data, data_size);
-
-    create_udp_packet(buffer, src_ip_addr, dest_ip_addr, src_port, dst_port, padded_payload.data(), padded_payload.size(), packet_size);
+    const packet_template packet_template = create_packet_template(src_ip_addr, dest_ip_addr, src_port, dst_port);
+    packet_size = write_padded_udp_packet(packet_template, buffer, data, data_size, id++);
 }
 
 void send_packet(int socket_fd, char* buffer, ssize_t data_size, const std::string& dest_ip_addr, uint dest_port)
@@ -126,6 +131,12 @@ void send_packet(int socket_fd, char* buffer, ssize_t data_size, const std::stri
 }
 
 bool receive_packet(int socket_fd, char* buffer, size_t buffer_size, ssize_t& data_size, int timeout_ms)
+{
+    uint64_t timestamp_ns;
+    return receive_packet(socket_fd, buffer, buffer_size, data_size, timestamp_ns, timeout_ms);
+}
+
+bool receive_packet(int socket_fd, char* buffer, size_t buffer_size, ssize_t& data_size, uint64_t& timestamp_ns, int timeout_ms)
 {
     fd_set readfds;
     FD_ZERO(&readfds);
@@ -150,14 +161,38 @@ bool receive_packet(int socket_fd, char* buffer, size_t buffer_size, ssize_t& da
         return false;
     }
 
-    // Data is ready to read
-    data_size = recvfrom(socket_fd, buffer, buffer_size, 0, nullptr, nullptr);
+    // Data is ready to read. recvmsg rather than recvfrom, so the kernel's receive timestamp comes
+    // along as a control message
+    struct iovec iov{};
+    iov.iov_base = buffer;
+    iov.iov_len = buffer_size;
+
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(struct timespec))];
+
+    struct msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    data_size = recvmsg(socket_fd, &message, 0);
     if (data_size < 0)
     {
         perror("Error receiving packet");
         exit(-1);
     }
 
+    timestamp_ns = 0;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            struct timespec ts;
+            std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            timestamp_ns = static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+        }
+    }
+
     return true; // successfully received a packet
 }
 
@@ -332,4 +367,25 @@ bool is_dhcp_packet(uint16_t src_port, uint16_t dst_port)
     if (src_port == 67 || src_port == 68) return true;
     if (dst_port == 67 || dst_port == 68) return true;
     return false;
-}
\ No newline at end of file
+}
+
+bool is_ipv4_frame(const uint8_t* frame, size_t len)
+{
+    if (len < sizeof(ethhdr) + sizeof(iphdr)) return false;
+
+    ethhdr eth{};
+    std::memcpy(&eth, frame, sizeof(eth));
+
+    return ntohs(eth.h_proto) == ETH_P_IP && (frame[sizeof(ethhdr)] >> 4) == 4;
+}
+
+size_t ethernet_wire_size(size_t ip_packet_size)
+{
+    constexpr size_t header_size     = 14;
+    constexpr size_t fcs_size        = 4;
+    constexpr size_t min_frame_size  = 64;
+    constexpr size_t preamble_size   = 8;
+    constexpr size_t interframe_gap  = 12;
+
+    return std::max(header_size + ip_packet_size + fcs_size, min_frame_size) + preamble_size + interframe_gap;
+}
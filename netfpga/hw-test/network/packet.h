@@ -8,13 +8,26 @@
 #include <string>
 #include <cstdint>
 
+// The Internet checksum of len bytes, in host order
+uint16_t checksum16(const void* data, size_t len);
+
+// The checksum (host order) of data whose checksum was checksum, after one of its 16 bit words
+// changed from old_word to new_word (both host order) - RFC 1624's incremental update
+uint16_t checksum16_update(uint16_t checksum, uint16_t old_word, uint16_t new_word);
+
 void create_ip_packet(char* buffer, const std::string& src_ip_addr, const std::string& dest_ip_addr, char* data, size_t data_size, size_t& packet_size);
 void create_udp_packet(char* buffer, const std::string& src_ip_addr, const std::string& dest_ip_addr, uint16_t src_port, uint16_t dst_port, char* data, size_t data_size, size_t& packet_size);
+// Builds its headers from scratch each call - anything sending more than a handful of packets should
+// use a packet_template (see network/packet_template.h) instead
 void create_padded_udp_packet(char* buffer, const std::string& src_ip_addr, const std::string& dest_ip_addr, uint16_t src_port, uint16_t dst_port, const char* data, size_t data_size, size_t& packet_size);
 
 void send_packet(int socket_fd, char* buffer, ssize_t data_size, const std::string& dest_ip_addr, uint dest_port);
 bool receive_packet(int socket_fd, char* buffer, size_t buffer_size, ssize_t& data_size, int timeout_ms);
 
+// As receive_packet, but also reports when the kernel received the packet (CLOCK_REALTIME), or 0 if
+// the socket doesn't have SO_TIMESTAMPNS enabled
+bool receive_packet(int socket_fd, char* buffer, size_t buffer_size, ssize_t& data_size, uint64_t& timestamp_ns, int timeout_ms);
+
 bool extract_udp_payload(
     const uint8_t* frame,
     size_t len,
@@ -32,5 +45,10 @@ bool extract_padded_udp_payload(
     uint16_t& dst_port
 );
 bool is_dhcp_packet(uint16_t src_port, uint16_t dst_port);
+bool is_ipv4_frame(const uint8_t* frame, size_t len);
+
+// Bytes an IP packet of ip_packet_size occupies on an Ethernet wire: the Ethernet header, padding up
+// to the minimum frame size, the FCS, the preamble/SFD and the inter-frame gap
+size_t ethernet_wire_size(size_t ip_packet_size);
 
 #endif //TRAFFIC_GENERATOR_PACKET_H
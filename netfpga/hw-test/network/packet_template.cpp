@@ -0,0 +1,87 @@
+#include "packet_template.h"
+
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+
+#include "packet.h"
+
+// Offsets into the template's IP header, then its UDP header
+constexpr size_t IP_TOTAL_LENGTH_OFFSET = 2;
+constexpr size_t IP_ID_OFFSET = 4;
+constexpr size_t IP_CHECKSUM_OFFSET = 10;
+constexpr size_t UDP_LENGTH_OFFSET = sizeof(iphdr) + 4;
+
+static uint16_t load16(const char* field)
+{
+    uint16_t value;
+    std::memcpy(&value, field, sizeof(value));
+    return ntohs(value);
+}
+
+static void store16(char* field, uint16_t value)
+{
+    value = htons(value);
+    std::memcpy(field, &value, sizeof(value));
+}
+
+// Sets a 16 bit field of an IP header, folding the change into the header's checksum
+static void patch_ip_field(char* ip_header, size_t offset, uint16_t value)
+{
+    const uint16_t checksum = load16(ip_header + IP_CHECKSUM_OFFSET);
+    store16(ip_header + IP_CHECKSUM_OFFSET, checksum16_update(checksum, load16(ip_header + offset), value));
+    store16(ip_header + offset, value);
+}
+
+packet_template create_packet_template(const std::string& src_ip_addr, const std::string& dest_ip_addr, uint16_t src_port, uint16_t dst_port)
+{
+    return create_packet_template(ntohl(inet_addr(src_ip_addr.c_str())), ntohl(inet_addr(dest_ip_addr.c_str())), src_port, dst_port);
+}
+
+packet_template create_packet_template(uint32_t src_ip, uint32_t dest_ip, uint16_t src_port, uint16_t dst_port)
+{
+    packet_template packet_template{};
+
+    // The length and id are left 0, for each packet to patch in
+    iphdr ip_header{};
+    ip_header.ihl = 5;
+    ip_header.version = 4;
+    ip_header.ttl = 255;
+    ip_header.protocol = IPPROTO_UDP;
+    ip_header.saddr = htonl(src_ip);
+    ip_header.daddr = htonl(dest_ip);
+    ip_header.check = htons(checksum16(&ip_header, sizeof(ip_header)));
+
+    // 0 = no checksum for IPv4
+    udphdr udp_header{};
+    udp_header.source = htons(src_port);
+    udp_header.dest = htons(dst_port);
+
+    // The padding stays zeroed
+    std::memcpy(packet_template.headers, &ip_header, sizeof(ip_header));
+    std::memcpy(packet_template.headers + sizeof(ip_header), &udp_header, sizeof(udp_header));
+
+    return packet_template;
+}
+
+size_t write_padded_udp_packet(const packet_template& packet_template, char* buffer, const char* data, size_t data_size, uint16_t id)
+{
+    const size_t packet_size = PADDED_UDP_HEADER_SIZE + data_size;
+
+    std::memcpy(buffer, packet_template.headers, PADDED_UDP_HEADER_SIZE);
+    std::memcpy(buffer + PADDED_UDP_HEADER_SIZE, data, data_size);
+
+    patch_ip_field(buffer, IP_TOTAL_LENGTH_OFFSET, static_cast<uint16_t>(packet_size));
+    patch_ip_field(buffer, IP_ID_OFFSET, id);
+    store16(buffer + UDP_LENGTH_OFFSET, static_cast<uint16_t>(packet_size - sizeof(iphdr)));
+
+    return packet_size;
+}
+
+void set_packet_id(char* ip_packet, uint16_t id)
+{
+    patch_ip_field(ip_packet, IP_ID_OFFSET, id);
+}
@@ -0,0 +1,37 @@
+#ifndef TRAFFIC_GENERATOR_PACKET_TEMPLATE_H
+#define TRAFFIC_GENERATOR_PACKET_TEMPLATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// The IP and UDP headers of a padded UDP packet, and the padding that aligns its body to a beat (see
+// network/stamp.h) - with the 14 byte Ethernet header in front, 64 bytes, or two beats
+constexpr size_t PADDED_UDP_HEADER_SIZE = 20 + 8 + 22;
+
+// The part of such a packet's Ethernet frame that isn't body: the Ethernet header, the padded UDP
+// headers and the FCS. The smallest frame that carries any body at all is one byte more.
+constexpr size_t PADDED_UDP_FRAME_OVERHEAD = 14 + PADDED_UDP_HEADER_SIZE + 4;
+
+// The headers of one flow's padded UDP packets, built once: the addresses are parsed and the IP
+// header checksummed here, and never again. Writing a packet from a template copies the headers and
+// patches only what varies from packet to packet - the lengths, the IP id and the body - folding the
+// changes into the checksum incrementally (RFC 1624) instead of recomputing it.
+struct packet_template
+{
+    char headers[PADDED_UDP_HEADER_SIZE];
+};
+
+packet_template create_packet_template(const std::string& src_ip_addr, const std::string& dest_ip_addr, uint16_t src_port, uint16_t dst_port);
+
+// As above, with the addresses already parsed (host order)
+packet_template create_packet_template(uint32_t src_ip, uint32_t dest_ip, uint16_t src_port, uint16_t dst_port);
+
+// Writes a packet carrying data_size bytes of data into buffer, which must have room for
+// PADDED_UDP_HEADER_SIZE more than that. Returns the packet's size.
+size_t write_padded_udp_packet(const packet_template& packet_template, char* buffer, const char* data, size_t data_size, uint16_t id);
+
+// Renumbers an IP packet already built (from a template or not), patching its header checksum
+void set_packet_id(char* ip_packet, uint16_t id);
+
+#endif //TRAFFIC_GENERATOR_PACKET_TEMPLATE_H
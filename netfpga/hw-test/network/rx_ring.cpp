@@ -0,0 +1,148 @@
+#include "rx_ring.h"
+
+#include "socket.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static tpacket_block_desc* block_at(const rx_ring& ring, unsigned int index)
+{
+    return reinterpret_cast<tpacket_block_desc*>(ring.map + static_cast<size_t>(index) * ring.block_size);
+}
+
+rx_ring create_rx_ring(const std::string& interface_name, const rx_ring_config& config, const std::vector<sock_filter>& filter)
+{
+    rx_ring ring;
+    ring.socket_fd = create_receive_socket(interface_name, filter);
+    ring.block_size = config.block_size;
+    ring.block_count = config.block_count;
+
+    int version = TPACKET_V3;
+    if (setsockopt(ring.socket_fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+    {
+        perror("Failed to select TPACKET_V3");
+        exit(-1);
+    }
+
+    tpacket_req3 request{};
+    request.tp_block_size = config.block_size;
+    request.tp_block_nr = config.block_count;
+    request.tp_frame_size = config.frame_size;
+    request.tp_frame_nr = (config.block_size / config.frame_size) * config.block_count;
+    request.tp_retire_blk_tov = config.block_timeout_ms;
+    request.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+
+    if (setsockopt(ring.socket_fd, SOL_PACKET, PACKET_RX_RING, &request, sizeof(request)) < 0)
+    {
+        perror("Failed to create receive ring (check the block and frame sizes)");
+        exit(-1);
+    }
+
+    ring.map_size = static_cast<size_t>(config.block_size) * config.block_count;
+    void* map = mmap(nullptr, ring.map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, ring.socket_fd, 0);
+    if (map == MAP_FAILED)
+    {
+        // MAP_LOCKED can trip RLIMIT_MEMLOCK for larger rings - the ring still works unlocked, it can
+        // just take page faults the first time each block is touched
+        map = mmap(nullptr, ring.map_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring.socket_fd, 0);
+    }
+    if (map == MAP_FAILED)
+    {
+        perror("Failed to map receive ring");
+        exit(-1);
+    }
+    ring.map = static_cast<uint8_t*>(map);
+
+    return ring;
+}
+
+void destroy_rx_ring(rx_ring& ring)
+{
+    if (ring.map) munmap(ring.map, ring.map_size);
+    if (ring.socket_fd >= 0) close(ring.socket_fd);
+
+    ring.map = nullptr;
+    ring.socket_fd = -1;
+    ring.block = nullptr;
+}
+
+static void release_block(rx_ring& ring)
+{
+    // Hand the block back to the kernel - the release store keeps our reads of its frames from being
+    // reordered after the kernel is allowed to overwrite them
+    __atomic_store_n(&ring.block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+
+    ring.block = nullptr;
+    ring.block_index = (ring.block_index + 1) % ring.block_count;
+}
+
+bool receive_frame(rx_ring& ring, const uint8_t*& frame, size_t& frame_size, uint64_t& timestamp_ns, int timeout_ms)
+{
+    while (true)
+    {
+        if (ring.block && ring.frames_left == 0) release_block(ring);
+
+        if (!ring.block)
+        {
+            tpacket_block_desc* block = block_at(ring, ring.block_index);
+
+            if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+            {
+                pollfd pfd{};
+                pfd.fd = ring.socket_fd;
+                pfd.events = POLLIN | POLLERR;
+
+                int ret = poll(&pfd, 1, timeout_ms);
+                if (ret < 0)
+                {
+                    perror("poll failed");
+                    exit(-1);
+                }
+
+                if (ret == 0) return false;
+
+                continue;
+            }
+
+            ring.block = block;
+            ring.frames_left = block->hdr.bh1.num_pkts;
+            ring.next_frame = reinterpret_cast<tpacket3_hdr*>(reinterpret_cast<uint8_t*>(block) + block->hdr.bh1.offset_to_first_pkt);
+
+            continue;
+        }
+
+        tpacket3_hdr* header = ring.next_frame;
+
+        frame = reinterpret_cast<const uint8_t*>(header) + header->tp_mac;
+        frame_size = header->tp_snaplen;
+        timestamp_ns = static_cast<uint64_t>(header->tp_sec) * 1000000000ull + header->tp_nsec;
+
+        ring.next_frame = reinterpret_cast<tpacket3_hdr*>(reinterpret_cast<uint8_t*>(header) + header->tp_next_offset);
+        --ring.frames_left;
+
+        return true;
+    }
+}
+
+rx_ring_statistics get_rx_ring_statistics(const rx_ring& ring)
+{
+    tpacket_stats_v3 stats{};
+    socklen_t length = sizeof(stats);
+
+    if (getsockopt(ring.socket_fd, SOL_PACKET, PACKET_STATISTICS, &stats, &length) < 0)
+    {
+        perror("Failed to read receive ring statistics");
+        exit(-1);
+    }
+
+    return rx_ring_statistics
+    {
+        .packets = stats.tp_packets,
+        .drops = stats.tp_drops
+    };
+}
@@ -0,0 +1,60 @@
+#ifndef TRAFFIC_GENERATOR_RX_RING_H
+#define TRAFFIC_GENERATOR_RX_RING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <linux/filter.h>
+#include <linux/if_packet.h>
+
+// Geometry of a TPACKET_V3 receive ring. The kernel fills whole blocks with variable-length frames
+// and hands a block to user space once it's full or block_timeout_ms has passed, so block_size
+// trades latency for syscall/poll overhead. block_size must be a multiple of the page size and
+// frame_size a multiple of TPACKET_ALIGNMENT; frame_size only bounds the largest frame, it doesn't
+// reserve a fixed slot per frame the way TPACKET_V1/V2 do.
+struct rx_ring_config
+{
+    unsigned int block_size = 1 << 20;
+    unsigned int block_count = 64;
+    unsigned int frame_size = 1 << 11;
+    unsigned int block_timeout_ms = 10;
+};
+
+struct rx_ring
+{
+    int socket_fd = -1;
+    uint8_t* map = nullptr;
+    size_t map_size = 0;
+    unsigned int block_size = 0;
+    unsigned int block_count = 0;
+
+    // The block currently owned by user space (nullptr while waiting on the kernel), and where in it
+    // the next frame starts
+    unsigned int block_index = 0;
+    tpacket_block_desc* block = nullptr;
+    tpacket3_hdr* next_frame = nullptr;
+    unsigned int frames_left = 0;
+};
+
+struct rx_ring_statistics
+{
+    uint64_t packets;
+    uint64_t drops;
+};
+
+// Opens a promiscuous AF_PACKET socket on interface_name (as create_receive_socket does, filter and
+// all) and maps a TPACKET_V3 ring onto it.
+rx_ring create_rx_ring(const std::string& interface_name, const rx_ring_config& config, const std::vector<sock_filter>& filter);
+void destroy_rx_ring(rx_ring& ring);
+
+// Points frame at the next received frame, in place in the ring - no copy is made, so frame is only
+// valid until the next call to receive_frame on this ring. timestamp_ns is when the kernel received
+// the frame (CLOCK_REALTIME). Returns false if nothing arrived within timeout_ms.
+bool receive_frame(rx_ring& ring, const uint8_t*& frame, size_t& frame_size, uint64_t& timestamp_ns, int timeout_ms);
+
+// Frames seen and frames the kernel dropped (because the ring was full) since the last call.
+rx_ring_statistics get_rx_ring_statistics(const rx_ring& ring);
+
+#endif //TRAFFIC_GENERATOR_RX_RING_H
@@ -96,19 +96,77 @@ int create_transmit_socket(const std::string& interface_name)
     return socket_fd;
 }
 
-void set_static_arp_entry(const std::string& interface_name, const std::string& dest_ip, const std::string& dest_mac)
+int create_frame_transmit_socket(const std::string& interface_name)
 {
-    std::cout << "    Setting static ARP entry: " << dest_ip << " -> " << dest_mac << " on " << interface_name << std::endl;
+    // Protocol 0: this socket only ever sends, so it shouldn't have frames queued on it
+    int socket_fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if (socket_fd < 0)
+    {
+        perror("Failed to create AF_PACKET transmit socket");
+        exit(-1);
+    }
+
+    sockaddr_ll sll{};
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = 0;
+    sll.sll_ifindex = if_nametoindex(interface_name.c_str());
+    if (sll.sll_ifindex == 0)
+    {
+        perror("Failed to get interface index");
+        exit(-1);
+    }
+
+    if (bind(socket_fd, reinterpret_cast<sockaddr*>(&sll), sizeof(sll)) < 0)
+    {
+        perror(("Failed to bind AF_PACKET transmit socket to " + interface_name).c_str());
+        exit(-1);
+    }
 
+    return socket_fd;
+}
+
+void parse_mac_address(const std::string& mac, uint8_t bytes[6])
+{
     unsigned int mac_bytes[6];
-    if (sscanf(dest_mac.c_str(), "%x:%x:%x:%x:%x:%x",
+    if (sscanf(mac.c_str(), "%x:%x:%x:%x:%x:%x",
                &mac_bytes[0], &mac_bytes[1], &mac_bytes[2],
                &mac_bytes[3], &mac_bytes[4], &mac_bytes[5]) != 6)
     {
-        std::cerr << "Failed to parse MAC address: " << dest_mac << std::endl;
+        std::cerr << "Failed to parse MAC address: " << mac << std::endl;
         exit(-1);
     }
 
+    for (int i = 0; i < 6; i++)
+        bytes[i] = static_cast<uint8_t>(mac_bytes[i]);
+}
+
+void get_interface_mac(const std::string& interface_name, uint8_t bytes[6])
+{
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sockfd < 0)
+    {
+        perror("Failed to create socket for reading MAC address");
+        exit(-1);
+    }
+
+    ifreq ifr = create_interface_request(interface_name.c_str());
+    if (ioctl(sockfd, SIOCGIFHWADDR, &ifr) < 0)
+    {
+        perror("Failed to read interface MAC address");
+        exit(-1);
+    }
+
+    std::memcpy(bytes, ifr.ifr_hwaddr.sa_data, 6);
+    close(sockfd);
+}
+
+void set_static_arp_entry(const std::string& interface_name, const std::string& dest_ip, const std::string& dest_mac)
+{
+    std::cout << "    Setting static ARP entry: " << dest_ip << " -> " << dest_mac << " on " << interface_name << std::endl;
+
+    uint8_t mac_bytes[6];
+    parse_mac_address(dest_mac, mac_bytes);
+
     arpreq req{};
 
     auto* protocol_addr = reinterpret_cast<sockaddr_in*>(&req.arp_pa);
@@ -140,14 +198,27 @@ void set_static_arp_entry(const std::string& interface_name, const std::string&
     close(sockfd);
 }
 
-int create_receive_socket(const std::string& interface_name)
+int create_receive_socket(const std::string& interface_name, const std::vector<sock_filter>& filter)
 {
-    int sockfd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    // Protocol 0 receives nothing until bind() names one, which leaves room to attach the filter
+    // before the first frame is queued
+    int sockfd = socket(AF_PACKET, SOCK_RAW, 0);
     if (sockfd < 0) {
         perror("Failed to create AF_PACKET receive socket");
         exit(EXIT_FAILURE);
     }
 
+    if (!filter.empty()) {
+        struct sock_fprog program{};
+        program.len = static_cast<unsigned short>(filter.size());
+        program.filter = const_cast<sock_filter*>(filter.data());
+
+        if (setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program)) < 0) {
+            perror("Failed to attach receive filter");
+            exit(EXIT_FAILURE);
+        }
+    }
+
     set_promiscuous_mode(sockfd, interface_name.c_str(), true);
 
     // Bind specifically to this interface
@@ -166,4 +237,14 @@ int create_receive_socket(const std::string& interface_name)
     }
 
     return sockfd;
-}
\ No newline at end of file
+}
+
+void enable_receive_timestamps(int socket_fd)
+{
+    int enabled = 1;
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_TIMESTAMPNS, &enabled, sizeof(enabled)) < 0)
+    {
+        perror("Failed to enable SO_TIMESTAMPNS");
+        exit(EXIT_FAILURE);
+    }
+}
@@ -5,10 +5,25 @@
 #ifndef TRAFFIC_GENERATOR_SOCKET_H
 #define TRAFFIC_GENERATOR_SOCKET_H
 
+#include <cstdint>
 #include <string>
+#include <vector>
+
+#include <linux/filter.h>
 
 int create_transmit_socket(const std::string& interface_name);
-int create_receive_socket(const std::string& interface_name);
+// Sends whole Ethernet frames, exactly as given, out of interface_name
+int create_frame_transmit_socket(const std::string& interface_name);
+// filter (see network/filter.h), if it isn't empty, is attached before the socket is bound, so not
+// even the frames that arrive while it's being set up get past it
+int create_receive_socket(const std::string& interface_name, const std::vector<sock_filter>& filter);
+
+// Has the kernel stamp every received packet with its arrival time, for receive_packet to report
+void enable_receive_timestamps(int socket_fd);
+
+// "aa:bb:cc:dd:ee:ff" into six bytes; exits if it doesn't parse
+void parse_mac_address(const std::string& mac, uint8_t bytes[6]);
+void get_interface_mac(const std::string& interface_name, uint8_t bytes[6]);
 
 // Installs a permanent ARP entry mapping dest_ip to dest_mac on interface_name, so the kernel
 // can address outgoing packets without ever needing a live ARP reply. Requires CAP_NET_ADMIN.
@@ -0,0 +1,52 @@
+#include "stamp.h"
+
+#include <cstring>
+#include <ctime>
+
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+
+#include "packet.h"
+#include "packet_template.h"
+
+static constexpr char STAMP_MAGIC[4] = {'G', 'A', 'P', 'L'};
+
+uint64_t realtime_ns()
+{
+    timespec now{};
+    clock_gettime(CLOCK_REALTIME, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+}
+
+void write_stamp(char* ip_packet, size_t packet_size, uint64_t sequence, uint64_t tx_ns)
+{
+    // create_padded_udp_packet always builds a 20 byte IP header, followed by the UDP header
+    constexpr size_t padding_offset = sizeof(iphdr) + sizeof(udphdr);
+    if (packet_size < padding_offset + STAMP_SIZE) return;
+
+    set_packet_id(ip_packet, static_cast<uint16_t>(sequence));
+
+    char* stamp = ip_packet + padding_offset;
+    std::memcpy(stamp, STAMP_MAGIC, sizeof(STAMP_MAGIC));
+    std::memcpy(stamp + 4, &sequence, sizeof(sequence));
+    std::memcpy(stamp + 12, &tx_ns, sizeof(tx_ns));
+}
+
+bool read_stamp(const uint8_t* frame, size_t frame_size, packet_stamp& stamp)
+{
+    const uint8_t* payload = nullptr;
+    size_t payload_len = 0;
+    uint16_t src_port = 0;
+    uint16_t dst_port = 0;
+
+    // The unpadded payload starts at the padding, which is where the stamp lives
+    if (!extract_udp_payload(frame, frame_size, payload, payload_len, src_port, dst_port))
+        return false;
+
+    if (payload_len < STAMP_SIZE) return false;
+    if (std::memcmp(payload, STAMP_MAGIC, sizeof(STAMP_MAGIC)) != 0) return false;
+
+    std::memcpy(&stamp.sequence, payload + 4, sizeof(stamp.sequence));
+    std::memcpy(&stamp.tx_ns, payload + 12, sizeof(stamp.tx_ns));
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef TRAFFIC_GENERATOR_STAMP_H
+#define TRAFFIC_GENERATOR_STAMP_H
+
+#include <cstddef>
+#include <cstdint>
+
+// The NetFPGA packet processor passes the first two beats of every frame (the Ethernet, IP and UDP
+// headers, plus the padding that aligns the body to a beat) through untouched; only the body is fed
+// to the kernel. That padding comes back exactly as we sent it, so it can carry a stamp identifying
+// the packet and when it left:
+//
+//   bytes 0-3   "GAPL"
+//   bytes 4-11  sequence number
+//   bytes 12-19 transmit time, CLOCK_REALTIME in nanoseconds
+//
+// (host byte order - the stamp is only ever read back by the host that wrote it)
+struct packet_stamp
+{
+    uint64_t sequence;
+    uint64_t tx_ns;
+};
+
+constexpr size_t STAMP_SIZE = 20;
+
+// CLOCK_REALTIME in nanoseconds - the clock the kernel stamps received frames with, so the two can be
+// subtracted directly
+uint64_t realtime_ns();
+
+// Writes a stamp into the padding of an IP packet built by create_padded_udp_packet (or from a
+// packet_template), and numbers the packet's IP id after the low bits of its sequence number. Both are
+// patched in place, so this is cheap enough to do to every packet on its way out.
+void write_stamp(char* ip_packet, size_t packet_size, uint64_t sequence, uint64_t tx_ns);
+
+// Reads the stamp back out of a received Ethernet frame. Returns false if the frame isn't a padded
+// UDP packet, or carries no stamp.
+bool read_stamp(const uint8_t* frame, size_t frame_size, packet_stamp& stamp);
+
+#endif //TRAFFIC_GENERATOR_STAMP_H
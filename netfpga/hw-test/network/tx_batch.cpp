@@ -0,0 +1,101 @@
+#include "tx_batch.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+#include <arpa/inet.h>
+#include <sched.h>
+
+#include "stamp.h"
+
+void add_packet(packet_set& set, const char* packet, size_t packet_size)
+{
+    set.offsets.push_back(set.storage.size());
+    set.sizes.push_back(packet_size);
+    set.storage.insert(set.storage.end(), packet, packet + packet_size);
+}
+
+char* add_packet(packet_set& set, size_t packet_size)
+{
+    set.offsets.push_back(set.storage.size());
+    set.sizes.push_back(packet_size);
+    set.storage.resize(set.storage.size() + packet_size);
+    return set.storage.data() + set.offsets.back();
+}
+
+tx_batch create_tx_batch(int socket_fd, const std::string& dest_ip_addr, size_t batch_size)
+{
+    tx_batch batch{};
+    batch.socket_fd = socket_fd;
+
+    batch.destination.sin_family = AF_INET;
+    batch.destination.sin_addr.s_addr = inet_addr(dest_ip_addr.c_str());
+
+    batch.messages.resize(batch_size);
+    batch.iovecs.resize(batch_size);
+
+    return batch;
+}
+
+void send_packets(tx_batch& batch, packet_set& set, size_t first, size_t count)
+{
+    const size_t total = packet_count(set);
+    size_t index = first % total;
+
+    while (count > 0)
+    {
+        size_t batch_count = std::min(count, batch.messages.size());
+
+        // The kernel only copies the packets out during sendmmsg, so a batch can't restamp a packet
+        // it already holds
+        if (batch.stamp) batch_count = std::min(batch_count, total);
+
+        for (size_t i = 0; i < batch_count; ++i)
+        {
+            if (batch.stamp) write_stamp(packet_data(set, index), set.sizes[index], batch.next_sequence++, realtime_ns());
+
+            batch.iovecs[i].iov_base = packet_data(set, index);
+            batch.iovecs[i].iov_len = set.sizes[index];
+            index = (index + 1 == total) ? 0 : index + 1;
+        }
+
+        send_batch(batch, batch_count);
+
+        count -= batch_count;
+    }
+}
+
+void send_batch(tx_batch& batch, size_t count)
+{
+    // Pointed at batch as it is now, rather than when it was created, since it may have moved since
+    for (size_t i = 0; i < count; ++i)
+    {
+        msghdr& header = batch.messages[i].msg_hdr;
+        header.msg_name = &batch.destination;
+        header.msg_namelen = sizeof(batch.destination);
+        header.msg_iov = &batch.iovecs[i];
+        header.msg_iovlen = 1;
+    }
+
+    size_t sent = 0;
+    while (sent < count)
+    {
+        int ret = sendmmsg(batch.socket_fd, batch.messages.data() + sent, count - sent, 0);
+        if (ret < 0)
+        {
+            // A full qdisc or socket buffer just means we're outrunning the NIC - back off and retry
+            if (errno == ENOBUFS || errno == EAGAIN || errno == EINTR)
+            {
+                sched_yield();
+                continue;
+            }
+
+            perror("Failed to send packets");
+            exit(-1);
+        }
+
+        sent += static_cast<size_t>(ret);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef TRAFFIC_GENERATOR_TX_BATCH_H
+#define TRAFFIC_GENERATOR_TX_BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+// Packets built once up front and stored back to back, so sending them never has to build, parse
+// or copy anything
+struct packet_set
+{
+    std::vector<char> storage;
+    std::vector<size_t> offsets;
+    std::vector<size_t> sizes;
+};
+
+void add_packet(packet_set& set, const char* packet, size_t packet_size);
+
+// Makes room for a packet of packet_size at the end of set, for the caller to build it in place. The
+// pointer is only good until the next packet is added.
+char* add_packet(packet_set& set, size_t packet_size);
+
+inline size_t packet_count(const packet_set& set) { return set.sizes.size(); }
+inline char* packet_data(packet_set& set, size_t index) { return set.storage.data() + set.offsets[index]; }
+
+// One mmsghdr/iovec per slot of a sendmmsg batch, all addressed to a destination that's parsed once.
+// The messages only point at the destination and their iovecs once send_batch fills them in, so a
+// batch can be returned, moved or copied like any other value.
+struct tx_batch
+{
+    int socket_fd;
+    sockaddr_in destination;
+    std::vector<mmsghdr> messages;
+    std::vector<iovec> iovecs;
+
+    // When set, each packet gets a fresh stamp (see network/stamp.h) just before it's handed to the
+    // kernel, numbered from next_sequence
+    bool stamp;
+    uint64_t next_sequence;
+};
+
+tx_batch create_tx_batch(int socket_fd, const std::string& dest_ip_addr, size_t batch_size);
+
+// Sends count packets of set, starting at first and wrapping around to the start of set, handing
+// the kernel at most one batch per sendmmsg call. Retries when the socket's send queue is full
+// rather than dropping anything.
+void send_packets(tx_batch& batch, packet_set& set, size_t first, size_t count);
+
+// Sends the packets already filled into the first count iovecs of batch, the same way
+void send_batch(tx_batch& batch, size_t count);
+
+#endif //TRAFFIC_GENERATOR_TX_BATCH_H
@@ -0,0 +1,442 @@
+#include "uring.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <arpa/inet.h>
+#include <linux/time_types.h>
+#include <netinet/in.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "stamp.h"
+
+// user_data of the multishot receive's completions
+constexpr uint64_t RECEIVE_USER_DATA = 1;
+
+// The group the receive buffers are provided under
+constexpr uint16_t RECEIVE_BUFFER_GROUP = 0;
+
+static int io_uring_setup(uint32_t entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int io_uring_enter(int ring_fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags, const void* arg, size_t arg_size)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_size));
+}
+
+static int io_uring_register(int ring_fd, uint32_t opcode, const void* arg, uint32_t count)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, ring_fd, opcode, arg, count));
+}
+
+static inline uint32_t load_acquire(const uint32_t* index) { return __atomic_load_n(index, __ATOMIC_ACQUIRE); }
+static inline void store_release(uint32_t* index, uint32_t value) { __atomic_store_n(index, value, __ATOMIC_RELEASE); }
+
+static void* map_or_exit(size_t size, int fd, off_t offset, const char* name)
+{
+    void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    if (map == MAP_FAILED)
+    {
+        perror(("Failed to map the io_uring " + std::string(name)).c_str());
+        exit(-1);
+    }
+
+    return map;
+}
+
+// cq_entries of 0 leaves the completion queue at the kernel's default, twice the submission queue
+static uring create_uring(uint32_t entries, uint32_t cq_entries)
+{
+    // Not IORING_SETUP_SINGLE_ISSUER: receive rings are set up on the main thread, then handed to a
+    // worker
+    io_uring_params params{};
+    params.flags = IORING_SETUP_COOP_TASKRUN;
+    if (cq_entries > 0)
+    {
+        params.flags |= IORING_SETUP_CQSIZE;
+        params.cq_entries = cq_entries;
+    }
+
+    int ring_fd = io_uring_setup(entries, &params);
+
+    // Cooperative task running is only a hint, and older kernels reject it
+    if (ring_fd < 0 && errno == EINVAL)
+    {
+        params.flags &= ~IORING_SETUP_COOP_TASKRUN;
+        ring_fd = io_uring_setup(entries, &params);
+    }
+
+    if (ring_fd < 0)
+    {
+        perror("Failed to set up io_uring");
+        exit(-1);
+    }
+
+    if (!(params.features & IORING_FEAT_EXT_ARG))
+    {
+        std::cerr << "io_uring on this kernel can't wait with a timeout (needs Linux 5.11 or later)" << std::endl;
+        exit(-1);
+    }
+
+    uring ring{};
+    ring.ring_fd = ring_fd;
+    ring.sq_entries = params.sq_entries;
+    ring.sq_map_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring.cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ring.sqes_map_size = params.sq_entries * sizeof(io_uring_sqe);
+
+    // Both queues usually share one mapping
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring.sq_map_size = ring.cq_map_size = std::max(ring.sq_map_size, ring.cq_map_size);
+        ring.sq_map = map_or_exit(ring.sq_map_size, ring_fd, IORING_OFF_SQ_RING, "queues");
+        ring.cq_map = ring.sq_map;
+    }
+    else
+    {
+        ring.sq_map = map_or_exit(ring.sq_map_size, ring_fd, IORING_OFF_SQ_RING, "submission queue");
+        ring.cq_map = map_or_exit(ring.cq_map_size, ring_fd, IORING_OFF_CQ_RING, "completion queue");
+    }
+
+    ring.sqes = static_cast<io_uring_sqe*>(map_or_exit(ring.sqes_map_size, ring_fd, IORING_OFF_SQES, "submissions"));
+
+    uint8_t* sq = static_cast<uint8_t*>(ring.sq_map);
+    ring.sq_head = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+    ring.sq_tail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+    ring.sq_mask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+    ring.sq_array = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+
+    uint8_t* cq = static_cast<uint8_t*>(ring.cq_map);
+    ring.cq_head = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+    ring.cq_tail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+    ring.cq_mask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+    ring.cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // Every submission sits in the slot of the same number, so the indirection array never changes
+    for (uint32_t i = 0; i < ring.sq_entries; ++i) ring.sq_array[i] = i;
+
+    return ring;
+}
+
+static void destroy_uring(uring& ring)
+{
+    munmap(ring.sqes, ring.sqes_map_size);
+    if (ring.cq_map != ring.sq_map) munmap(ring.cq_map, ring.cq_map_size);
+    munmap(ring.sq_map, ring.sq_map_size);
+    close(ring.ring_fd);
+}
+
+// The submission offset slots past the tail, cleared. Only becomes the kernel's once published.
+static io_uring_sqe* submission_slot(uring& ring, uint32_t offset)
+{
+    io_uring_sqe* sqe = &ring.sqes[(*ring.sq_tail + offset) & ring.sq_mask];
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+static void publish_submissions(uring& ring, uint32_t count)
+{
+    store_release(ring.sq_tail, *ring.sq_tail + count);
+}
+
+// Submits to_submit published submissions and waits until min_complete completions are waiting,
+// without a timeout. Returns the negated errno on failure.
+static int submit_and_wait(uring& ring, uint32_t to_submit, uint32_t min_complete)
+{
+    while (true)
+    {
+        const int result = io_uring_enter(ring.ring_fd, to_submit, min_complete, min_complete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        if (result >= 0) return result;
+        if (errno != EINTR) return -errno;
+    }
+}
+
+// Whether a completion is waiting, and if so, copies it out and consumes it
+static bool next_completion(uring& ring, io_uring_cqe& cqe)
+{
+    const uint32_t head = *ring.cq_head;
+    if (head == load_acquire(ring.cq_tail)) return false;
+
+    cqe = ring.cqes[head & ring.cq_mask];
+    store_release(ring.cq_head, head + 1);
+    return true;
+}
+
+uring_tx create_uring_tx(int socket_fd, const std::string& dest_ip_addr, const packet_set& set, size_t batch_size, const uring_config& config)
+{
+    // A connected raw socket can be written to like a file - no destination per packet
+    sockaddr_in destination{};
+    destination.sin_family = AF_INET;
+    destination.sin_addr.s_addr = inet_addr(dest_ip_addr.c_str());
+
+    if (connect(socket_fd, reinterpret_cast<sockaddr*>(&destination), sizeof(destination)) < 0)
+    {
+        perror("Failed to connect the transmit socket");
+        exit(-1);
+    }
+
+    uring_tx tx{};
+    tx.socket_fd = socket_fd;
+    tx.batch_size = std::max<size_t>(batch_size, 1);
+    tx.ring = create_uring(static_cast<uint32_t>(std::max<size_t>(config.queue_size, tx.batch_size)), 0);
+    tx.batch_size = std::min<size_t>(tx.batch_size, tx.ring.sq_entries);
+
+    // Registering pins the set's pages once, rather than on every write. Failing to (for want of
+    // RLIMIT_MEMLOCK, say) costs some speed, but nothing else.
+    const iovec region{.iov_base = const_cast<char*>(set.storage.data()), .iov_len = set.storage.size()};
+    tx.registered = io_uring_register(tx.ring.ring_fd, IORING_REGISTER_BUFFERS, &region, 1) == 0;
+
+    if (!tx.registered)
+        perror("Failed to register the packets with io_uring, so they'll be written unregistered");
+
+    return tx;
+}
+
+void destroy_uring_tx(uring_tx& tx)
+{
+    destroy_uring(tx.ring);
+}
+
+static bool retryable(int result)
+{
+    return result == -ENOBUFS || result == -EAGAIN || result == -EINTR || result == -ECANCELED;
+}
+
+void uring_send_packets(uring_tx& tx, packet_set& set, size_t first, size_t count)
+{
+    const size_t total = packet_count(set);
+    size_t index = first % total;
+
+    while (count > 0)
+    {
+        size_t batch_count = std::min(count, tx.batch_size);
+
+        // The kernel only copies the packets out as it writes them, so a batch can't restamp a packet
+        // it already holds
+        if (tx.stamp) batch_count = std::min(batch_count, total);
+
+        size_t packet = index;
+        for (size_t i = 0; i < batch_count; ++i)
+        {
+            char* data = packet_data(set, packet);
+            if (tx.stamp) write_stamp(data, set.sizes[packet], tx.next_sequence++, realtime_ns());
+
+            io_uring_sqe* sqe = submission_slot(tx.ring, static_cast<uint32_t>(i));
+            sqe->opcode = tx.registered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+            sqe->fd = tx.socket_fd;
+            sqe->addr = reinterpret_cast<uint64_t>(data);
+            sqe->len = static_cast<uint32_t>(set.sizes[packet]);
+            sqe->buf_index = 0;
+            sqe->user_data = i;
+
+            // Linked, so the writes happen in order, and one that fails cancels the rest of the batch
+            // instead of letting the packets after it overtake it
+            if (i + 1 < batch_count) sqe->flags = IOSQE_IO_LINK;
+
+            packet = (packet + 1 == total) ? 0 : packet + 1;
+        }
+
+        publish_submissions(tx.ring, static_cast<uint32_t>(batch_count));
+
+        const int result = submit_and_wait(tx.ring, static_cast<uint32_t>(batch_count), static_cast<uint32_t>(batch_count));
+        if (result < 0)
+        {
+            errno = -result;
+            perror("Failed to submit packets to io_uring");
+            exit(-1);
+        }
+
+        // Everything before the first write that failed went out; the rest is sent again
+        size_t sent = batch_count;
+        io_uring_cqe cqe{};
+        for (size_t i = 0; i < batch_count; ++i)
+        {
+            while (!next_completion(tx.ring, cqe)) submit_and_wait(tx.ring, 0, 1);
+            if (cqe.res >= 0) continue;
+
+            if (!retryable(cqe.res))
+            {
+                errno = -cqe.res;
+                perror("Failed to send packets");
+                exit(-1);
+            }
+
+            sent = std::min<size_t>(sent, cqe.user_data);
+        }
+
+        if (sent < batch_count)
+        {
+            // A full qdisc or socket buffer just means we're outrunning the NIC - back off and retry,
+            // with the same sequence numbers, so the retried packets don't look lost
+            if (tx.stamp) tx.next_sequence -= batch_count - sent;
+            sched_yield();
+        }
+
+        index = (index + sent) % total;
+        count -= sent;
+    }
+}
+
+static void provide_buffer(uring_rx& rx, uint32_t buffer)
+{
+    const uint16_t tail = rx.buffer_ring->tail;
+
+    // Not buffer_ring->bufs: the header declares it as a flexible array inside a union, which C++
+    // compilers lay out after an empty struct, 8 bytes in. The ring is just an array of buffers, with
+    // the tail overlaid on the first one's reserved field.
+    io_uring_buf& slot = reinterpret_cast<io_uring_buf*>(rx.buffer_ring)[tail & (rx.buffer_count - 1)];
+    slot.addr = reinterpret_cast<uint64_t>(rx.buffers + static_cast<size_t>(buffer) * rx.buffer_size);
+    slot.len = rx.buffer_size;
+    slot.bid = static_cast<uint16_t>(buffer);
+
+    __atomic_store_n(&rx.buffer_ring->tail, static_cast<uint16_t>(tail + 1), __ATOMIC_RELEASE);
+}
+
+static void arm_receive(uring_rx& rx)
+{
+    io_uring_sqe* sqe = submission_slot(rx.ring, 0);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = rx.socket_fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECEIVE_BUFFER_GROUP;
+    sqe->user_data = RECEIVE_USER_DATA;
+    publish_submissions(rx.ring, 1);
+
+    const int result = submit_and_wait(rx.ring, 1, 0);
+    if (result < 0)
+    {
+        errno = -result;
+        perror("Failed to arm the io_uring receive");
+        exit(-1);
+    }
+
+    rx.armed = true;
+}
+
+static void* map_anonymous_or_exit(size_t size, const char* name)
+{
+    void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (map == MAP_FAILED)
+    {
+        perror(("Failed to allocate the io_uring " + std::string(name)).c_str());
+        exit(-1);
+    }
+
+    return map;
+}
+
+uring_rx create_uring_rx(int socket_fd, const uring_config& config)
+{
+    if (config.buffer_count == 0 || (config.buffer_count & (config.buffer_count - 1)) != 0 || config.buffer_count > 1 << 15)
+    {
+        std::cerr << "io_uring receive buffer count must be a power of two, at most 32768" << std::endl;
+        exit(-1);
+    }
+
+    uring_rx rx{};
+    rx.socket_fd = socket_fd;
+    rx.buffer_count = config.buffer_count;
+    rx.buffer_size = config.buffer_size;
+    rx.held_buffer = -1;
+
+    // Room for a completion per buffer, so a full set of frames never overflows the completion queue
+    rx.ring = create_uring(config.queue_size, config.buffer_count);
+
+    rx.buffer_ring_size = config.buffer_count * sizeof(io_uring_buf);
+    rx.buffer_ring = static_cast<io_uring_buf_ring*>(map_anonymous_or_exit(rx.buffer_ring_size, "buffer ring"));
+
+    rx.buffers_size = static_cast<size_t>(config.buffer_count) * config.buffer_size;
+    rx.buffers = static_cast<uint8_t*>(map_anonymous_or_exit(rx.buffers_size, "receive buffers"));
+
+    io_uring_buf_reg registration{};
+    registration.ring_addr = reinterpret_cast<uint64_t>(rx.buffer_ring);
+    registration.ring_entries = config.buffer_count;
+    registration.bgid = RECEIVE_BUFFER_GROUP;
+
+    if (io_uring_register(rx.ring.ring_fd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0)
+    {
+        perror("Failed to register the io_uring receive buffers (needs Linux 5.19 or later)");
+        exit(-1);
+    }
+
+    for (uint32_t i = 0; i < config.buffer_count; ++i) provide_buffer(rx, i);
+
+    arm_receive(rx);
+    return rx;
+}
+
+void destroy_uring_rx(uring_rx& rx)
+{
+    // Closing the ring cancels the receive, and drops the buffer registration with it
+    destroy_uring(rx.ring);
+    munmap(rx.buffers, rx.buffers_size);
+    munmap(rx.buffer_ring, rx.buffer_ring_size);
+}
+
+bool uring_receive_frame(uring_rx& rx, const uint8_t*& frame, size_t& frame_size, uint64_t& timestamp_ns, int timeout_ms)
+{
+    if (rx.held_buffer >= 0)
+    {
+        provide_buffer(rx, static_cast<uint32_t>(rx.held_buffer));
+        rx.held_buffer = -1;
+    }
+
+    __kernel_timespec timeout{.tv_sec = timeout_ms / 1000, .tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000};
+    io_uring_getevents_arg wait{};
+    wait.sigmask_sz = _NSIG / 8;
+    wait.ts = reinterpret_cast<uint64_t>(&timeout);
+
+    io_uring_cqe cqe{};
+    while (true)
+    {
+        if (!rx.armed) arm_receive(rx);
+
+        if (!next_completion(rx.ring, cqe))
+        {
+            const int result = io_uring_enter(rx.ring.ring_fd, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &wait, sizeof(wait));
+            if (result < 0 && errno == ETIME) return false;
+            if (result < 0 && errno != EINTR)
+            {
+                perror("Failed to wait on io_uring");
+                exit(-1);
+            }
+
+            continue;
+        }
+
+        // Without F_MORE, this is the receive's last completion, and it has to be armed again
+        if (!(cqe.flags & IORING_CQE_F_MORE)) rx.armed = false;
+
+        if (cqe.res < 0)
+        {
+            // Out of buffers: every frame waiting has been read by now, giving its buffer back
+            if (cqe.res == -ENOBUFS || cqe.res == -EINTR || cqe.res == -EAGAIN) continue;
+
+            errno = -cqe.res;
+            perror("Failed to receive through io_uring");
+            exit(-1);
+        }
+
+        if (!(cqe.flags & IORING_CQE_F_BUFFER)) continue;
+
+        const uint32_t buffer = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+        rx.held_buffer = static_cast<int>(buffer);
+
+        frame = rx.buffers + static_cast<size_t>(buffer) * rx.buffer_size;
+        frame_size = static_cast<size_t>(cqe.res);
+        timestamp_ns = realtime_ns();
+        return true;
+    }
+}
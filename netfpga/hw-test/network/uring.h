@@ -0,0 +1,115 @@
+#ifndef TRAFFIC_GENERATOR_URING_H
+#define TRAFFIC_GENERATOR_URING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <linux/io_uring.h>
+
+#include "tx_batch.h"
+
+// io_uring, set up through the system calls themselves (there's no liburing to depend on). A ring
+// is two queues shared with the kernel: we write submissions (SQEs) at the submission queue's tail,
+// and the kernel writes their results (CQEs) at the completion queue's tail. A single io_uring_enter
+// can both submit a whole batch and wait for its completions, and completions that are already
+// there are read without any syscall at all.
+//
+// Sending writes each packet to a connected raw socket with IORING_OP_WRITE_FIXED, out of the packet
+// set registered with the kernel up front, so it isn't pinned and mapped again for every write. A
+// batch is submitted and waited for in one syscall.
+//
+// Receiving arms a single multishot receive on the socket, which keeps completing - one CQE per
+// frame - into buffers the kernel picks from a ring of them we provide, until it's cancelled or the
+// buffers run out, so the steady state is one syscall per batch of frames rather than a select and
+// a recvfrom per frame.
+
+struct uring_config
+{
+    uint32_t queue_size = 256;
+
+    // Receive buffers provided to the kernel; buffer_count must be a power of two
+    uint32_t buffer_count = 1024;
+    uint32_t buffer_size = 2048;
+};
+
+// The head and tail indices only ever increase; masking gives the slot
+struct uring
+{
+    int ring_fd;
+
+    uint32_t* sq_head;
+    uint32_t* sq_tail;
+    uint32_t sq_mask;
+    uint32_t* sq_array;
+    io_uring_sqe* sqes;
+    uint32_t sq_entries;
+
+    uint32_t* cq_head;
+    uint32_t* cq_tail;
+    uint32_t cq_mask;
+    io_uring_cqe* cqes;
+
+    void* sq_map;
+    size_t sq_map_size;
+    void* cq_map;
+    size_t cq_map_size;
+    size_t sqes_map_size;
+};
+
+struct uring_tx
+{
+    uring ring;
+    int socket_fd;
+    size_t batch_size;
+
+    // Whether the packet set could be registered; without, plain IORING_OP_WRITE is used
+    bool registered;
+
+    // When set, each packet gets a fresh stamp (see network/stamp.h) just before it's submitted,
+    // numbered from next_sequence
+    bool stamp;
+    uint64_t next_sequence;
+};
+
+// Connects socket_fd (a raw IP socket, as create_transmit_socket makes) to dest_ip_addr, and sets up
+// a ring to send set through, batch_size packets per submission. set mustn't grow afterwards, since
+// its storage is what's registered.
+uring_tx create_uring_tx(int socket_fd, const std::string& dest_ip_addr, const packet_set& set, size_t batch_size, const uring_config& config);
+void destroy_uring_tx(uring_tx& tx);
+
+// Sends count packets of set, starting at first and wrapping around to the start of set. Retries a
+// packet whose write failed because the socket's send queue was full rather than dropping it.
+void uring_send_packets(uring_tx& tx, packet_set& set, size_t first, size_t count);
+
+struct uring_rx
+{
+    uring ring;
+    int socket_fd;
+
+    // The ring of buffers the kernel receives into, and the buffers themselves
+    io_uring_buf_ring* buffer_ring;
+    size_t buffer_ring_size;
+    uint8_t* buffers;
+    size_t buffers_size;
+    uint32_t buffer_count;
+    uint32_t buffer_size;
+
+    // Whether the multishot receive is still armed - the kernel ends it if it runs out of buffers
+    bool armed;
+
+    // The buffer holding the frame handed out last, which goes back to the kernel on the next call
+    int held_buffer;
+};
+
+// Sets up a ring receiving from socket_fd (a packet socket, as create_receive_socket makes)
+uring_rx create_uring_rx(int socket_fd, const uring_config& config);
+void destroy_uring_rx(uring_rx& rx);
+
+// Points frame at the next received frame, in place in its buffer - it's only valid until the next
+// call. A multishot receive can't carry the kernel's timestamp, so timestamp_ns is when the
+// completion was picked up (CLOCK_REALTIME). Returns false if nothing arrived within timeout_ms.
+bool uring_receive_frame(uring_rx& rx, const uint8_t*& frame, size_t& frame_size, uint64_t& timestamp_ns, int timeout_ms);
+
+#endif //TRAFFIC_GENERATOR_URING_H
@@ -0,0 +1,596 @@
+#include "xdp.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <arpa/inet.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <linux/in.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "socket.h"
+#include "stamp.h"
+#include "../util/pacer.h"
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+// Largest queue index a socket can be registered for
+static constexpr uint32_t MAX_XDP_QUEUES = 256;
+
+static constexpr size_t ETHERNET_HEADER_SIZE = 14;
+
+// The ring indices are shared with the kernel, which reads and writes them concurrently
+static inline uint32_t load_acquire(const uint32_t* index) { return __atomic_load_n(index, __ATOMIC_ACQUIRE); }
+static inline void store_release(uint32_t* index, uint32_t value) { __atomic_store_n(index, value, __ATOMIC_RELEASE); }
+
+static inline uint64_t* address_slot(xdp_ring& ring, uint32_t index)
+{
+    return static_cast<uint64_t*>(ring.descriptors) + (index & ring.mask);
+}
+
+static inline xdp_desc* descriptor_slot(xdp_ring& ring, uint32_t index)
+{
+    return static_cast<xdp_desc*>(ring.descriptors) + (index & ring.mask);
+}
+
+static void map_ring(xdp_ring& ring, int socket_fd, const xdp_ring_offset& offsets, uint32_t size, size_t descriptor_size, off_t page_offset)
+{
+    ring.map_size = offsets.desc + size * descriptor_size;
+    ring.map = mmap(nullptr, ring.map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, socket_fd, page_offset);
+    if (ring.map == MAP_FAILED)
+    {
+        perror("Failed to map AF_XDP ring");
+        exit(-1);
+    }
+
+    uint8_t* base = static_cast<uint8_t*>(ring.map);
+    ring.producer = reinterpret_cast<uint32_t*>(base + offsets.producer);
+    ring.consumer = reinterpret_cast<uint32_t*>(base + offsets.consumer);
+    ring.flags = reinterpret_cast<uint32_t*>(base + offsets.flags);
+    ring.descriptors = base + offsets.desc;
+    ring.mask = size - 1;
+}
+
+static void set_ring_size(int socket_fd, int option, uint32_t size, const char* name)
+{
+    if (setsockopt(socket_fd, SOL_XDP, option, &size, sizeof(size)) < 0)
+    {
+        std::cerr << "Failed to size AF_XDP " << name << " ring: " << strerror(errno) << std::endl;
+        exit(-1);
+    }
+}
+
+static void unmap_rings(xdp_socket& xsk)
+{
+    for (xdp_ring* ring: {&xsk.fill, &xsk.completion, &xsk.rx, &xsk.tx})
+        if (ring->map) munmap(ring->map, ring->map_size);
+
+    munmap(xsk.umem, xsk.umem_size);
+    close(xsk.socket_fd);
+}
+
+// Sets up the UMEM and all four rings, and binds to the queue with bind_flags. Returns false (having
+// torn everything down again) if only the bind failed, so the caller can retry in another mode.
+static bool try_create_xdp_socket(xdp_socket& xsk, unsigned int ifindex, uint32_t queue, const xdp_config& config, uint16_t bind_flags)
+{
+    if ((config.ring_size & (config.ring_size - 1)) != 0 || config.frame_count < 2 * config.ring_size)
+    {
+        std::cerr << "AF_XDP ring size must be a power of two, and at most half the frame count" << std::endl;
+        exit(-1);
+    }
+
+    xsk = xdp_socket{};
+    xsk.queue = queue;
+    xsk.frame_size = config.frame_size;
+    xsk.batch_size = std::max<uint32_t>(config.batch_size, 1);
+
+    xsk.socket_fd = socket(AF_XDP, SOCK_RAW, 0);
+    if (xsk.socket_fd < 0)
+    {
+        perror("Failed to create AF_XDP socket");
+        exit(-1);
+    }
+
+    xsk.umem_size = static_cast<size_t>(config.frame_count) * config.frame_size;
+    void* umem = mmap(nullptr, xsk.umem_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (umem == MAP_FAILED)
+    {
+        perror("Failed to allocate AF_XDP UMEM");
+        exit(-1);
+    }
+    xsk.umem = static_cast<uint8_t*>(umem);
+
+    xdp_umem_reg registration{};
+    registration.addr = reinterpret_cast<uint64_t>(xsk.umem);
+    registration.len = xsk.umem_size;
+    registration.chunk_size = config.frame_size;
+    registration.headroom = 0;
+    if (setsockopt(xsk.socket_fd, SOL_XDP, XDP_UMEM_REG, &registration, sizeof(registration)) < 0)
+    {
+        perror("Failed to register AF_XDP UMEM");
+        exit(-1);
+    }
+
+    set_ring_size(xsk.socket_fd, XDP_UMEM_FILL_RING, config.ring_size, "fill");
+    set_ring_size(xsk.socket_fd, XDP_UMEM_COMPLETION_RING, config.ring_size, "completion");
+    set_ring_size(xsk.socket_fd, XDP_RX_RING, config.ring_size, "rx");
+    set_ring_size(xsk.socket_fd, XDP_TX_RING, config.ring_size, "tx");
+
+    xdp_mmap_offsets offsets{};
+    socklen_t length = sizeof(offsets);
+    if (getsockopt(xsk.socket_fd, SOL_XDP, XDP_MMAP_OFFSETS, &offsets, &length) < 0)
+    {
+        perror("Failed to read AF_XDP ring offsets");
+        exit(-1);
+    }
+
+    map_ring(xsk.fill, xsk.socket_fd, offsets.fr, config.ring_size, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING);
+    map_ring(xsk.completion, xsk.socket_fd, offsets.cr, config.ring_size, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING);
+    map_ring(xsk.rx, xsk.socket_fd, offsets.rx, config.ring_size, sizeof(xdp_desc), XDP_PGOFF_RX_RING);
+    map_ring(xsk.tx, xsk.socket_fd, offsets.tx, config.ring_size, sizeof(xdp_desc), XDP_PGOFF_TX_RING);
+
+    // The first half of the UMEM receives, and all of it starts out on the fill ring; the second
+    // half transmits. The fill ring is exactly big enough for every receive frame, so handing them
+    // back never has to wait.
+    const uint32_t rx_frame_count = config.ring_size;
+    for (uint32_t i = 0; i < rx_frame_count; ++i)
+        *address_slot(xsk.fill, i) = static_cast<uint64_t>(i) * config.frame_size;
+    store_release(xsk.fill.producer, rx_frame_count);
+
+    xsk.tx_frame_count = config.frame_count - rx_frame_count;
+    for (uint32_t i = rx_frame_count; i < config.frame_count; ++i)
+        xsk.free_tx_frames.push_back(static_cast<uint64_t>(i) * config.frame_size);
+
+    sockaddr_xdp address{};
+    address.sxdp_family = AF_XDP;
+    address.sxdp_ifindex = ifindex;
+    address.sxdp_queue_id = queue;
+    address.sxdp_flags = bind_flags;
+
+    if (bind(xsk.socket_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+    {
+        const int bind_errno = errno;
+        unmap_rings(xsk);
+        errno = bind_errno;
+        return false;
+    }
+
+    xsk.zero_copy = (bind_flags & XDP_ZEROCOPY) != 0;
+    return true;
+}
+
+xdp_socket create_xdp_socket(const std::string& interface_name, uint32_t queue, const xdp_config& config)
+{
+    const unsigned int ifindex = if_nametoindex(interface_name.c_str());
+    if (ifindex == 0)
+    {
+        perror("Failed to get interface index");
+        exit(-1);
+    }
+
+    xdp_socket xsk{};
+
+    // Zero-copy needs driver support; without it the kernel copies between the UMEM and its own
+    // buffers, which is still far cheaper than a trip through the stack
+    if (!config.force_copy && try_create_xdp_socket(xsk, ifindex, queue, config, XDP_USE_NEED_WAKEUP | XDP_ZEROCOPY))
+        return xsk;
+
+    if (!try_create_xdp_socket(xsk, ifindex, queue, config, XDP_USE_NEED_WAKEUP | XDP_COPY))
+    {
+        std::cerr << "Failed to bind AF_XDP socket to " << interface_name << " queue " << queue << ": " << strerror(errno) << std::endl;
+        exit(-1);
+    }
+
+    return xsk;
+}
+
+void destroy_xdp_socket(xdp_socket& xsk)
+{
+    unmap_rings(xsk);
+}
+
+void set_xdp_destination(xdp_socket& xsk, const std::string& interface_name, const std::string& dest_mac)
+{
+    parse_mac_address(dest_mac, xsk.ethernet_header);
+    get_interface_mac(interface_name, xsk.ethernet_header + 6);
+
+    const uint16_t ether_type = htons(ETH_P_IP);
+    std::memcpy(xsk.ethernet_header + 12, &ether_type, sizeof(ether_type));
+}
+
+// Tells the kernel there's something on the tx ring. In copy mode each wakeup only sends a limited
+// number of frames (32, in current kernels), so we keep at it until the kernel has taken everything -
+// otherwise the ring backs up, and frames wait in it for as long as it takes to drain.
+static void kick_tx(xdp_socket& xsk)
+{
+    if (xsk.zero_copy && !(load_acquire(xsk.tx.flags) & XDP_RING_NEED_WAKEUP)) return;
+
+    do
+    {
+        if (sendto(xsk.socket_fd, nullptr, 0, MSG_DONTWAIT, nullptr, 0) < 0)
+        {
+            // The kernel's busy, or short of buffers - give it a moment
+            if (errno == EAGAIN || errno == EBUSY || errno == ENOBUFS || errno == EINTR)
+            {
+                sched_yield();
+                continue;
+            }
+
+            // The link's down; there's no point in retrying
+            if (errno == ENETDOWN) return;
+
+            perror("Failed to wake AF_XDP transmit");
+            exit(-1);
+        }
+    }
+    while (!xsk.zero_copy && load_acquire(xsk.tx.consumer) != *xsk.tx.producer);
+}
+
+// Takes back the frames the kernel has finished sending
+static void reap_completions(xdp_socket& xsk)
+{
+    const uint32_t consumer = *xsk.completion.consumer;
+    const uint32_t available = load_acquire(xsk.completion.producer) - consumer;
+
+    for (uint32_t i = 0; i < available; ++i)
+        xsk.free_tx_frames.push_back(*address_slot(xsk.completion, consumer + i));
+
+    if (available > 0) store_release(xsk.completion.consumer, consumer + available);
+}
+
+void xdp_send_frames(xdp_socket& xsk, packet_set& set, size_t first, size_t count)
+{
+    const size_t total = packet_count(set);
+    size_t index = first % total;
+
+    while (count > 0)
+    {
+        reap_completions(xsk);
+
+        if (xsk.free_tx_frames.empty())
+        {
+            kick_tx(xsk);
+            sched_yield();
+            continue;
+        }
+
+        // The tx ring has as many slots as there are tx frames, so a free frame always has a slot
+        const uint32_t producer = *xsk.tx.producer;
+        const uint32_t batch_count = static_cast<uint32_t>(std::min<size_t>({count, xsk.free_tx_frames.size(), xsk.batch_size}));
+
+        for (uint32_t i = 0; i < batch_count; ++i)
+        {
+            const size_t packet_size = set.sizes[index];
+            if (ETHERNET_HEADER_SIZE + packet_size > xsk.frame_size)
+            {
+                std::cerr << "Packet of " << packet_size << " bytes doesn't fit in an AF_XDP frame" << std::endl;
+                exit(-1);
+            }
+
+            const uint64_t address = xsk.free_tx_frames.back();
+            xsk.free_tx_frames.pop_back();
+
+            uint8_t* frame = xsk.umem + address;
+            std::memcpy(frame, xsk.ethernet_header, ETHERNET_HEADER_SIZE);
+            std::memcpy(frame + ETHERNET_HEADER_SIZE, packet_data(set, index), packet_size);
+
+            if (xsk.stamp)
+                write_stamp(reinterpret_cast<char*>(frame + ETHERNET_HEADER_SIZE), packet_size, xsk.next_sequence++, realtime_ns());
+
+            xdp_desc* descriptor = descriptor_slot(xsk.tx, producer + i);
+            descriptor->addr = address;
+            descriptor->len = static_cast<uint32_t>(ETHERNET_HEADER_SIZE + packet_size);
+            descriptor->options = 0;
+
+            index = (index + 1 == total) ? 0 : index + 1;
+        }
+
+        store_release(xsk.tx.producer, producer + batch_count);
+        kick_tx(xsk);
+
+        count -= batch_count;
+    }
+}
+
+void xdp_finish_sending(xdp_socket& xsk)
+{
+    const uint64_t deadline_ns = monotonic_ns() + 1000000000ull;
+
+    reap_completions(xsk);
+    while (xsk.free_tx_frames.size() < xsk.tx_frame_count && monotonic_ns() < deadline_ns)
+    {
+        kick_tx(xsk);
+        sched_yield();
+        reap_completions(xsk);
+    }
+}
+
+bool xdp_receive_frame(xdp_socket& xsk, const uint8_t*& frame, size_t& frame_size, uint64_t& timestamp_ns, int timeout_ms)
+{
+    if (xsk.rx_batch_next == xsk.rx_batch_size && xsk.rx_batch_size > 0)
+    {
+        // Everything from the last batch has been handed out - give its frames back to the kernel
+        const uint32_t fill_producer = *xsk.fill.producer;
+        for (uint32_t i = 0; i < xsk.rx_batch_size; ++i)
+        {
+            const uint64_t address = descriptor_slot(xsk.rx, xsk.rx_batch_start + i)->addr;
+            *address_slot(xsk.fill, fill_producer + i) = address - address % xsk.frame_size;
+        }
+        store_release(xsk.fill.producer, fill_producer + xsk.rx_batch_size);
+        store_release(xsk.rx.consumer, xsk.rx_batch_start + xsk.rx_batch_size);
+
+        xsk.rx_batch_size = 0;
+        xsk.rx_batch_next = 0;
+    }
+
+    if (xsk.rx_batch_size == 0)
+    {
+        const uint32_t consumer = *xsk.rx.consumer;
+        uint32_t available = load_acquire(xsk.rx.producer) - consumer;
+
+        if (available == 0)
+        {
+            // Polling also wakes the kernel up to refill from the fill ring, when it's asked for that
+            pollfd poll_fd{};
+            poll_fd.fd = xsk.socket_fd;
+            poll_fd.events = POLLIN;
+
+            int ret = poll(&poll_fd, 1, timeout_ms);
+            if (ret < 0 && errno != EINTR)
+            {
+                perror("Failed to poll AF_XDP socket");
+                exit(-1);
+            }
+
+            available = load_acquire(xsk.rx.producer) - consumer;
+            if (available == 0) return false;
+        }
+
+        xsk.rx_batch_start = consumer;
+        xsk.rx_batch_size = std::min(available, xsk.batch_size);
+        xsk.rx_batch_next = 0;
+        xsk.rx_batch_ns = realtime_ns();
+    }
+
+    const xdp_desc* descriptor = descriptor_slot(xsk.rx, xsk.rx_batch_start + xsk.rx_batch_next++);
+    frame = xsk.umem + descriptor->addr;
+    frame_size = descriptor->len;
+    timestamp_ns = xsk.rx_batch_ns;
+    return true;
+}
+
+uint64_t get_xdp_drops(const xdp_socket& xsk)
+{
+    xdp_statistics statistics{};
+    socklen_t length = sizeof(statistics);
+    if (getsockopt(xsk.socket_fd, SOL_XDP, XDP_STATISTICS, &statistics, &length) < 0)
+    {
+        perror("Failed to read AF_XDP statistics");
+        exit(-1);
+    }
+
+    return statistics.rx_dropped + statistics.rx_ring_full + statistics.rx_fill_ring_empty_descs;
+}
+
+// There's no libbpf to lean on here, so the program is assembled and loaded by hand
+static long bpf(int command, bpf_attr& attributes)
+{
+    return syscall(__NR_bpf, command, &attributes, sizeof(attributes));
+}
+
+static bpf_insn instruction(uint8_t code, uint8_t dst, uint8_t src, int16_t offset, int32_t immediate)
+{
+    bpf_insn insn{};
+    insn.code = code;
+    insn.dst_reg = dst & 0xf;
+    insn.src_reg = src & 0xf;
+    insn.off = offset;
+    insn.imm = immediate;
+    return insn;
+}
+
+// Stands in for the jump to the final "pass" instructions until the program is complete and the
+// distance to them is known
+static constexpr int16_t JUMP_TO_PASS = 0x7fff;
+
+static void load(std::vector<bpf_insn>& program, uint8_t size, uint8_t dst, uint8_t src, int16_t offset)
+{
+    program.push_back(instruction(BPF_LDX | size | BPF_MEM, dst, src, offset, 0));
+}
+
+static void pass_unless_equal(std::vector<bpf_insn>& program, uint8_t reg, int32_t value)
+{
+    program.push_back(instruction(BPF_JMP | BPF_JNE | BPF_K, reg, 0, JUMP_TO_PASS, value));
+}
+
+// r1 holds the xdp_md context on entry; r6 keeps it, r2/r3 the packet's start and end
+static std::vector<bpf_insn> create_redirect_program(int map_fd, const port_range& dst_ports)
+{
+    // Offsets into an untagged Ethernet frame carrying IPv4 (with no options) and UDP
+    constexpr int16_t ether_type_offset = 12;
+    constexpr int16_t ip_version_offset = 14;
+    constexpr int16_t ip_protocol_offset = 14 + 9;
+    constexpr int16_t udp_dest_port_offset = 14 + 20 + 2;
+
+    std::vector<bpf_insn> program;
+
+    program.push_back(instruction(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0));
+    load(program, BPF_W, BPF_REG_2, BPF_REG_6, offsetof(xdp_md, data));
+    load(program, BPF_W, BPF_REG_3, BPF_REG_6, offsetof(xdp_md, data_end));
+
+    // The verifier insists on seeing the bounds checked before anything is read
+    program.push_back(instruction(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0));
+    program.push_back(instruction(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, udp_dest_port_offset + 2));
+    program.push_back(instruction(BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, JUMP_TO_PASS, 0));
+
+    // Packet loads come out in network order, so compare against network order values
+    load(program, BPF_H, BPF_REG_4, BPF_REG_2, ether_type_offset);
+    pass_unless_equal(program, BPF_REG_4, htons(ETH_P_IP));
+
+    load(program, BPF_B, BPF_REG_4, BPF_REG_2, ip_version_offset);
+    pass_unless_equal(program, BPF_REG_4, 0x45);
+
+    load(program, BPF_B, BPF_REG_4, BPF_REG_2, ip_protocol_offset);
+    pass_unless_equal(program, BPF_REG_4, IPPROTO_UDP);
+
+    load(program, BPF_H, BPF_REG_4, BPF_REG_2, udp_dest_port_offset);
+    if (dst_ports.first == dst_ports.last)
+    {
+        pass_unless_equal(program, BPF_REG_4, htons(dst_ports.first));
+    }
+    else
+    {
+        // A range has to be compared in host order
+        program.push_back(instruction(BPF_ALU | BPF_END | BPF_TO_BE, BPF_REG_4, 0, 0, 16));
+        program.push_back(instruction(BPF_JMP | BPF_JLT | BPF_K, BPF_REG_4, 0, JUMP_TO_PASS, dst_ports.first));
+        program.push_back(instruction(BPF_JMP | BPF_JGT | BPF_K, BPF_REG_4, 0, JUMP_TO_PASS, dst_ports.last));
+    }
+
+    // return bpf_redirect_map(&xsks, ctx->rx_queue_index, XDP_PASS) - falling back to the stack if
+    // no socket is registered for this queue
+    load(program, BPF_W, BPF_REG_2, BPF_REG_6, offsetof(xdp_md, rx_queue_index));
+    program.push_back(instruction(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, map_fd));
+    program.push_back(instruction(0, 0, 0, 0, 0));
+    program.push_back(instruction(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS));
+    program.push_back(instruction(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map));
+    program.push_back(instruction(BPF_JMP | BPF_EXIT, 0, 0, 0, 0));
+
+    const size_t pass = program.size();
+    program.push_back(instruction(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS));
+    program.push_back(instruction(BPF_JMP | BPF_EXIT, 0, 0, 0, 0));
+
+    for (size_t i = 0; i < pass; ++i)
+    {
+        if (BPF_CLASS(program[i].code) == BPF_JMP && program[i].off == JUMP_TO_PASS)
+            program[i].off = static_cast<int16_t>(pass - i - 1);
+    }
+
+    return program;
+}
+
+static int load_program(const std::vector<bpf_insn>& program)
+{
+    static const char license[] = "Dual MIT/GPL";
+
+    bpf_attr attributes{};
+    attributes.prog_type = BPF_PROG_TYPE_XDP;
+    attributes.insns = reinterpret_cast<uint64_t>(program.data());
+    attributes.insn_cnt = static_cast<uint32_t>(program.size());
+    attributes.license = reinterpret_cast<uint64_t>(license);
+
+    int program_fd = static_cast<int>(bpf(BPF_PROG_LOAD, attributes));
+    if (program_fd >= 0) return program_fd;
+
+    // Load it again, just to find out what the verifier didn't like
+    const int load_errno = errno;
+    static char log[65536];
+    attributes.log_buf = reinterpret_cast<uint64_t>(log);
+    attributes.log_size = sizeof(log);
+    attributes.log_level = 1;
+    bpf(BPF_PROG_LOAD, attributes);
+
+    std::cerr << "Failed to load XDP program: " << strerror(load_errno) << '\n' << log << std::endl;
+    exit(-1);
+}
+
+static int link_program(int program_fd, unsigned int ifindex, uint32_t flags)
+{
+    bpf_attr attributes{};
+    attributes.link_create.prog_fd = static_cast<uint32_t>(program_fd);
+    attributes.link_create.target_ifindex = ifindex;
+    attributes.link_create.attach_type = BPF_XDP;
+    attributes.link_create.flags = flags;
+
+    return static_cast<int>(bpf(BPF_LINK_CREATE, attributes));
+}
+
+xdp_program attach_xdp_program(const std::string& interface_name, const port_range& dst_ports, bool force_skb)
+{
+    const unsigned int ifindex = if_nametoindex(interface_name.c_str());
+    if (ifindex == 0)
+    {
+        perror("Failed to get interface index");
+        exit(-1);
+    }
+
+    xdp_program program{};
+
+    bpf_attr map_attributes{};
+    map_attributes.map_type = BPF_MAP_TYPE_XSKMAP;
+    map_attributes.key_size = sizeof(uint32_t);
+    map_attributes.value_size = sizeof(uint32_t);
+    map_attributes.max_entries = MAX_XDP_QUEUES;
+
+    program.map_fd = static_cast<int>(bpf(BPF_MAP_CREATE, map_attributes));
+    if (program.map_fd < 0)
+    {
+        perror("Failed to create XSKMAP");
+        exit(-1);
+    }
+
+    program.program_fd = load_program(create_redirect_program(program.map_fd, dst_ports));
+
+    program.link_fd = force_skb ? -1 : link_program(program.program_fd, ifindex, XDP_FLAGS_DRV_MODE);
+    if (program.link_fd < 0)
+    {
+        program.skb_mode = true;
+        program.link_fd = link_program(program.program_fd, ifindex, XDP_FLAGS_SKB_MODE);
+    }
+
+    if (program.link_fd < 0)
+    {
+        perror("Failed to attach XDP program");
+        exit(-1);
+    }
+
+    return program;
+}
+
+void register_xdp_socket(const xdp_program& program, const xdp_socket& xsk)
+{
+    uint32_t key = xsk.queue;
+    uint32_t value = static_cast<uint32_t>(xsk.socket_fd);
+
+    if (key >= MAX_XDP_QUEUES)
+    {
+        std::cerr << "AF_XDP queue " << key << " is past the last one supported (" << MAX_XDP_QUEUES - 1 << ")" << std::endl;
+        exit(-1);
+    }
+
+    bpf_attr attributes{};
+    attributes.map_fd = static_cast<uint32_t>(program.map_fd);
+    attributes.key = reinterpret_cast<uint64_t>(&key);
+    attributes.value = reinterpret_cast<uint64_t>(&value);
+    attributes.flags = BPF_ANY;
+
+    if (bpf(BPF_MAP_UPDATE_ELEM, attributes) < 0)
+    {
+        perror("Failed to register AF_XDP socket with XDP program");
+        exit(-1);
+    }
+}
+
+void detach_xdp_program(xdp_program& program)
+{
+    close(program.link_fd);
+    close(program.program_fd);
+    close(program.map_fd);
+}
@@ -0,0 +1,132 @@
+#ifndef TRAFFIC_GENERATOR_XDP_H
+#define TRAFFIC_GENERATOR_XDP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <linux/if_xdp.h>
+
+#include "flow.h"
+#include "tx_batch.h"
+
+// AF_XDP moves frames between the NIC and a region of our own memory (the UMEM) through four
+// single-producer/single-consumer rings, skipping the kernel's network stack entirely:
+//   fill       - UMEM frames we hand the kernel to receive into
+//   rx         - frames the kernel has received into them
+//   tx         - frames we've written and want sent
+//   completion - frames the kernel has finished sending, which we can reuse
+// In zero-copy mode the NIC DMAs straight into and out of the UMEM; drivers without zero-copy
+// support (and generic/SKB-mode XDP, e.g. on veth) fall back to the kernel copying for us, which
+// still skips the stack and every syscall but the occasional wakeup.
+//
+// Each socket is bound to one RX/TX queue pair of one interface, and owns one UMEM, shared between
+// its TX and RX rings: the first half of the frames cycle through fill/rx, the second half through
+// tx/completion.
+
+struct xdp_config
+{
+    uint32_t frame_count = 4096;
+    uint32_t frame_size = 2048;
+    uint32_t ring_size = 2048;
+
+    // Most descriptors queued per wakeup of the kernel, and handed out per peek at the rx ring
+    uint32_t batch_size = 64;
+
+    // Don't even try zero-copy, or native (driver) mode XDP
+    bool force_copy = false;
+    bool force_skb = false;
+};
+
+// The producer/consumer indices only ever increase; masking gives the slot
+struct xdp_ring
+{
+    uint32_t* producer;
+    uint32_t* consumer;
+    uint32_t* flags;
+    void* descriptors;
+    uint32_t mask;
+
+    void* map;
+    size_t map_size;
+};
+
+struct xdp_socket
+{
+    int socket_fd;
+    uint32_t queue;
+    bool zero_copy;
+    uint32_t batch_size;
+    uint32_t tx_frame_count;
+
+    uint8_t* umem;
+    size_t umem_size;
+    uint32_t frame_size;
+
+    xdp_ring fill;
+    xdp_ring completion;
+    xdp_ring rx;
+    xdp_ring tx;
+
+    // TX frames not currently in the kernel's hands
+    std::vector<uint64_t> free_tx_frames;
+
+    // The batch of received frames being handed out by xdp_receive_frame, which go back on the fill
+    // ring together once all of them have been handed out
+    uint32_t rx_batch_start;
+    uint32_t rx_batch_size;
+    uint32_t rx_batch_next;
+    uint64_t rx_batch_ns;
+
+    // Prepended to each IP packet xdp_send_frames sends - AF_XDP hands the NIC whole frames
+    uint8_t ethernet_header[14];
+
+    // When set, each frame gets a fresh stamp (see network/stamp.h) as it's written into the UMEM,
+    // numbered from next_sequence
+    bool stamp;
+    uint64_t next_sequence;
+};
+
+xdp_socket create_xdp_socket(const std::string& interface_name, uint32_t queue, const xdp_config& config);
+void destroy_xdp_socket(xdp_socket& xsk);
+
+// Sets the Ethernet header xdp_send_frames puts in front of every packet: from the interface's own
+// address to dest_mac, carrying IPv4
+void set_xdp_destination(xdp_socket& xsk, const std::string& interface_name, const std::string& dest_mac);
+
+// Copies count IP packets of set, behind the socket's Ethernet header, into free TX frames, starting at first and wrapping around to
+// the start of set, and has the kernel send them. Waits on the completion ring whenever every TX
+// frame is in flight.
+void xdp_send_frames(xdp_socket& xsk, packet_set& set, size_t first, size_t count);
+
+// Waits (up to a second) for the kernel to finish sending everything queued on the tx ring, which
+// in copy mode only progresses while we keep kicking it
+void xdp_finish_sending(xdp_socket& xsk);
+
+// Points frame at the next received frame, in place in the UMEM - it's only valid until the next
+// call. The kernel doesn't timestamp AF_XDP frames, so timestamp_ns is when we picked up the batch
+// the frame arrived in (CLOCK_REALTIME). Returns false if nothing arrived within timeout_ms.
+bool xdp_receive_frame(xdp_socket& xsk, const uint8_t*& frame, size_t& frame_size, uint64_t& timestamp_ns, int timeout_ms);
+
+// Frames the kernel couldn't deliver to this socket because its rx ring was full or its fill ring
+// empty (or for any other reason)
+uint64_t get_xdp_drops(const xdp_socket& xsk);
+
+// The XDP program that steers frames into the sockets: IPv4/UDP to dst_ports arriving on queue N goes to
+// whichever socket is registered for queue N, everything else (ARP, DHCP, ...) carries on to the
+// kernel's stack. Tries native (driver) mode first, then generic (SKB) mode.
+// It stays attached for as long as link_fd is open, so it's detached automatically if we crash.
+struct xdp_program
+{
+    int map_fd;
+    int program_fd;
+    int link_fd;
+    bool skb_mode;
+};
+
+xdp_program attach_xdp_program(const std::string& interface_name, const port_range& dst_ports, bool force_skb);
+void register_xdp_socket(const xdp_program& program, const xdp_socket& xsk);
+void detach_xdp_program(xdp_program& program);
+
+#endif //TRAFFIC_GENERATOR_XDP_H
@@ -0,0 +1,13 @@
+# Internet-like traffic: a thousand flows, a handful of which carry most of the packets, with the
+# simple IMIX frame size mix and random payloads. See traffic/profile.h for every key.
+#
+# Run with: ./generator ... --profile profiles/zipf-imix.profile --rate-gbps 1 --duration 10
+
+flows = 1000
+src_ip = 10.0.0.0/16
+src_port = 1024-65535
+flow_distribution = zipf:1.1
+frame_sizes = imix
+payload = prng
+seed = 1
+packets = 65536
@@ -0,0 +1,269 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "../network/packet.h"
+#include "../network/packet_template.h"
+#include "../util/hex.h"
+#include "../util/histogram.h"
+#include "trial.h"
+
+// Bounds the search even if the resolution asks for more precision than is sensible
+constexpr int MAX_TRIALS_PER_SIZE = 20;
+
+struct benchmark_trial
+{
+    size_t frame_size;
+    double offered_gbps;
+    double offered_pps;
+
+    uint64_t sent;
+    uint64_t received;
+    uint64_t lost;
+    double loss_percent;
+
+    // What the transmitter actually managed, which falls short of the offered load when the host
+    // can't keep up
+    double sent_gbps;
+    double sent_pps;
+
+    latency_histogram latencies;
+    bool passed;
+};
+
+// The inputs' first message, repeated to fill body_size bytes, or a counting pattern without one
+static std::vector<uint8_t> create_body(const options& opts, size_t body_size)
+{
+    std::vector<uint8_t> pattern;
+    if (!opts.inputs.empty()) pattern = string_to_hex(opts.inputs[0]);
+
+    std::vector<uint8_t> body(body_size);
+    for (size_t i = 0; i < body_size; ++i)
+        body[i] = pattern.empty() ? static_cast<uint8_t>(i) : pattern[i % pattern.size()];
+
+    return body;
+}
+
+static benchmark_trial run_benchmark_trial(const options& opts, logger& log, size_t frame_size, const std::string& body_hex, double rate_gbps)
+{
+    options trial_opts = opts;
+    trial_opts.inputs = {body_hex};
+    trial_opts.expected_outputs.clear();
+    trial_opts.packet_count = 0;
+    trial_opts.duration_s = opts.benchmark_trial_s;
+    trial_opts.rate_gbps = rate_gbps;
+    trial_opts.rate_pps = 0;
+    trial_opts.measure_latency = true;
+
+    const size_t wire_bits = ethernet_wire_size(frame_size - 18) * 8;
+
+    std::cout << "Benchmark: " << frame_size << " byte frames at " << rate_gbps << " Gbps" << std::endl;
+    const trial_result result = run_trial(trial_opts, log);
+
+    benchmark_trial trial{};
+    trial.frame_size = frame_size;
+    trial.offered_gbps = rate_gbps;
+    trial.offered_pps = rate_gbps * 1e9 / static_cast<double>(wire_bits);
+    trial.sent = result.sent;
+    trial.latencies = create_latency_histogram();
+
+    // With several receiving interfaces, the worst of them decides the trial
+    bool damaged = false;
+    for (const receive_result& receiver: result.receivers)
+    {
+        trial.received += receiver.frames;
+        trial.lost = std::max(trial.lost, receiver.lost);
+        damaged = damaged || receiver.corrupted > 0 || receiver.duplicates > 0;
+        merge_latency_histogram(trial.latencies, receiver.latencies);
+    }
+
+    trial.loss_percent = trial.sent > 0 ? 100.0 * static_cast<double>(trial.lost) / static_cast<double>(trial.sent) : 100.0;
+
+    const double elapsed_s = static_cast<double>(result.elapsed_ns) / 1e9;
+    if (elapsed_s > 0)
+    {
+        trial.sent_gbps = static_cast<double>(result.wire_bytes) * 8 / elapsed_s / 1e9;
+        trial.sent_pps = static_cast<double>(trial.sent) / elapsed_s;
+    }
+
+    trial.passed = trial.sent > 0 && !damaged && trial.loss_percent <= opts.benchmark_loss_tolerance;
+
+    std::cout << "Benchmark: " << frame_size << " byte frames at " << rate_gbps << " Gbps: "
+        << "sent " << trial.sent << " (" << trial.sent_gbps << " Gbps), lost " << trial.lost
+        << " (" << trial.loss_percent << "%) - " << (trial.passed ? "pass" : "fail") << std::endl;
+
+    return trial;
+}
+
+static void write_csv(const std::string& path, const std::vector<benchmark_trial>& trials)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        perror(("Failed to open " + path).c_str());
+        exit(-1);
+    }
+
+    out << "frame_size,offered_gbps,offered_pps,sent,received,lost,loss_percent,sent_gbps,sent_pps,"
+        << "latency_min_ns,latency_mean_ns,latency_p50_ns,latency_p99_ns,latency_p999_ns,latency_max_ns,passed\n";
+
+    out << std::setprecision(10);
+    for (const benchmark_trial& trial: trials)
+    {
+        const latency_histogram& latencies = trial.latencies;
+        const double mean = latencies.total > 0 ? static_cast<double>(latencies.sum / latencies.total) : 0;
+
+        out << trial.frame_size << ',' << trial.offered_gbps << ',' << trial.offered_pps << ','
+            << trial.sent << ',' << trial.received << ',' << trial.lost << ',' << trial.loss_percent << ','
+            << trial.sent_gbps << ',' << trial.sent_pps << ','
+            << (latencies.total > 0 ? latencies.min : 0) << ',' << mean << ','
+            << latency_percentile(latencies, 50) << ',' << latency_percentile(latencies, 99) << ','
+            << latency_percentile(latencies, 99.9) << ',' << latencies.max << ','
+            << (trial.passed ? "true" : "false") << '\n';
+    }
+}
+
+static std::string latency_json(const latency_histogram& latencies)
+{
+    const double mean = latencies.total > 0 ? static_cast<double>(latencies.sum / latencies.total) : 0;
+
+    std::stringstream json;
+    json << std::setprecision(10)
+        << "{\"samples\": " << latencies.total
+        << ", \"min_ns\": " << (latencies.total > 0 ? latencies.min : 0)
+        << ", \"mean_ns\": " << mean
+        << ", \"p50_ns\": " << latency_percentile(latencies, 50)
+        << ", \"p99_ns\": " << latency_percentile(latencies, 99)
+        << ", \"p999_ns\": " << latency_percentile(latencies, 99.9)
+        << ", \"max_ns\": " << latencies.max << "}";
+
+    return json.str();
+}
+
+static void write_json(const std::string& path, const options& opts, const std::vector<benchmark_trial>& trials)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        perror(("Failed to open " + path).c_str());
+        exit(-1);
+    }
+
+    out << std::setprecision(10);
+    out << "{\n"
+        << "  \"line_rate_gbps\": " << opts.line_rate_gbps << ",\n"
+        << "  \"trial_s\": " << opts.benchmark_trial_s << ",\n"
+        << "  \"resolution_percent\": " << opts.benchmark_resolution << ",\n"
+        << "  \"loss_tolerance_percent\": " << opts.benchmark_loss_tolerance << ",\n"
+        << "  \"results\": [";
+
+    bool first_size = true;
+    for (size_t i = 0; i < trials.size();)
+    {
+        const size_t frame_size = trials[i].frame_size;
+
+        // This size's trials are next to each other; the fastest that passed is its throughput
+        size_t end = i;
+        const benchmark_trial* best = nullptr;
+        for (; end < trials.size() && trials[end].frame_size == frame_size; ++end)
+            if (trials[end].passed && (!best || trials[end].offered_gbps > best->offered_gbps)) best = &trials[end];
+
+        out << (first_size ? "\n" : ",\n")
+            << "    {\n"
+            << "      \"frame_size\": " << frame_size << ",\n"
+            << "      \"throughput_offered_gbps\": " << (best ? best->offered_gbps : 0) << ",\n"
+            << "      \"throughput_gbps\": " << (best ? best->sent_gbps : 0) << ",\n"
+            << "      \"throughput_pps\": " << (best ? best->sent_pps : 0) << ",\n"
+            << "      \"latency\": " << (best ? latency_json(best->latencies) : "null") << ",\n"
+            << "      \"trials\": [";
+
+        for (size_t j = i; j < end; ++j)
+        {
+            const benchmark_trial& trial = trials[j];
+            out << (j == i ? "\n" : ",\n")
+                << "        {\"offered_gbps\": " << trial.offered_gbps
+                << ", \"offered_pps\": " << trial.offered_pps
+                << ", \"sent\": " << trial.sent
+                << ", \"received\": " << trial.received
+                << ", \"lost\": " << trial.lost
+                << ", \"loss_percent\": " << trial.loss_percent
+                << ", \"sent_gbps\": " << trial.sent_gbps
+                << ", \"sent_pps\": " << trial.sent_pps
+                << ", \"passed\": " << (trial.passed ? "true" : "false")
+                << ", \"latency\": " << latency_json(trial.latencies) << "}";
+        }
+
+        out << "\n      ]\n    }";
+        first_size = false;
+        i = end;
+    }
+
+    out << "\n  ]\n}\n";
+}
+
+bool run_benchmark(const options& opts, logger& log)
+{
+    std::vector<benchmark_trial> trials;
+    bool every_size_passed = true;
+
+    const double resolution_gbps = opts.line_rate_gbps * opts.benchmark_resolution / 100.0;
+
+    for (size_t requested_size: opts.benchmark_frame_sizes)
+    {
+        // The headers and padding alone are bigger than the smallest Ethernet frames, so those sizes
+        // are tested at the smallest frame that carries any body at all
+        const size_t frame_size = std::max(requested_size, PADDED_UDP_FRAME_OVERHEAD + 1);
+        if (frame_size != requested_size)
+            std::cout << "Benchmark: " << requested_size << " byte frames can't carry a padded UDP body; "
+                << "testing " << frame_size << " byte frames instead" << std::endl;
+
+        const std::vector<uint8_t> body = create_body(opts, frame_size - PADDED_UDP_FRAME_OVERHEAD);
+        const std::string body_hex = buffer_to_hex(body.data(), static_cast<ssize_t>(body.size()));
+
+        double passing_gbps = 0;
+        double failing_gbps = opts.line_rate_gbps;
+        double rate_gbps = opts.line_rate_gbps;
+        bool any_passed = false;
+
+        for (int trial_index = 0; trial_index < MAX_TRIALS_PER_SIZE; ++trial_index)
+        {
+            benchmark_trial trial = run_benchmark_trial(opts, log, frame_size, body_hex, rate_gbps);
+            const bool passed = trial.passed;
+            trials.push_back(std::move(trial));
+
+            if (passed)
+            {
+                any_passed = true;
+                passing_gbps = rate_gbps;
+
+                // Nothing to search for if line rate itself passes
+                if (rate_gbps >= opts.line_rate_gbps) break;
+            }
+            else
+            {
+                failing_gbps = rate_gbps;
+            }
+
+            if (failing_gbps - passing_gbps <= resolution_gbps) break;
+            rate_gbps = (passing_gbps + failing_gbps) / 2;
+        }
+
+        std::cout << "Benchmark: " << frame_size << " byte frames: throughput "
+            << (any_passed ? std::to_string(passing_gbps) + " Gbps" : "(no rate passed)") << std::endl;
+
+        if (!any_passed) every_size_passed = false;
+    }
+
+    write_csv(opts.benchmark_report + ".csv", trials);
+    write_json(opts.benchmark_report + ".json", opts, trials);
+    std::cout << "Benchmark report written to " << opts.benchmark_report << ".csv and " << opts.benchmark_report << ".json" << std::endl;
+
+    return every_size_passed;
+}
@@ -0,0 +1,16 @@
+#ifndef TRAFFIC_GENERATOR_BENCHMARK_H
+#define TRAFFIC_GENERATOR_BENCHMARK_H
+
+#include "../util/log.h"
+#include "../util/options.h"
+
+// RFC 2544-style throughput test. For each frame size, trials of a fixed length are run at offered
+// loads chosen by binary search - starting from line rate, halving the gap between the fastest rate
+// that passed and the slowest that failed - until the two are within the resolution. The fastest
+// passing rate is the throughput at that size, and its trial's latencies are the latency at it.
+//
+// Every trial is reported to <report>.csv, and each size's throughput and latency (with its trials)
+// to <report>.json. Returns false if some frame size didn't pass at any rate tried.
+bool run_benchmark(const options& opts, logger& log);
+
+#endif //TRAFFIC_GENERATOR_BENCHMARK_H
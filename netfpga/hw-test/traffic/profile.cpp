@@ -0,0 +1,379 @@
+#include "profile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <tuple>
+
+#include "../network/packet_template.h"
+#include "../util/string_utils.h"
+
+// The simple IMIX: seven 64 byte frames to every four of 570 bytes and one of 1518
+static const std::vector<frame_size_weight> SIMPLE_IMIX = {{64, 7}, {570, 4}, {1518, 1}};
+
+constexpr size_t DEFAULT_PACKET_COUNT = 4096;
+
+// splitmix64: tiny, fast, and the same sequence everywhere - unlike the standard library's
+// distributions, which are free to differ from one implementation to the next
+static uint64_t next_random(uint64_t& state)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, bound)
+static uint64_t next_below(uint64_t& state, uint64_t bound)
+{
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(next_random(state)) * bound) >> 64);
+}
+
+// Uniform in [0, 1)
+static double next_unit(uint64_t& state)
+{
+    return static_cast<double>(next_random(state) >> 11) * 0x1.0p-53;
+}
+
+// The index of the first cumulative weight above a uniform draw
+static size_t pick(uint64_t& state, const std::vector<double>& cumulative)
+{
+    const double target = next_unit(state) * cumulative.back();
+    const size_t index = static_cast<size_t>(std::upper_bound(cumulative.begin(), cumulative.end(), target) - cumulative.begin());
+    return std::min(index, cumulative.size() - 1);
+}
+
+static std::string trim(const std::string& text)
+{
+    const size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos) return "";
+
+    const size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+// A line number of 0 is for problems with the profile as a whole
+[[noreturn]] static void profile_error(const std::string& path, size_t line_number, const std::string& message)
+{
+    std::cerr << path << (line_number > 0 ? ":" + std::to_string(line_number) : "") << ": " << message << std::endl;
+    exit(-1);
+}
+
+static bool parse_unsigned(const std::string& text, uint64_t& value)
+{
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+
+    errno = 0;
+    value = std::strtoull(text.c_str(), nullptr, 10);
+    return errno == 0;
+}
+
+static bool parse_double(const std::string& text, double& value)
+{
+    char* end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return !text.empty() && *end == '\0' && std::isfinite(value);
+}
+
+static bool parse_frame_sizes(const std::string& text, std::vector<frame_size_weight>& frame_sizes)
+{
+    if (text == "imix")
+    {
+        frame_sizes = SIMPLE_IMIX;
+        return true;
+    }
+
+    frame_sizes.clear();
+    for (const std::string& entry: split(text, ','))
+    {
+        // A size without a weight counts once
+        const size_t colon = entry.find(':');
+        uint64_t size = 0;
+        double weight = 1;
+
+        if (!parse_unsigned(trim(entry.substr(0, colon)), size) || size == 0) return false;
+        if (colon != std::string::npos && (!parse_double(trim(entry.substr(colon + 1)), weight) || weight <= 0)) return false;
+
+        frame_sizes.push_back({static_cast<size_t>(size), weight});
+    }
+
+    return !frame_sizes.empty();
+}
+
+static bool parse_flow_distribution(const std::string& text, double& skew)
+{
+    if (text == "uniform")
+    {
+        skew = 0;
+        return true;
+    }
+
+    const std::string prefix = "zipf:";
+    if (text.compare(0, prefix.size(), prefix) != 0) return false;
+
+    return parse_double(text.substr(prefix.size()), skew) && skew > 0;
+}
+
+// How many 5-tuples the ranges hold, as a double since it can overflow anything narrower
+static double flow_space(const flow_ranges& ranges)
+{
+    return (static_cast<double>(ranges.src_ip.last) - ranges.src_ip.first + 1)
+        * (static_cast<double>(ranges.dest_ip.last) - ranges.dest_ip.first + 1)
+        * (static_cast<double>(ranges.src_port.last) - ranges.src_port.first + 1)
+        * (static_cast<double>(ranges.dst_port.last) - ranges.dst_port.first + 1);
+}
+
+traffic_profile load_traffic_profile(const std::string& path, const flow_ranges& defaults)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        perror(("Failed to open " + path).c_str());
+        exit(-1);
+    }
+
+    traffic_profile profile
+    {
+        .path = path,
+        .ranges = defaults,
+        .flow_count = 1,
+        .flow_skew = 0,
+        .frame_sizes = SIMPLE_IMIX,
+        .payloads = payload_source::prng,
+        .corpus_path = "",
+        .seed = 1,
+        .packet_count = DEFAULT_PACKET_COUNT,
+    };
+
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(file, line))
+    {
+        ++line_number;
+
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+
+        const size_t equals = line.find('=');
+        if (equals == std::string::npos) profile_error(path, line_number, "expected key = value");
+
+        const std::string key = trim(line.substr(0, equals));
+        const std::string value = trim(line.substr(equals + 1));
+        uint64_t number = 0;
+
+        if (key == "flows")
+        {
+            if (!parse_unsigned(value, number) || number == 0) profile_error(path, line_number, "flows must be a count above 0");
+            profile.flow_count = static_cast<size_t>(number);
+        }
+        else if (key == "src_ip")
+        {
+            if (!parse_address_range(value, profile.ranges.src_ip)) profile_error(path, line_number, "bad address range " + value);
+        }
+        else if (key == "dst_ip")
+        {
+            if (!parse_address_range(value, profile.ranges.dest_ip)) profile_error(path, line_number, "bad address range " + value);
+        }
+        else if (key == "src_port")
+        {
+            if (!parse_port_range(value, profile.ranges.src_port)) profile_error(path, line_number, "bad port range " + value);
+        }
+        else if (key == "dst_port")
+        {
+            if (!parse_port_range(value, profile.ranges.dst_port)) profile_error(path, line_number, "bad port range " + value);
+        }
+        else if (key == "flow_distribution")
+        {
+            if (!parse_flow_distribution(value, profile.flow_skew)) profile_error(path, line_number, "flow_distribution must be uniform or zipf:S, with S above 0");
+        }
+        else if (key == "frame_sizes")
+        {
+            if (!parse_frame_sizes(value, profile.frame_sizes)) profile_error(path, line_number, "frame_sizes must be imix or a list of size:weight pairs");
+        }
+        else if (key == "payload")
+        {
+            if (value == "prng") profile.payloads = payload_source::prng;
+            else if (value == "corpus") profile.payloads = payload_source::corpus;
+            else profile_error(path, line_number, "payload must be prng or corpus");
+        }
+        else if (key == "corpus")
+        {
+            if (value.empty()) profile_error(path, line_number, "corpus needs a file name");
+
+            // Relative to the profile, so a profile and its corpus can be kept together
+            const size_t slash = path.rfind('/');
+            profile.corpus_path = (value[0] == '/' || slash == std::string::npos) ? value : path.substr(0, slash + 1) + value;
+        }
+        else if (key == "seed")
+        {
+            if (!parse_unsigned(value, number)) profile_error(path, line_number, "seed must be a number");
+            profile.seed = number;
+        }
+        else if (key == "packets")
+        {
+            if (!parse_unsigned(value, number) || number == 0) profile_error(path, line_number, "packets must be a count above 0");
+            profile.packet_count = static_cast<size_t>(number);
+        }
+        else
+        {
+            profile_error(path, line_number, "unknown key " + key);
+        }
+    }
+
+    if (profile.payloads == payload_source::corpus && profile.corpus_path.empty())
+        profile_error(path, 0, "payload = corpus needs a corpus file");
+
+    if (static_cast<double>(profile.flow_count) > flow_space(profile.ranges))
+        profile_error(path, 0, "the address and port ranges don't hold " + std::to_string(profile.flow_count) + " distinct flows");
+
+    return profile;
+}
+
+static std::vector<char> read_corpus(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        perror(("Failed to open " + path).c_str());
+        exit(-1);
+    }
+
+    std::vector<char> corpus((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (corpus.empty())
+    {
+        std::cerr << "Corpus " << path << " is empty" << std::endl;
+        exit(-1);
+    }
+
+    return corpus;
+}
+
+// Draws flow_count distinct 5-tuples from the ranges, and builds each one's headers
+static std::vector<packet_template> create_flow_templates(const traffic_profile& profile, uint64_t& state)
+{
+    const flow_ranges& ranges = profile.ranges;
+
+    std::set<std::tuple<uint32_t, uint32_t, uint16_t, uint16_t>> drawn;
+    std::vector<packet_template> templates;
+    templates.reserve(profile.flow_count);
+
+    while (templates.size() < profile.flow_count)
+    {
+        const auto flow = std::make_tuple(
+            static_cast<uint32_t>(ranges.src_ip.first + next_below(state, uint64_t{ranges.src_ip.last} - ranges.src_ip.first + 1)),
+            static_cast<uint32_t>(ranges.dest_ip.first + next_below(state, uint64_t{ranges.dest_ip.last} - ranges.dest_ip.first + 1)),
+            static_cast<uint16_t>(ranges.src_port.first + next_below(state, uint64_t{ranges.src_port.last} - ranges.src_port.first + 1)),
+            static_cast<uint16_t>(ranges.dst_port.first + next_below(state, uint64_t{ranges.dst_port.last} - ranges.dst_port.first + 1))
+        );
+
+        if (!drawn.insert(flow).second) continue;
+        templates.push_back(create_packet_template(std::get<0>(flow), std::get<1>(flow), std::get<2>(flow), std::get<3>(flow)));
+    }
+
+    return templates;
+}
+
+void build_profile_packets(const traffic_profile& profile, packet_set& set, const std::string& interface_name)
+{
+    uint64_t state = profile.seed;
+
+    const std::vector<packet_template> templates = create_flow_templates(profile, state);
+    const std::vector<char> corpus = profile.payloads == payload_source::corpus ? read_corpus(profile.corpus_path) : std::vector<char>();
+
+    // Zipf weights flow k by 1/k^s, so the first few flows carry most of the packets
+    std::vector<double> flow_weights(templates.size());
+    for (size_t i = 0; i < flow_weights.size(); ++i)
+    {
+        const double weight = profile.flow_skew > 0 ? 1.0 / std::pow(static_cast<double>(i + 1), profile.flow_skew) : 1.0;
+        flow_weights[i] = (i > 0 ? flow_weights[i - 1] : 0) + weight;
+    }
+
+    // The headers and padding alone are bigger than the smallest Ethernet frames, so those sizes are
+    // sent as the smallest frame that carries any body at all
+    std::vector<double> size_weights;
+    std::vector<size_t> body_sizes;
+    for (const frame_size_weight& entry: profile.frame_sizes)
+    {
+        const size_t frame_size = std::max(entry.frame_size, PADDED_UDP_FRAME_OVERHEAD + 1);
+        if (frame_size != entry.frame_size)
+            std::cout << interface_name << ": " << entry.frame_size << " byte frames can't carry a padded UDP body; "
+                << "sending " << frame_size << " byte frames instead" << std::endl;
+
+        size_weights.push_back((size_weights.empty() ? 0 : size_weights.back()) + entry.weight);
+        body_sizes.push_back(frame_size - PADDED_UDP_FRAME_OVERHEAD);
+    }
+
+    std::vector<char> body(*std::max_element(body_sizes.begin(), body_sizes.end()));
+    std::vector<uint64_t> flow_packets(templates.size(), 0);
+    uint64_t frame_bytes = 0;
+
+    for (size_t i = 0; i < profile.packet_count; ++i)
+    {
+        const size_t flow = profile.flow_skew > 0 ? pick(state, flow_weights) : next_below(state, templates.size());
+        const size_t body_size = body_sizes[pick(state, size_weights)];
+
+        if (profile.payloads == payload_source::prng)
+        {
+            for (size_t offset = 0; offset < body_size; offset += sizeof(uint64_t))
+            {
+                const uint64_t random = next_random(state);
+                std::copy_n(reinterpret_cast<const char*>(&random), std::min(sizeof(random), body_size - offset), body.data() + offset);
+            }
+        }
+        else
+        {
+            // A slice starting anywhere in the corpus, wrapping around its end
+            size_t position = next_below(state, corpus.size());
+            for (size_t offset = 0; offset < body_size;)
+            {
+                const size_t chunk = std::min(body_size - offset, corpus.size() - position);
+                std::copy_n(corpus.data() + position, chunk, body.data() + offset);
+                offset += chunk;
+                position = 0;
+            }
+        }
+
+        char* packet = add_packet(set, PADDED_UDP_HEADER_SIZE + body_size);
+        write_padded_udp_packet(templates[flow], packet, body.data(), body_size, static_cast<uint16_t>(i));
+
+        ++flow_packets[flow];
+        frame_bytes += body_size + PADDED_UDP_FRAME_OVERHEAD;
+    }
+
+    const uint64_t heaviest = *std::max_element(flow_packets.begin(), flow_packets.end());
+    const size_t flows_used = static_cast<size_t>(std::count_if(flow_packets.begin(), flow_packets.end(), [](uint64_t count) { return count > 0; }));
+
+    std::cout << interface_name << ": Built " << profile.packet_count << " packets from " << profile.path
+        << " over " << flows_used << " flows (the busiest has "
+        << 100.0 * static_cast<double>(heaviest) / static_cast<double>(profile.packet_count) << "% of the packets), "
+        << "mean frame size " << static_cast<double>(frame_bytes) / static_cast<double>(profile.packet_count) << " bytes" << std::endl;
+}
+
+void print_traffic_profile(const traffic_profile& profile)
+{
+    std::vector<std::string> sizes;
+    for (const frame_size_weight& entry: profile.frame_sizes)
+    {
+        char weight[32];
+        snprintf(weight, sizeof(weight), "%g", entry.weight);
+        sizes.push_back(std::to_string(entry.frame_size) + ":" + weight);
+    }
+
+    std::cout << "  Profile:                 " << profile.path << std::endl;
+    std::cout << "    Flows:                 " << profile.flow_count
+        << (profile.flow_skew > 0 ? " (Zipf, s = " + std::to_string(profile.flow_skew) + ")" : " (uniform)") << std::endl;
+    std::cout << "    Source IPs:            " << address_range_to_string(profile.ranges.src_ip) << std::endl;
+    std::cout << "    Destination IPs:       " << address_range_to_string(profile.ranges.dest_ip) << std::endl;
+    std::cout << "    Source Ports:          " << port_range_to_string(profile.ranges.src_port) << std::endl;
+    std::cout << "    Destination Ports:     " << port_range_to_string(profile.ranges.dst_port) << std::endl;
+    std::cout << "    Frame Sizes:           " << join(sizes, ",") << std::endl;
+    std::cout << "    Payloads:              " << (profile.payloads == payload_source::prng ? "PRNG" : "corpus " + profile.corpus_path) << std::endl;
+    std::cout << "    Seed:                  " << profile.seed << std::endl;
+    std::cout << "    Packets:               " << profile.packet_count << std::endl;
+}
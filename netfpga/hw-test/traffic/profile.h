@@ -0,0 +1,69 @@
+#ifndef TRAFFIC_GENERATOR_PROFILE_H
+#define TRAFFIC_GENERATOR_PROFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../network/flow.h"
+#include "../network/tx_batch.h"
+
+// A traffic profile sends a realistic mix instead of the test vectors: many flows, a distribution of
+// frame sizes, and payloads from a seeded PRNG or cut from a corpus. It's a small key = value file
+// (# starts a comment), where every key is optional:
+//
+//   flows = 1000                 distinct 5-tuples, drawn from the ranges below (default 1)
+//   src_ip = 10.0.0.0/16         a.b.c.d, a.b.c.d-e.f.g.h or a.b.c.d/prefix (default -s)
+//   dst_ip = 10.1.0.1-10.1.0.8   (default -d)
+//   src_port = 1024-65535        n or n-m (default -p)
+//   dst_port = 1                 (default -p)
+//   flow_distribution = zipf:1.1 uniform, or zipf:S for a few heavy flows and a long tail (default uniform)
+//   frame_sizes = imix           Ethernet frame sizes, FCS included, as size:weight pairs, e.g.
+//                                64:7,570:4,1518:1 - which is what imix stands for (the default)
+//   payload = prng               prng, or corpus to cut payloads out of the corpus file (default prng)
+//   corpus = regex-corpus.txt    relative to the profile
+//   seed = 1                     the same seed always builds the same packets (default 1)
+//   packets = 4096               distinct packets built up front, which the send loop cycles through
+//                                (default 4096)
+//
+// Every packet is still sent to -d (and -m): the destination address in its header is only what the
+// DUT sees, not where the kernel routes it.
+struct frame_size_weight
+{
+    size_t frame_size;
+    double weight;
+};
+
+enum class payload_source
+{
+    prng,
+    corpus,
+};
+
+struct traffic_profile
+{
+    std::string path;
+    flow_ranges ranges;
+    size_t flow_count;
+
+    // 0 for a uniform spread over the flows, otherwise the exponent of a Zipf distribution
+    double flow_skew;
+
+    std::vector<frame_size_weight> frame_sizes;
+    payload_source payloads;
+    std::string corpus_path;
+    uint64_t seed;
+    size_t packet_count;
+};
+
+// Exits with a message if the file can't be read or doesn't make sense. Whatever ranges the profile
+// doesn't give are taken from defaults.
+traffic_profile load_traffic_profile(const std::string& path, const flow_ranges& defaults);
+
+// Builds the profile's packets into set (with the IP ids numbered from 0), and describes them
+void build_profile_packets(const traffic_profile& profile, packet_set& set, const std::string& interface_name);
+
+void print_traffic_profile(const traffic_profile& profile);
+
+#endif //TRAFFIC_GENERATOR_PROFILE_H
@@ -0,0 +1,474 @@
+#include "receiver.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <unistd.h>
+
+#include "../network/fanout.h"
+#include "../network/filter.h"
+#include "../network/packet.h"
+#include "../network/socket.h"
+#include "../network/stamp.h"
+#include "../util/affinity.h"
+
+// Waits are split up into slices this long, so that a worker whose share of the traffic has dried up
+// notices promptly when the rest of its group has finished
+constexpr int RECEIVE_POLL_MS = 100;
+
+// A soak's sequence trackers keep this many words of 64 sequence numbers (2 MiB, or 16M frames), and
+// at most twice that
+constexpr size_t SOAK_SEQUENCE_WINDOW_WORDS = 1 << 18;
+
+// Every flow the transmitter sends, and so every flow the DUT's output can belong to
+static flow_ranges sent_flows(const options& opts)
+{
+    if (uses_profile(opts)) return opts.profile.ranges;
+    return single_flow(opts.src_ip_addr, opts.dest_ip_addr, static_cast<uint16_t>(opts.port));
+}
+
+// Only what the DUT sends back (or, when replaying a trace, any IPv4) should ever reach user space
+static std::vector<sock_filter> create_receive_filter(const options& opts)
+{
+    if (!opts.use_receive_filter) return {};
+    if (!opts.pcap_input.empty()) return create_ipv4_filter();
+
+    return create_dut_output_filter(sent_flows(opts));
+}
+
+static receive_source create_receive_source(const std::string& interface_name, size_t worker, const options& opts)
+{
+    receive_source source{};
+    source.use_xdp = opts.use_xdp;
+    source.use_rx_ring = opts.use_rx_ring && !opts.use_xdp;
+    source.use_uring = opts.use_uring;
+
+    const std::vector<sock_filter> filter = create_receive_filter(opts);
+
+    if (source.use_xdp)
+    {
+        // The XDP program takes the place of the BPF filter
+        source.xsk = create_xdp_socket(interface_name, opts.xdp_queue + static_cast<uint32_t>(worker), opts.xdp_settings);
+        source.socket_fd = source.xsk.socket_fd;
+    }
+    else if (source.use_rx_ring)
+    {
+        source.ring = create_rx_ring(interface_name, opts.ring_config, filter);
+        source.socket_fd = source.ring.socket_fd;
+    }
+    else if (source.use_uring)
+    {
+        source.socket_fd = create_receive_socket(interface_name, filter);
+        source.uring = create_uring_rx(source.socket_fd, uring_config{});
+    }
+    else
+    {
+        source.socket_fd = create_receive_socket(interface_name, filter);
+
+        // The ring always carries a timestamp per frame, a plain socket has to ask for one
+        if (opts.measure_latency || !opts.pcap_output.empty()) enable_receive_timestamps(source.socket_fd);
+    }
+
+    return source;
+}
+
+static void destroy_receive_source(receive_source& source)
+{
+    if (source.use_xdp)
+        destroy_xdp_socket(source.xsk);
+    else if (source.use_rx_ring)
+        destroy_rx_ring(source.ring);
+    else
+    {
+        if (source.use_uring) destroy_uring_rx(source.uring);
+        close(source.socket_fd);
+    }
+}
+
+// Points frame at the next frame from source - either into buffer, or straight into the ring or UMEM
+static bool receive_next_frame(receive_source& source, char* buffer, size_t buffer_size, const uint8_t*& frame, size_t& frame_size, uint64_t& timestamp_ns, int timeout_ms)
+{
+    if (source.use_xdp)
+        return xdp_receive_frame(source.xsk, frame, frame_size, timestamp_ns, timeout_ms);
+
+    if (source.use_rx_ring)
+        return receive_frame(source.ring, frame, frame_size, timestamp_ns, timeout_ms);
+
+    if (source.use_uring)
+        return uring_receive_frame(source.uring, frame, frame_size, timestamp_ns, timeout_ms);
+
+    ssize_t data_size;
+    if (!receive_packet(source.socket_fd, buffer, buffer_size, data_size, timestamp_ns, timeout_ms))
+        return false;
+
+    frame = reinterpret_cast<const uint8_t*>(buffer);
+    frame_size = static_cast<size_t>(data_size);
+    return true;
+}
+
+// With several receiving interfaces, each gets its own capture: out.pcap becomes out-eth1.pcap
+static std::string capture_path(const std::string& path, const std::string& interface_name, const options& opts)
+{
+    if (opts.receive_interfaces.size() == 1) return path;
+
+    const size_t slash = path.rfind('/');
+    const size_t dot = path.rfind('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return path + "-" + interface_name;
+
+    return path.substr(0, dot) + "-" + interface_name + path.substr(dot);
+}
+
+receive_group create_receive_group(const std::string& interface_name, const options& opts, logger& log)
+{
+    receive_group group{};
+    group.interface_name = interface_name;
+    group.counters = std::make_unique<receive_counters[]>(opts.rx_threads);
+    group.expected = create_expected_set(opts.expected_outputs);
+    group.claims = create_expected_claims(group.expected);
+
+    // Bounds the sequence numbers a stamp can plausibly carry, so a garbled one can't grow a
+    // tracker's bitmap without limit
+    uint64_t sequence_limit = opts.inputs.size();
+    if (is_load_mode(opts)) sequence_limit = opts.packet_count > 0 ? opts.packet_count : 1ull << 32;
+
+    // A soak has no end to bound its sequence numbers by - the workers bound them by how far the
+    // transmitter's got instead
+    if (opts.soak && opts.packet_count == 0) sequence_limit = UINT64_MAX;
+    const size_t sequence_window = opts.soak ? SOAK_SEQUENCE_WINDOW_WORDS : 0;
+
+    if (opts.soak)
+    {
+        group.live = std::make_unique<live_latencies[]>(opts.rx_threads);
+        for (size_t i = 0; i < opts.rx_threads; ++i) group.live[i].latencies = create_latency_histogram();
+    }
+
+    if (!opts.pcap_output.empty())
+    {
+        group.capture_path = capture_path(opts.pcap_output, interface_name, opts);
+        group.capture = std::make_unique<pcap_writer>();
+        open_pcap_writer(*group.capture, group.capture_path);
+        group.capture_chunks.resize(opts.rx_threads);
+    }
+
+    if (opts.use_xdp)
+    {
+        group.program = attach_xdp_program(interface_name, sent_flows(opts).dst_port, opts.xdp_settings.force_skb);
+        std::cout << "    Attached XDP program in " << (group.program.skb_mode ? "generic (SKB)" : "native") << " mode" << std::endl;
+    }
+
+    uint16_t fanout_group = 0;
+    for (size_t i = 0; i < opts.rx_threads; ++i)
+    {
+        group.sources.push_back(create_receive_source(interface_name, i, opts));
+        group.latencies.push_back(create_latency_histogram());
+        group.trackers.push_back(create_sequence_tracker(sequence_limit, sequence_window));
+        group.log_queues.push_back(&get_log_queue(log, opts.rx_threads == 1 ? interface_name : interface_name + "[" + std::to_string(i) + "]"));
+
+        if (opts.use_xdp)
+        {
+            const xdp_socket& xsk = group.sources[i].xsk;
+            register_xdp_socket(group.program, xsk);
+            std::cout << "    Bound AF_XDP socket to queue " << xsk.queue << " in " << (xsk.zero_copy ? "zero-copy" : "copy") << " mode" << std::endl;
+            continue;
+        }
+
+        if (opts.rx_threads == 1) continue;
+
+        if (i == 0)
+            fanout_group = create_fanout_group(group.sources[i].socket_fd, opts.fanout_mode);
+        else
+            join_fanout_group(group.sources[i].socket_fd, fanout_group, opts.fanout_mode);
+    }
+
+    return group;
+}
+
+static uint64_t group_frames(const receive_group& group)
+{
+    uint64_t frames = 0;
+    for (size_t i = 0; i < group.sources.size(); ++i)
+        frames += group.counters[i].frames.load(std::memory_order_relaxed);
+
+    return frames;
+}
+
+// Whether the group has seen every frame it's going to: each expected message once, or in load mode
+// everything the transmitter sent (which we only know once it's done)
+static bool group_finished(const receive_group& group, bool load_mode, const transmit_progress& progress)
+{
+    if (!load_mode) return group_frames(group) >= group.expected.messages.size();
+
+    if (!progress.done.load(std::memory_order_acquire)) return false;
+    return group_frames(group) >= progress.packets_sent.load(std::memory_order_relaxed);
+}
+
+// Only this worker writes its counters, so a plain load and store is enough - no locked add
+static inline void increment(std::atomic<uint64_t>& counter)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+static void hand_over_latencies(live_latencies& live, latency_histogram& window)
+{
+    std::lock_guard<std::mutex> guard(live.lock);
+    merge_latency_histogram(live.latencies, window);
+    live.wanted.store(false, std::memory_order_relaxed);
+    clear_latency_histogram(window);
+}
+
+void receive_worker(receive_group& group, size_t worker, int cpu, const options& opts, const transmit_progress& progress)
+{
+    pin_current_thread(cpu);
+
+    char buffer[65536];
+
+    const bool load_mode = is_load_mode(opts);
+    const bool stamped = stamp_packets(opts);
+    const bool replaying = !opts.pcap_input.empty();
+    const expected_set& expected = group.expected;
+
+    // A soak with no end has no fixed bound on its sequence numbers, but none can be much further
+    // ahead of what the transmitter has sent than the trackers' windows
+    const bool bound_by_progress = opts.soak && opts.packet_count == 0;
+
+    receive_source& source = group.sources[worker];
+    receive_counters& counters = group.counters[worker];
+    latency_histogram& latencies = group.latencies[worker];
+    sequence_tracker& tracker = group.trackers[worker];
+    log_queue& log = *group.log_queues[worker];
+
+    // In a soak, the latencies recorded since the reporter last asked for them
+    live_latencies* live = group.live ? &group.live[worker] : nullptr;
+    latency_histogram window = live ? create_latency_histogram() : latency_histogram{};
+
+    int idle_ms = 0;
+
+    while (!group_finished(group, load_mode, progress))
+    {
+        if (live && live->wanted.load(std::memory_order_relaxed)) hand_over_latencies(*live, window);
+
+        const uint8_t* frame = nullptr;
+        size_t data_size = 0;
+        uint64_t rx_ns = 0;
+        if (!receive_next_frame(source, buffer, sizeof(buffer), frame, data_size, rx_ns, RECEIVE_POLL_MS))
+        {
+            idle_ms += RECEIVE_POLL_MS;
+
+            // A quiet spell while the transmitter is still running just means the DUT fell behind or
+            // dropped frames - the final tally accounts for that
+            if (load_mode && !progress.done.load(std::memory_order_acquire)) continue;
+
+            if (idle_ms >= opts.receive_timeout_ms) break;
+            continue;
+        }
+
+        idle_ms = 0;
+
+        // The capture gets everything the kernel's filter lets through
+        if (group.capture) write_pcap_record(*group.capture, group.capture_chunks[worker], frame, data_size, rx_ns);
+
+        const uint8_t* payload = nullptr;
+        size_t payload_len = 0;
+        uint16_t src_port = 0;
+        uint16_t dst_port = 0;
+
+        // 1) Drop anything that's not IPv4+UDP - unless we're replaying a trace, which can hold any
+        //    IPv4 traffic, not just our own padded UDP
+        const bool is_udp = extract_padded_udp_payload(frame, data_size, payload, payload_len, src_port, dst_port);
+
+        if (is_udp && is_dhcp_packet(src_port, dst_port))
+            continue;
+
+        if (!is_udp && !(replaying && is_ipv4_frame(frame, data_size)))
+            continue;
+
+        increment(counters.frames);
+
+        // The stamp's sequence number says which input this was, no matter which worker it landed on
+        // or in what order; without one, the payload itself is looked up among the expected outputs
+        packet_stamp stamp{};
+        const bool has_stamp = stamped && read_stamp(frame, data_size, stamp);
+
+        sequence_status status = sequence_status::in_order;
+        long expected_index = -1;
+
+        if (has_stamp)
+        {
+            if (bound_by_progress)
+                tracker.limit = progress.packets_sent.load(std::memory_order_relaxed) + SOAK_SEQUENCE_WINDOW_WORDS * 64;
+
+            status = track_sequence(tracker, stamp.sequence);
+            if (!expected.messages.empty()) expected_index = static_cast<long>(stamp.sequence % expected.messages.size());
+        }
+        else if (is_udp && !expected.messages.empty())
+        {
+            expected_index = find_expected(expected, payload, payload_len);
+
+            // Each output only answers for as many inputs as it's expected for; any more copies of it
+            // are extras, standing in for another input's output (which is then lost)
+            if (expected_index >= 0 && !claim_expected(group.claims, expected, expected_index))
+                status = sequence_status::duplicate;
+        }
+
+        const bool do_messages_match = expected_index >= 0 && matches_expected(expected, expected_index, payload, payload_len);
+
+        // A stamp that's missing (when every packet was sent with one) or impossible means the
+        // headers came back damaged, whatever the payload looks like
+        const bool damaged = (stamped && !has_stamp) || status == sequence_status::out_of_range;
+
+        if (status == sequence_status::duplicate)
+            increment(counters.duplicates);
+        else if (damaged || (!expected.messages.empty() && !do_messages_match))
+            increment(counters.corrupted);
+        else if (do_messages_match)
+            increment(counters.matches);
+
+        if (status == sequence_status::reordered) increment(counters.reordered);
+
+        // Both ends are stamped from CLOCK_REALTIME on this host, so the difference is the time from
+        // just before the send syscall to the kernel receiving the frame back
+        const bool has_latency = opts.measure_latency && has_stamp && rx_ns >= stamp.tx_ns;
+        if (has_latency)
+        {
+            record_latency(latencies, rx_ns - stamp.tx_ns);
+            if (live) record_latency(window, rx_ns - stamp.tx_ns);
+        }
+
+        const bool mismatched = !expected.messages.empty() && !do_messages_match;
+        const bool error = damaged || status == sequence_status::duplicate || mismatched;
+        if (!log_wants_frame(log, error)) continue;
+
+        // Only the record is queued here; the writer thread does the formatting
+        frame_record record{};
+        record.event = log_event::received;
+        record.time_ns = rx_ns > 0 ? rx_ns : realtime_ns();
+        record.frame_size = static_cast<uint32_t>(data_size);
+        record.has_sequence = has_stamp;
+        record.sequence = stamp.sequence;
+        record.has_latency = has_latency;
+        record.latency_ns = has_latency ? rx_ns - stamp.tx_ns : 0;
+        record.reordered = status == sequence_status::reordered;
+
+        if (is_udp)
+        {
+            record.payload_offset = static_cast<uint32_t>(payload - frame);
+            record.payload_size = static_cast<uint32_t>(payload_len);
+        }
+
+        if (status == sequence_status::duplicate) record.verdict = "duplicate";
+        else if (damaged) record.verdict = "corrupted";
+        else if (mismatched) record.verdict = "mismatch";
+        else if (do_messages_match) record.verdict = "match";
+        else record.verdict = "unchecked";
+
+        const bool with_bytes = log_wants_bytes(log, error);
+        const std::vector<uint8_t>* expected_message = with_bytes && expected_index >= 0 ? &expected.messages[expected_index] : nullptr;
+
+        log_frame(
+            log,
+            record,
+            with_bytes ? frame : nullptr,
+            expected_message ? expected_message->data() : nullptr,
+            expected_message ? expected_message->size() : 0
+        );
+    }
+
+    if (group.capture) flush_pcap_chunk(*group.capture, group.capture_chunks[worker]);
+    if (live) hand_over_latencies(*live, window);
+
+    counters.drops.store(source.use_xdp ? get_xdp_drops(source.xsk) : get_receive_drops(source.socket_fd), std::memory_order_relaxed);
+}
+
+receive_result finish_receive_group(receive_group& group, const options& opts, const transmit_progress& progress)
+{
+    const std::string& interface_name = group.interface_name;
+
+    uint64_t frames = 0;
+    uint64_t matches = 0;
+    uint64_t corrupted = 0;
+    uint64_t duplicates = 0;
+    uint64_t reordered = 0;
+    uint64_t drops = 0;
+    latency_histogram latencies = create_latency_histogram();
+
+    for (size_t i = 0; i < group.sources.size(); ++i)
+    {
+        const receive_counters& counters = group.counters[i];
+        frames += counters.frames.load(std::memory_order_relaxed);
+        matches += counters.matches.load(std::memory_order_relaxed);
+        corrupted += counters.corrupted.load(std::memory_order_relaxed);
+        duplicates += counters.duplicates.load(std::memory_order_relaxed);
+        reordered += counters.reordered.load(std::memory_order_relaxed);
+        drops += counters.drops.load(std::memory_order_relaxed);
+        merge_latency_histogram(latencies, group.latencies[i]);
+
+        if (group.sources.size() > 1)
+            std::cout << interface_name << "[" << i << "]: "
+                << counters.frames.load(std::memory_order_relaxed) << " frames, "
+                << counters.matches.load(std::memory_order_relaxed) << " matched, "
+                << counters.corrupted.load(std::memory_order_relaxed) << " corrupted, "
+                << counters.duplicates.load(std::memory_order_relaxed) << " duplicated, "
+                << counters.reordered.load(std::memory_order_relaxed) << " reordered, "
+                << counters.drops.load(std::memory_order_relaxed) << " dropped by the kernel" << std::endl;
+
+        destroy_receive_source(group.sources[i]);
+    }
+
+    if (opts.use_xdp) detach_xdp_program(group.program);
+
+    // Outside load mode, only the inputs that have an expected output are waited for
+    const bool load_mode = is_load_mode(opts);
+    const uint64_t sent = load_mode
+        ? progress.packets_sent.load(std::memory_order_relaxed)
+        : std::min<uint64_t>(progress.packets_sent.load(std::memory_order_relaxed), group.expected.messages.size());
+
+    // With stamps, loss is exactly the sequence numbers nobody saw; without, it can only be inferred
+    // from the counts (every copy of an output beyond what's expected having been counted as a
+    // duplicate)
+    uint64_t lost;
+    if (stamp_packets(opts))
+    {
+        sequence_totals totals = merge_sequence_trackers(group.trackers, sent);
+        duplicates += totals.duplicates;
+        lost = sent - std::min(sent, totals.unique);
+    }
+    else
+    {
+        const uint64_t distinct = frames - std::min(frames, duplicates);
+        lost = sent - std::min(sent, distinct);
+    }
+
+    std::cout << interface_name << ": "
+        << "Received " << frames << " of " << sent << " packets sent: "
+        << matches << " matched, " << corrupted << " corrupted, " << duplicates << " duplicated, "
+        << reordered << " reordered, " << lost << " lost" << std::endl;
+
+    if (!load_mode && lost > 0)
+        std::cout << interface_name << ": " << "Timed out waiting for packets" << std::endl;
+
+    if (group.capture)
+    {
+        close_pcap_writer(*group.capture);
+        std::cout << interface_name << ": " << "Capture written to " << group.capture_path << std::endl;
+    }
+
+    if (drops > 0)
+        std::cout << interface_name << ": " << "Kernel dropped " << drops << " frames" << std::endl;
+
+    if (opts.measure_latency)
+        std::cout << interface_name << ": " << "Latency: " << latency_summary(latencies) << std::endl;
+
+    return receive_result
+    {
+        .sent = sent,
+        .frames = frames,
+        .matches = matches,
+        .corrupted = corrupted,
+        .duplicates = duplicates,
+        .reordered = reordered,
+        .lost = lost,
+        .drops = drops,
+        .latencies = std::move(latencies)
+    };
+}
@@ -0,0 +1,116 @@
+#ifndef TRAFFIC_GENERATOR_RECEIVER_H
+#define TRAFFIC_GENERATOR_RECEIVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../network/rx_ring.h"
+#include "../network/uring.h"
+#include "../network/xdp.h"
+#include "../util/histogram.h"
+#include "../util/log.h"
+#include "../util/options.h"
+#include "../util/pcap.h"
+#include "transmitter.h"
+#include "verifier.h"
+
+// Where a receiver reads its frames from: a plain socket, copied out one recvfrom at a time, a
+// TPACKET_V3 ring whose frames are read in place, an AF_XDP socket, read in place in its UMEM, or a
+// plain socket with an io_uring multishot receive, read in place in its buffers
+struct receive_source
+{
+    bool use_rx_ring;
+    bool use_xdp;
+    bool use_uring;
+    int socket_fd;
+    rx_ring ring;
+    xdp_socket xsk;
+    uring_rx uring;
+};
+
+// One worker's tallies. Only the worker itself ever writes them, and each set sits on its own cache
+// line, so the workers never contend; they're atomic only so that the other workers in the group
+// can read them to decide when everything has arrived.
+struct alignas(64) receive_counters
+{
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> matches{0};
+    std::atomic<uint64_t> corrupted{0};
+    std::atomic<uint64_t> duplicates{0};
+    std::atomic<uint64_t> reordered{0};
+    std::atomic<uint64_t> drops{0};
+};
+
+// In a soak, each worker hands the latencies it's recorded since it was last asked over to the
+// reporter (see traffic/soak.h): the reporter sets wanted, and the worker merges what it has into
+// latencies and clears its own. The lock is only taken once per report on either side.
+struct alignas(64) live_latencies
+{
+    std::mutex lock;
+    latency_histogram latencies;
+    std::atomic<bool> wanted{false};
+};
+
+// Everything receiving from one interface: a socket per worker (joined in a PACKET_FANOUT group when
+// there's more than one, or with AF_XDP, each bound to a queue of its own), and each worker's results,
+// merged by finish_receive_group once they're done
+struct receive_group
+{
+    std::string interface_name;
+    std::vector<receive_source> sources;
+
+    // With --xdp, steers the frames arriving on each queue to that queue's socket
+    xdp_program program;
+    std::unique_ptr<receive_counters[]> counters;
+    std::vector<latency_histogram> latencies;
+    std::vector<sequence_tracker> trackers;
+    std::vector<log_queue*> log_queues;
+
+    // Only in a soak
+    std::unique_ptr<live_latencies[]> live;
+
+    // With --pcap-out, every frame the workers see goes to one file per interface, each worker
+    // filling a chunk of its own
+    std::unique_ptr<pcap_writer> capture;
+    std::string capture_path;
+    std::vector<pcap_chunk> capture_chunks;
+
+    // Parsed once up front, since in load mode the same outputs are checked over and over
+    expected_set expected;
+    expected_claims claims;
+};
+
+// What one interface saw over a run, as finish_receive_group reports it
+struct receive_result
+{
+    uint64_t sent;
+    uint64_t frames;
+    uint64_t matches;
+    uint64_t corrupted;
+    uint64_t duplicates;
+    uint64_t reordered;
+    uint64_t lost;
+    uint64_t drops;
+    latency_histogram latencies;
+};
+
+// Anything lost, corrupted or duplicated is a failure; reordering is only reported
+inline bool receive_passed(const receive_result& result)
+{
+    return result.lost == 0 && result.corrupted == 0 && result.duplicates == 0;
+}
+
+receive_group create_receive_group(const std::string& interface_name, const options& opts, logger& log);
+
+// Receives and checks frames on one of the group's sockets, pinned to cpu (if it's not -1), until the
+// group as a whole has everything it expects, or the interface goes quiet
+void receive_worker(receive_group& group, size_t worker, int cpu, const options& opts, const transmit_progress& progress);
+
+// Merges the workers' results, reports them, and closes the group's sockets
+receive_result finish_receive_group(receive_group& group, const options& opts, const transmit_progress& progress);
+
+#endif //TRAFFIC_GENERATOR_RECEIVER_H
@@ -0,0 +1,443 @@
+#include "soak.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "../util/histogram.h"
+#include "../util/pacer.h"
+
+// How often the reporter wakes, between reports, to check for an interrupt or answer a scrape
+constexpr int SOAK_POLL_MS = 100;
+
+// How long a scrape gets to send its request and take the response before it's dropped
+constexpr int SCRAPE_TIMEOUT_MS = 100;
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void handle_interrupt(int)
+{
+    interrupted = 1;
+}
+
+// SA_RESETHAND puts the default handler back once the first signal's been caught, so a soak that
+// won't wind down can still be killed with a second Ctrl-C
+static void install_interrupt_handlers()
+{
+    interrupted = 0;
+
+    struct sigaction action{};
+    action.sa_handler = handle_interrupt;
+    action.sa_flags = SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+}
+
+static void remove_interrupt_handlers()
+{
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+}
+
+// One receiving interface's counters, summed over its workers, since the start of the run
+struct interface_counters
+{
+    uint64_t frames;
+    uint64_t matches;
+    uint64_t corrupted;
+    uint64_t duplicates;
+    uint64_t reordered;
+};
+
+struct soak_snapshot
+{
+    uint64_t time_ns;
+    uint64_t sent;
+    uint64_t wire_bytes;
+    std::vector<interface_counters> interfaces;
+};
+
+static soak_snapshot take_snapshot(const std::vector<receive_group>& groups, const transmit_progress& progress)
+{
+    soak_snapshot snapshot{};
+    snapshot.time_ns = monotonic_ns();
+    snapshot.sent = progress.packets_sent.load(std::memory_order_relaxed);
+    snapshot.wire_bytes = progress.wire_bytes.load(std::memory_order_relaxed);
+
+    for (const receive_group& group: groups)
+    {
+        interface_counters counters{};
+        for (size_t i = 0; i < group.sources.size(); ++i)
+        {
+            counters.frames += group.counters[i].frames.load(std::memory_order_relaxed);
+            counters.matches += group.counters[i].matches.load(std::memory_order_relaxed);
+            counters.corrupted += group.counters[i].corrupted.load(std::memory_order_relaxed);
+            counters.duplicates += group.counters[i].duplicates.load(std::memory_order_relaxed);
+            counters.reordered += group.counters[i].reordered.load(std::memory_order_relaxed);
+        }
+
+        snapshot.interfaces.push_back(counters);
+    }
+
+    return snapshot;
+}
+
+// Takes whatever latencies the group's workers have handed over (see live_latencies), and asks them
+// for the next lot
+static void collect_latencies(receive_group& group, latency_histogram& latencies)
+{
+    for (size_t i = 0; i < group.sources.size(); ++i)
+    {
+        live_latencies& live = group.live[i];
+
+        std::lock_guard<std::mutex> guard(live.lock);
+        merge_latency_histogram(latencies, live.latencies);
+        clear_latency_histogram(live.latencies);
+        live.wanted.store(true, std::memory_order_relaxed);
+    }
+}
+
+// Everything sent that hasn't (yet) come back, including whatever's still in flight
+static uint64_t missing(const interface_counters& counters, uint64_t sent)
+{
+    const uint64_t distinct = counters.frames - std::min(counters.frames, counters.duplicates);
+    return sent - std::min(sent, distinct);
+}
+
+static std::string format_elapsed(uint64_t elapsed_ns)
+{
+    const uint64_t seconds = elapsed_ns / 1000000000ull;
+
+    std::stringstream text;
+    text << std::setfill('0') << std::setw(2) << seconds / 3600 << ':'
+        << std::setw(2) << seconds / 60 % 60 << ':'
+        << std::setw(2) << seconds % 60;
+    return text.str();
+}
+
+static void print_report(
+    const std::vector<receive_group>& groups,
+    const options& opts,
+    const soak_snapshot& previous,
+    const soak_snapshot& current,
+    const std::vector<latency_histogram>& latencies,
+    uint64_t start_ns
+) {
+    const double interval_s = static_cast<double>(current.time_ns - previous.time_ns) / 1e9;
+    const std::string elapsed = "[" + format_elapsed(current.time_ns - start_ns) + "] ";
+
+    std::stringstream report;
+    report << std::fixed << std::setprecision(3);
+
+    report << elapsed << opts.transmit_interface << ": "
+        << static_cast<double>(current.sent - previous.sent) / interval_s << " pps, "
+        << static_cast<double>(current.wire_bytes - previous.wire_bytes) * 8 / interval_s / 1e9 << " Gbps on the wire" << '\n';
+
+    for (size_t i = 0; i < groups.size(); ++i)
+    {
+        const interface_counters& now = current.interfaces[i];
+        const interface_counters& before = previous.interfaces[i];
+        const uint64_t frames = now.frames - before.frames;
+
+        report << elapsed << groups[i].interface_name << ": "
+            << static_cast<double>(frames) / interval_s << " pps, ";
+
+        if (groups[i].expected.messages.empty())
+            report << "unchecked, ";
+        else
+            report << (frames == 0 ? 0.0 : 100.0 * static_cast<double>(now.matches - before.matches) / static_cast<double>(frames)) << "% matched, ";
+
+        report << now.corrupted - before.corrupted << " corrupted, "
+            << now.duplicates - before.duplicates << " duplicated, "
+            << now.reordered - before.reordered << " reordered, "
+            << missing(now, current.sent) << " missing";
+
+        if (opts.measure_latency)
+            report << ", latency p50 " << latency_percentile(latencies[i], 50) << " ns, "
+                << "p99 " << latency_percentile(latencies[i], 99) << " ns, "
+                << "p99.9 " << latency_percentile(latencies[i], 99.9) << " ns";
+
+        report << '\n';
+    }
+
+    std::cout << report.str() << std::flush;
+}
+
+static void write_csv_header(std::ofstream& csv)
+{
+    csv << "elapsed_s,interface,sent_pps,sent_gbps,received_pps,frames,matched,corrupted,duplicated,reordered,missing,"
+        << "latency_p50_ns,latency_p99_ns,latency_p999_ns" << std::endl;
+}
+
+static void write_csv_rows(
+    std::ofstream& csv,
+    const std::vector<receive_group>& groups,
+    const soak_snapshot& previous,
+    const soak_snapshot& current,
+    const std::vector<latency_histogram>& latencies,
+    uint64_t start_ns
+) {
+    const double interval_s = static_cast<double>(current.time_ns - previous.time_ns) / 1e9;
+
+    for (size_t i = 0; i < groups.size(); ++i)
+    {
+        const interface_counters& now = current.interfaces[i];
+        const interface_counters& before = previous.interfaces[i];
+
+        csv << static_cast<double>(current.time_ns - start_ns) / 1e9 << ','
+            << groups[i].interface_name << ','
+            << static_cast<double>(current.sent - previous.sent) / interval_s << ','
+            << static_cast<double>(current.wire_bytes - previous.wire_bytes) * 8 / interval_s / 1e9 << ','
+            << static_cast<double>(now.frames - before.frames) / interval_s << ','
+            << now.frames - before.frames << ','
+            << now.matches - before.matches << ','
+            << now.corrupted - before.corrupted << ','
+            << now.duplicates - before.duplicates << ','
+            << now.reordered - before.reordered << ','
+            << missing(now, current.sent) << ','
+            << latency_percentile(latencies[i], 50) << ','
+            << latency_percentile(latencies[i], 99) << ','
+            << latency_percentile(latencies[i], 99.9) << '\n';
+    }
+
+    csv.flush();
+}
+
+static void write_metric_family(std::stringstream& text, const char* name, const char* type, const char* help)
+{
+    text << "# HELP " << name << ' ' << help << '\n';
+    text << "# TYPE " << name << ' ' << type << '\n';
+}
+
+// The whole run so far, in the Prometheus text exposition format
+static std::string prometheus_metrics(
+    const std::vector<receive_group>& groups,
+    const options& opts,
+    const soak_snapshot& current,
+    const std::vector<latency_histogram>& totals,
+    uint64_t start_ns
+) {
+    std::stringstream text;
+
+    write_metric_family(text, "gapl_soak_elapsed_seconds", "gauge", "Time since the soak started.");
+    text << "gapl_soak_elapsed_seconds " << static_cast<double>(current.time_ns - start_ns) / 1e9 << '\n';
+
+    write_metric_family(text, "gapl_packets_sent_total", "counter", "Packets sent.");
+    text << "gapl_packets_sent_total{interface=\"" << opts.transmit_interface << "\"} " << current.sent << '\n';
+
+    write_metric_family(text, "gapl_wire_bytes_sent_total", "counter", "Bytes sent, counting the Ethernet preamble, FCS and gap.");
+    text << "gapl_wire_bytes_sent_total{interface=\"" << opts.transmit_interface << "\"} " << current.wire_bytes << '\n';
+
+    struct counter_family
+    {
+        const char* name;
+        const char* help;
+        uint64_t interface_counters::* counter;
+    };
+
+    const counter_family families[] =
+    {
+        {"gapl_frames_received_total",   "Frames received from the DUT.",                    &interface_counters::frames},
+        {"gapl_frames_matched_total",    "Frames that carried their expected output.",       &interface_counters::matches},
+        {"gapl_frames_corrupted_total",  "Frames that came back damaged or didn't match.",   &interface_counters::corrupted},
+        {"gapl_frames_duplicated_total", "Frames that came back more than once.",            &interface_counters::duplicates},
+        {"gapl_frames_reordered_total",  "Frames that came back after a later one.",         &interface_counters::reordered},
+    };
+
+    for (const counter_family& family: families)
+    {
+        write_metric_family(text, family.name, "counter", family.help);
+        for (size_t i = 0; i < groups.size(); ++i)
+            text << family.name << "{interface=\"" << groups[i].interface_name << "\"} " << current.interfaces[i].*family.counter << '\n';
+    }
+
+    write_metric_family(text, "gapl_frames_missing", "gauge", "Frames sent that haven't come back, including those still in flight.");
+    for (size_t i = 0; i < groups.size(); ++i)
+        text << "gapl_frames_missing{interface=\"" << groups[i].interface_name << "\"} " << missing(current.interfaces[i], current.sent) << '\n';
+
+    if (opts.measure_latency)
+    {
+        write_metric_family(text, "gapl_latency_nanoseconds", "summary", "Time from the send syscall to the kernel receiving the frame back.");
+        for (size_t i = 0; i < groups.size(); ++i)
+        {
+            const std::string labels = "interface=\"" + groups[i].interface_name + "\"";
+            for (double quantile: {0.5, 0.99, 0.999})
+                text << "gapl_latency_nanoseconds{" << labels << ",quantile=\"" << quantile << "\"} " << latency_percentile(totals[i], quantile * 100) << '\n';
+
+            text << "gapl_latency_nanoseconds_sum{" << labels << "} " << static_cast<uint64_t>(totals[i].sum) << '\n';
+            text << "gapl_latency_nanoseconds_count{" << labels << "} " << totals[i].total << '\n';
+        }
+    }
+
+    return text.str();
+}
+
+static int open_metrics_socket(int port)
+{
+    const int socket_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (socket_fd < 0)
+    {
+        perror("Failed to create the metrics socket");
+        exit(-1);
+    }
+
+    const int reuse = 1;
+    setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(socket_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+    {
+        perror(("Failed to bind the metrics socket to port " + std::to_string(port)).c_str());
+        exit(-1);
+    }
+
+    if (listen(socket_fd, 8) < 0)
+    {
+        perror("Failed to listen on the metrics socket");
+        exit(-1);
+    }
+
+    return socket_fd;
+}
+
+// Answers every scrape waiting on listen_fd with metrics. Whatever the request asks for, the answer
+// is the same, so it's read only so the client isn't reset before it has the response.
+static void serve_metrics(int listen_fd, const std::string& metrics)
+{
+    const std::string response =
+        "HTTP/1.0 200 OK\r\n"
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: " + std::to_string(metrics.size()) + "\r\n"
+        "Connection: close\r\n"
+        "\r\n" + metrics;
+
+    while (true)
+    {
+        const int client_fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client_fd < 0) return;
+
+        timeval timeout{};
+        timeout.tv_usec = SCRAPE_TIMEOUT_MS * 1000;
+        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        char request[4096];
+        recv(client_fd, request, sizeof(request), 0);
+
+        size_t written = 0;
+        while (written < response.size())
+        {
+            const ssize_t result = send(client_fd, response.data() + written, response.size() - written, MSG_NOSIGNAL);
+            if (result <= 0) break;
+            written += static_cast<size_t>(result);
+        }
+
+        close(client_fd);
+    }
+}
+
+void soak_thread(std::vector<receive_group>& groups, transmit_progress& progress, const options& opts, const std::atomic<bool>& finished)
+{
+    install_interrupt_handlers();
+
+    std::ofstream csv;
+    if (!opts.soak_metrics.empty())
+    {
+        csv.open(opts.soak_metrics);
+        if (!csv)
+        {
+            perror(("Failed to open " + opts.soak_metrics).c_str());
+            exit(-1);
+        }
+
+        write_csv_header(csv);
+    }
+
+    const int listen_fd = opts.prometheus_port > 0 ? open_metrics_socket(opts.prometheus_port) : -1;
+    if (listen_fd >= 0)
+        std::cout << "Serving soak metrics at http://127.0.0.1:" << opts.prometheus_port << "/metrics" << std::endl;
+
+    const auto interval_ns = static_cast<uint64_t>(opts.soak_interval_s * 1e9);
+    const uint64_t start_ns = monotonic_ns();
+    uint64_t next_report_ns = start_ns + interval_ns;
+
+    soak_snapshot previous = take_snapshot(groups, progress);
+    std::vector<latency_histogram> totals(groups.size(), create_latency_histogram());
+    std::vector<latency_histogram> latencies(groups.size(), create_latency_histogram());
+    std::string metrics = prometheus_metrics(groups, opts, previous, totals, start_ns);
+    bool stopping = false;
+
+    while (!finished.load(std::memory_order_acquire))
+    {
+        if (interrupted && !stopping)
+        {
+            stopping = true;
+            progress.stop.store(true, std::memory_order_relaxed);
+            std::cout << "Interrupted: stopping the transmitter and waiting for what's in flight (interrupt again to quit now)" << std::endl;
+        }
+
+        uint64_t now_ns = monotonic_ns();
+        if (now_ns >= next_report_ns)
+        {
+            const soak_snapshot current = take_snapshot(groups, progress);
+
+            // A worker hands its latencies over the next time it looks, so each report's latencies
+            // are the ones recorded up to about the report before it
+            for (size_t i = 0; i < groups.size(); ++i)
+            {
+                clear_latency_histogram(latencies[i]);
+                collect_latencies(groups[i], latencies[i]);
+                merge_latency_histogram(totals[i], latencies[i]);
+            }
+
+            print_report(groups, opts, previous, current, latencies, start_ns);
+            if (csv.is_open()) write_csv_rows(csv, groups, previous, current, latencies, start_ns);
+            metrics = prometheus_metrics(groups, opts, current, totals, start_ns);
+
+            previous = current;
+
+            // If the reporter fell behind, it picks up from now rather than reporting in a burst
+            next_report_ns += interval_ns;
+            if (next_report_ns <= now_ns) next_report_ns = now_ns + interval_ns;
+        }
+
+        now_ns = monotonic_ns();
+        const int wait_ms = static_cast<int>(std::min<uint64_t>((next_report_ns - std::min(next_report_ns, now_ns)) / 1000000, SOAK_POLL_MS));
+
+        if (listen_fd >= 0)
+        {
+            pollfd listener{.fd = listen_fd, .events = POLLIN, .revents = 0};
+            if (poll(&listener, 1, wait_ms) > 0) serve_metrics(listen_fd, metrics);
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(wait_ms));
+        }
+    }
+
+    std::cout << "Soak ran for " << format_elapsed(monotonic_ns() - start_ns) << std::endl;
+
+    if (listen_fd >= 0) close(listen_fd);
+    remove_interrupt_handlers();
+}
@@ -0,0 +1,29 @@
+#ifndef TRAFFIC_GENERATOR_SOAK_H
+#define TRAFFIC_GENERATOR_SOAK_H
+
+#include <atomic>
+#include <vector>
+
+#include "../util/options.h"
+#include "receiver.h"
+#include "transmitter.h"
+
+// A soak is load mode left running - for hours, against a board that's warming up - with live
+// counters reported every interval, rather than only a summary once it's over. Each report gives,
+// for the interval just gone, the rate sent, and for each receiving interface the rate received, how
+// much of it matched, what was corrupted, duplicated or reordered, and the latency percentiles, along
+// with how many of the frames sent so far are still missing.
+//
+// Reports go to standard output, and optionally to a CSV file (--soak-metrics, one row per receiving
+// interface per report, counting only that interval) and to a Prometheus text endpoint on 127.0.0.1
+// (--prometheus-port, whose counters and latency summary cover the whole run).
+//
+// SIGINT or SIGTERM stops the transmitter, after which the run finishes as any other load mode run
+// does: the receivers wait for what's still in flight, and the summary is printed. A second SIGINT
+// kills it outright.
+
+// Reports on groups and progress until finished is set, once the receivers are done. The signal
+// handlers are installed only for as long as it runs.
+void soak_thread(std::vector<receive_group>& groups, transmit_progress& progress, const options& opts, const std::atomic<bool>& finished);
+
+#endif //TRAFFIC_GENERATOR_SOAK_H
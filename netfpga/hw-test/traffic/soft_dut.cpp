@@ -0,0 +1,271 @@
+#include "soft_dut.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../network/fanout.h"
+#include "../network/filter.h"
+#include "../network/packet.h"
+#include "../network/socket.h"
+#include "../util/affinity.h"
+
+// Frames moved per recvmmsg/sendmmsg, and the largest frame handled (a jumbo frame)
+constexpr size_t SOFT_DUT_BATCH_SIZE = 64;
+constexpr size_t SOFT_DUT_FRAME_SIZE = 9216;
+
+// Lets the DUT ride out a burst, or a while off the CPU, without the kernel dropping anything
+constexpr int SOFT_DUT_RECEIVE_BUFFER = 32 << 20;
+
+// How often an idle DUT checks whether it's been stopped
+constexpr int SOFT_DUT_POLL_MS = 100;
+
+// Offsets into an untagged Ethernet frame carrying IPv4
+constexpr size_t IP_HEADER_OFFSET = 14;
+
+static bool echo_transform(const uint8_t* payload, size_t payload_size, std::vector<uint8_t>& output)
+{
+    output.assign(payload, payload + payload_size);
+    return true;
+}
+
+static bool reverse_transform(const uint8_t* payload, size_t payload_size, std::vector<uint8_t>& output)
+{
+    output.assign(payload, payload + payload_size);
+    std::reverse(output.begin(), output.end());
+    return true;
+}
+
+static bool invert_transform(const uint8_t* payload, size_t payload_size, std::vector<uint8_t>& output)
+{
+    output.resize(payload_size);
+    for (size_t i = 0; i < payload_size; ++i) output[i] = static_cast<uint8_t>(~payload[i]);
+    return true;
+}
+
+struct named_transform
+{
+    const char* name;
+    payload_transform transform;
+};
+
+// To add a transform, write a function with payload_transform's signature and list it here
+static const named_transform transforms[] =
+{
+    {"echo",    echo_transform},
+    {"reverse", reverse_transform},
+    {"invert",  invert_transform},
+};
+
+payload_transform find_payload_transform(const std::string& name)
+{
+    for (const named_transform& entry: transforms)
+        if (name == entry.name) return entry.transform;
+
+    return nullptr;
+}
+
+std::string payload_transform_names()
+{
+    std::string names;
+    for (const named_transform& entry: transforms)
+    {
+        if (!names.empty()) names += ", ";
+        names += entry.name;
+    }
+
+    return names;
+}
+
+void open_soft_dut(soft_dut& dut, const std::string& ingress_interface, const std::string& egress_interface, const std::string& transform_name)
+{
+    dut.ingress_interface = ingress_interface;
+    dut.egress_interface = egress_interface;
+    dut.transform = find_payload_transform(transform_name);
+    if (!dut.transform)
+    {
+        std::cerr << "Unknown soft DUT transform " << transform_name << " (expected one of " << payload_transform_names() << ")" << std::endl;
+        exit(-1);
+    }
+
+    // A plain socket rather than a TPACKET_V3 ring, since a ring only hands over a block once it's
+    // full or timed out, which would add milliseconds of latency at low rates
+    dut.receive_fd = create_receive_socket(ingress_interface, create_ipv4_filter());
+
+    // SO_RCVBUFFORCE goes past net.core.rmem_max, given CAP_NET_ADMIN
+    if (setsockopt(dut.receive_fd, SOL_SOCKET, SO_RCVBUFFORCE, &SOFT_DUT_RECEIVE_BUFFER, sizeof(SOFT_DUT_RECEIVE_BUFFER)) < 0)
+    {
+        perror("Failed to size soft DUT receive buffer");
+        exit(-1);
+    }
+
+    dut.transmit_fd = create_frame_transmit_socket(egress_interface);
+}
+
+// Builds the DUT's output for one frame into output. Returns false if the frame should be dropped.
+static bool process_frame(const soft_dut& dut, const uint8_t* frame, size_t frame_size, std::vector<uint8_t>& body, std::vector<uint8_t>& output)
+{
+    const uint8_t* payload = nullptr;
+    size_t payload_size = 0;
+    uint16_t src_port = 0;
+    uint16_t dst_port = 0;
+    if (!extract_padded_udp_payload(frame, frame_size, payload, payload_size, src_port, dst_port)) return false;
+
+    body.clear();
+    if (!dut.transform(payload, payload_size, body)) return false;
+
+    // The headers and padding go back out untouched, apart from the lengths and checksum
+    const size_t header_size = static_cast<size_t>(payload - frame);
+    if (header_size + body.size() > SOFT_DUT_FRAME_SIZE) return false;
+
+    output.assign(frame, frame + header_size);
+    output.insert(output.end(), body.begin(), body.end());
+
+    uint8_t* ip_header = output.data() + IP_HEADER_OFFSET;
+    const size_t ip_header_size = static_cast<size_t>(ip_header[0] & 0x0f) * 4;
+
+    const uint16_t ip_length = htons(static_cast<uint16_t>(output.size() - IP_HEADER_OFFSET));
+    std::memcpy(ip_header + 2, &ip_length, sizeof(ip_length));
+
+    ip_header[10] = 0;
+    ip_header[11] = 0;
+    const uint16_t ip_checksum = htons(checksum16(ip_header, ip_header_size));
+    std::memcpy(ip_header + 10, &ip_checksum, sizeof(ip_checksum));
+
+    // 0 = no checksum for IPv4, as the generator sends them
+    uint8_t* udp_header = ip_header + ip_header_size;
+    const uint16_t udp_length = htons(static_cast<uint16_t>(output.size() - IP_HEADER_OFFSET - ip_header_size));
+    std::memcpy(udp_header + 4, &udp_length, sizeof(udp_length));
+    udp_header[6] = 0;
+    udp_header[7] = 0;
+
+    return true;
+}
+
+static void send_frames(int socket_fd, mmsghdr* messages, size_t count)
+{
+    size_t sent = 0;
+    while (sent < count)
+    {
+        int ret = sendmmsg(socket_fd, messages + sent, count - sent, 0);
+        if (ret < 0)
+        {
+            // The egress queue is full - wait for it rather than dropping anything
+            if (errno == ENOBUFS || errno == EAGAIN || errno == EINTR)
+            {
+                sched_yield();
+                continue;
+            }
+
+            perror("Soft DUT failed to send frames");
+            exit(-1);
+        }
+
+        sent += static_cast<size_t>(ret);
+    }
+}
+
+void soft_dut_thread(soft_dut& dut, int cpu)
+{
+    pin_current_thread(cpu);
+
+    // Every buffer is allocated once, up front; the vectors keep their capacity from batch to batch
+    std::vector<uint8_t> receive_storage(SOFT_DUT_BATCH_SIZE * SOFT_DUT_FRAME_SIZE);
+    std::vector<iovec> receive_iovecs(SOFT_DUT_BATCH_SIZE);
+    std::vector<mmsghdr> receive_messages(SOFT_DUT_BATCH_SIZE);
+
+    std::vector<std::vector<uint8_t>> outputs(SOFT_DUT_BATCH_SIZE);
+    std::vector<iovec> send_iovecs(SOFT_DUT_BATCH_SIZE);
+    std::vector<mmsghdr> send_messages(SOFT_DUT_BATCH_SIZE);
+    std::vector<uint8_t> body;
+
+    for (size_t i = 0; i < SOFT_DUT_BATCH_SIZE; ++i)
+    {
+        outputs[i].reserve(SOFT_DUT_FRAME_SIZE);
+
+        receive_iovecs[i].iov_base = receive_storage.data() + i * SOFT_DUT_FRAME_SIZE;
+        receive_iovecs[i].iov_len = SOFT_DUT_FRAME_SIZE;
+        receive_messages[i].msg_hdr.msg_iov = &receive_iovecs[i];
+        receive_messages[i].msg_hdr.msg_iovlen = 1;
+
+        send_messages[i].msg_hdr.msg_iov = &send_iovecs[i];
+        send_messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    body.reserve(SOFT_DUT_FRAME_SIZE);
+
+    uint64_t forwarded = 0;
+    uint64_t dropped = 0;
+
+    while (!dut.stop.load(std::memory_order_relaxed))
+    {
+        pollfd poll_fd{};
+        poll_fd.fd = dut.receive_fd;
+        poll_fd.events = POLLIN;
+
+        int ret = poll(&poll_fd, 1, SOFT_DUT_POLL_MS);
+        if (ret < 0 && errno != EINTR)
+        {
+            perror("Soft DUT failed to poll");
+            exit(-1);
+        }
+        if (ret <= 0) continue;
+
+        int received = recvmmsg(dut.receive_fd, receive_messages.data(), SOFT_DUT_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+        if (received < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR) continue;
+
+            perror("Soft DUT failed to receive frames");
+            exit(-1);
+        }
+
+        size_t queued = 0;
+        for (int i = 0; i < received; ++i)
+        {
+            // A truncated frame can't be passed on faithfully
+            const mmsghdr& message = receive_messages[i];
+            if (message.msg_hdr.msg_flags & MSG_TRUNC)
+            {
+                ++dropped;
+                continue;
+            }
+
+            const uint8_t* frame = static_cast<const uint8_t*>(receive_iovecs[i].iov_base);
+            if (!process_frame(dut, frame, message.msg_len, body, outputs[queued]))
+            {
+                ++dropped;
+                continue;
+            }
+
+            send_iovecs[queued].iov_base = outputs[queued].data();
+            send_iovecs[queued].iov_len = outputs[queued].size();
+            ++queued;
+        }
+
+        if (queued > 0) send_frames(dut.transmit_fd, send_messages.data(), queued);
+
+        forwarded += queued;
+        dut.forwarded.store(forwarded, std::memory_order_relaxed);
+        dut.dropped.store(dropped, std::memory_order_relaxed);
+    }
+}
+
+void close_soft_dut(soft_dut& dut)
+{
+    std::cout << "Soft DUT (" << dut.ingress_interface << " -> " << dut.egress_interface << "): "
+        << "forwarded " << dut.forwarded.load(std::memory_order_relaxed) << " frames, "
+        << "dropped " << dut.dropped.load(std::memory_order_relaxed) << ", "
+        << "and the kernel dropped " << get_receive_drops(dut.receive_fd) << " before it saw them" << std::endl;
+
+    close(dut.receive_fd);
+    close(dut.transmit_fd);
+}
@@ -0,0 +1,49 @@
+#ifndef TRAFFIC_GENERATOR_SOFT_DUT_H
+#define TRAFFIC_GENERATOR_SOFT_DUT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A software stand-in for the packet processor, so the generator can be run end to end - and its own
+// pps/latency ceiling measured - without the board. It behaves like the hardware: frames arriving on
+// the ingress interface that are padded UDP have their body run through a transform, and go out of
+// the egress interface with the headers and padding (stamp and all) untouched. Anything else is
+// dropped, as is a frame the transform produces no output for.
+
+// Transforms the body of one padded UDP packet into output (empty on entry). Returns false to drop
+// the packet.
+typedef bool (*payload_transform)(const uint8_t* payload, size_t payload_size, std::vector<uint8_t>& output);
+
+// nullptr if there's no transform called name
+payload_transform find_payload_transform(const std::string& name);
+
+// Every transform's name, for the help text
+std::string payload_transform_names();
+
+struct soft_dut
+{
+    std::string ingress_interface;
+    std::string egress_interface;
+    payload_transform transform;
+
+    int receive_fd;
+    int transmit_fd;
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> forwarded{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+// Sets dut up in place - it holds atomics, so it can't be returned
+void open_soft_dut(soft_dut& dut, const std::string& ingress_interface, const std::string& egress_interface, const std::string& transform_name);
+
+// Forwards frames until dut.stop is set, pinned to cpu (if it's not -1)
+void soft_dut_thread(soft_dut& dut, int cpu);
+
+// Reports what the DUT forwarded and closes its sockets, once its thread has been joined
+void close_soft_dut(soft_dut& dut);
+
+#endif //TRAFFIC_GENERATOR_SOFT_DUT_H
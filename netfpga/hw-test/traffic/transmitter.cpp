@@ -0,0 +1,356 @@
+#include "transmitter.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "../network/packet.h"
+#include "../network/packet_template.h"
+#include "../network/stamp.h"
+#include "../network/tx_batch.h"
+#include "../network/uring.h"
+#include "../network/xdp.h"
+#include "../util/affinity.h"
+#include "../util/hex.h"
+#include "../util/pacer.h"
+#include "../util/pcap.h"
+#include "profile.h"
+
+// Largest packet we expect to send, for sizing the pacer's bucket when pacing in Gbps
+constexpr size_t LARGEST_IP_PACKET = 1500;
+
+// Packets per io_uring submission, unless --batch-size says otherwise
+constexpr size_t DEFAULT_URING_BATCH_SIZE = 64;
+
+// Where prebuilt packets go: a batch of sendmmsg calls on a raw IP socket, an io_uring writing to
+// one, or an AF_XDP socket
+struct transmit_target
+{
+    bool use_xdp;
+    bool use_uring;
+    tx_batch batch;
+    uring_tx uring;
+    xdp_socket xsk;
+};
+
+// packets has to be complete, since io_uring registers it
+static transmit_target create_transmit_target(int socket_fd, const std::string& interface_name, const options& opts, const packet_set& packets)
+{
+    if (opts.use_xdp)
+        return transmit_target{.use_xdp = true, .use_uring = false, .batch = {}, .uring = {}, .xsk = create_xdp_socket(interface_name, opts.xdp_queue, opts.xdp_settings)};
+
+    if (opts.use_uring)
+    {
+        const size_t batch_size = opts.batch_size > 0 ? opts.batch_size : DEFAULT_URING_BATCH_SIZE;
+        return transmit_target{.use_xdp = false, .use_uring = true, .batch = {}, .uring = create_uring_tx(socket_fd, opts.dest_ip_addr, packets, batch_size, uring_config{}), .xsk = {}};
+    }
+
+    return transmit_target{.use_xdp = false, .use_uring = false, .batch = create_tx_batch(socket_fd, opts.dest_ip_addr, std::max<size_t>(opts.batch_size, 1)), .uring = {}, .xsk = {}};
+}
+
+// Most packets handed over at once, and so the granularity of the load pacing
+static size_t target_batch_size(const transmit_target& target)
+{
+    if (target.use_xdp) return target.xsk.batch_size;
+    if (target.use_uring) return target.uring.batch_size;
+    return target.batch.messages.size();
+}
+
+static void send_to_target(transmit_target& target, packet_set& packets, size_t first, size_t count)
+{
+    if (target.use_xdp)
+        xdp_send_frames(target.xsk, packets, first, count);
+    else if (target.use_uring)
+        uring_send_packets(target.uring, packets, first, count);
+    else
+        send_packets(target.batch, packets, first, count);
+}
+
+// Replays the inputs in a loop at the configured rate, until the configured count or duration runs
+// out. Nothing is logged per packet - at these rates that would be the bottleneck.
+static void send_load(
+    const std::string& interface_name,
+    transmit_target& target,
+    packet_set& packets,
+    const options& opts,
+    transmit_progress& progress
+) {
+    // Gbps pacing charges each packet its bits on the wire, pps pacing a flat one token
+    std::vector<double> packet_costs(packet_count(packets), 1.0);
+    double bucket_size = static_cast<double>(opts.burst);
+
+    if (opts.rate_gbps > 0)
+    {
+        double largest_cost = 0;
+        for (size_t i = 0; i < packet_costs.size(); ++i)
+        {
+            packet_costs[i] = static_cast<double>(ethernet_wire_size(packets.sizes[i]) * 8);
+            largest_cost = std::max(largest_cost, packet_costs[i]);
+        }
+        bucket_size *= largest_cost;
+    }
+
+    const double rate = opts.rate_gbps > 0 ? opts.rate_gbps * 1e9 : opts.rate_pps;
+    pacer pacer = create_pacer(rate, bucket_size);
+
+    const uint64_t limit = opts.packet_count > 0 ? opts.packet_count : UINT64_MAX;
+    const uint64_t start_ns = monotonic_ns();
+    const uint64_t end_ns = opts.duration_s > 0 ? start_ns + static_cast<uint64_t>(opts.duration_s * 1e9) : UINT64_MAX;
+
+    uint64_t sent = 0;
+    uint64_t wire_bytes = 0;
+    while (sent < limit && monotonic_ns() < end_ns && !progress.stop.load(std::memory_order_relaxed))
+    {
+        const size_t count = static_cast<size_t>(std::min<uint64_t>(target_batch_size(target), limit - sent));
+
+        double cost = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const size_t index = (sent + i) % packet_costs.size();
+            cost += packet_costs[index];
+            wire_bytes += ethernet_wire_size(packets.sizes[index]);
+        }
+
+        pacer_wait(pacer, cost);
+        send_to_target(target, packets, sent % packet_count(packets), count);
+
+        sent += count;
+        progress.packets_sent.store(sent, std::memory_order_relaxed);
+        progress.wire_bytes.store(wire_bytes, std::memory_order_relaxed);
+    }
+
+    const uint64_t elapsed_ns = monotonic_ns() - start_ns;
+    progress.elapsed_ns.store(elapsed_ns, std::memory_order_relaxed);
+
+    const double elapsed_s = static_cast<double>(elapsed_ns) / 1e9;
+    std::cout << interface_name << ": "
+        << "Sent " << sent << " packets in " << elapsed_s << " s ("
+        << static_cast<double>(sent) / elapsed_s << " pps, "
+        << static_cast<double>(wire_bytes) * 8 / elapsed_s / 1e9 << " Gbps on the wire)" << std::endl;
+}
+
+// Replays the IPv4 packets of a trace straight out of the mapped file - nothing is copied or built.
+// Each packet goes out either as soon as the pacer allows, or (with --pcap-timing) at the same offset
+// from the start of the replay as it was captured at from the start of the trace.
+static void send_pcap(
+    const std::string& interface_name,
+    tx_batch& batch,
+    const options& opts,
+    transmit_progress& progress
+) {
+    pcap_reader reader = open_pcap(opts.pcap_input);
+
+    const double rate = opts.rate_gbps > 0 ? opts.rate_gbps * 1e9 : opts.rate_pps;
+    const double largest_cost = opts.rate_gbps > 0 ? static_cast<double>(ethernet_wire_size(LARGEST_IP_PACKET) * 8) : 1.0;
+    pacer pacer = create_pacer(rate, static_cast<double>(opts.burst) * largest_cost);
+
+    // Without a count or duration, the trace is replayed once
+    const bool loop = opts.packet_count > 0 || opts.duration_s > 0;
+    const uint64_t limit = opts.packet_count > 0 ? opts.packet_count : UINT64_MAX;
+    const uint64_t start_ns = monotonic_ns();
+    const uint64_t end_ns = opts.duration_s > 0 ? start_ns + static_cast<uint64_t>(opts.duration_s * 1e9) : UINT64_MAX;
+
+    uint64_t sent = 0;
+    uint64_t skipped = 0;
+    uint64_t wire_bytes = 0;
+
+    size_t queued = 0;
+    double queued_cost = 0;
+
+    // Trace time of the first packet, and how far the replay clock has moved on over earlier loops
+    bool any_packets = false;
+    uint64_t first_timestamp_ns = 0;
+    uint64_t last_timestamp_ns = 0;
+    uint64_t loop_offset_ns = 0;
+
+    auto flush = [&]()
+    {
+        if (queued == 0) return;
+
+        pacer_wait(pacer, queued_cost);
+        send_batch(batch, queued);
+
+        sent += queued;
+        progress.packets_sent.store(sent, std::memory_order_relaxed);
+        progress.wire_bytes.store(wire_bytes, std::memory_order_relaxed);
+        queued = 0;
+        queued_cost = 0;
+    };
+
+    while (sent + queued < limit && monotonic_ns() < end_ns && !progress.stop.load(std::memory_order_relaxed))
+    {
+        pcap_record record{};
+        if (!next_pcap_record(reader, record))
+        {
+            if (!loop || !any_packets) break;
+
+            loop_offset_ns += last_timestamp_ns - first_timestamp_ns;
+            rewind_pcap(reader);
+            continue;
+        }
+
+        const uint8_t* ip_packet = nullptr;
+        size_t ip_packet_size = 0;
+        if (!pcap_record_ipv4(record, ip_packet, ip_packet_size))
+        {
+            ++skipped;
+            continue;
+        }
+
+        if (!any_packets) first_timestamp_ns = record.timestamp_ns;
+        any_packets = true;
+        last_timestamp_ns = record.timestamp_ns;
+
+        if (opts.pcap_timing)
+        {
+            // Whatever's queued is due already; send it before waiting for this one
+            const uint64_t trace_offset_ns = record.timestamp_ns > first_timestamp_ns ? record.timestamp_ns - first_timestamp_ns : 0;
+            const uint64_t deadline_ns = start_ns + loop_offset_ns + trace_offset_ns;
+
+            if (deadline_ns > monotonic_ns())
+            {
+                flush();
+                wait_until_ns(deadline_ns);
+            }
+        }
+
+        batch.iovecs[queued].iov_base = const_cast<uint8_t*>(ip_packet);
+        batch.iovecs[queued].iov_len = ip_packet_size;
+        ++queued;
+
+        queued_cost += opts.rate_gbps > 0 ? static_cast<double>(ethernet_wire_size(ip_packet_size) * 8) : 1.0;
+        wire_bytes += ethernet_wire_size(ip_packet_size);
+
+        if (queued == batch.messages.size()) flush();
+    }
+
+    flush();
+    close_pcap(reader);
+
+    const double elapsed_s = static_cast<double>(monotonic_ns() - start_ns) / 1e9;
+    std::cout << interface_name << ": "
+        << "Replayed " << sent << " packets from " << opts.pcap_input << " in " << elapsed_s << " s ("
+        << static_cast<double>(sent) / elapsed_s << " pps, "
+        << static_cast<double>(wire_bytes) * 8 / elapsed_s / 1e9 << " Gbps on the wire), "
+        << "skipped " << skipped << " records that weren't IPv4" << std::endl;
+}
+
+void transmit_thread(
+    int socket_fd,
+    const std::string interface_name,
+    const options& opts,
+    transmit_progress& progress,
+    log_queue& log
+) {
+    pin_current_thread(opts.tx_cpu);
+
+    char buffer[65536];
+
+    if (!opts.pcap_input.empty())
+    {
+        tx_batch batch = create_tx_batch(socket_fd, opts.dest_ip_addr, std::max<size_t>(opts.batch_size, 1));
+        send_pcap(interface_name, batch, opts, progress);
+
+        progress.done.store(true, std::memory_order_release);
+        return;
+    }
+
+    const bool load_mode = is_load_mode(opts);
+
+    // With batching (which load mode, AF_XDP and io_uring always use), every packet is built up front,
+    // and only then sent
+    const bool batched = load_mode || opts.batch_size > 0 || opts.use_xdp || opts.use_uring;
+    packet_set packets;
+    uint64_t sequence = 0;
+    uint16_t next_id = 0;
+
+    // Every packet shares one flow, so its headers are built once
+    const packet_template packet_template = create_packet_template(opts.src_ip_addr, opts.dest_ip_addr, opts.port, opts.port);
+
+    if (uses_profile(opts)) build_profile_packets(opts.profile, packets, interface_name);
+
+    for (size_t index = 0; index < opts.inputs.size(); ++index)
+    {
+        const std::string& msg = opts.inputs[index];
+        std::vector<uint8_t> hex_data = string_to_hex(msg);
+
+        const char* data = reinterpret_cast<const char*>(hex_data.data());
+        const size_t data_size = hex_data.size();
+
+        // Create the packet - batched packets straight into the set, rather than copying them in after
+        char* packet = batched ? add_packet(packets, PADDED_UDP_HEADER_SIZE + data_size) : buffer;
+        const size_t packet_size = write_padded_udp_packet(packet_template, packet, data, data_size, next_id++);
+
+        // Send the packet - stamped just before, so the stamp's time is as close to the send as it can be
+        const bool stamped = !batched && stamp_packets(opts);
+        if (!batched)
+        {
+            if (stamped) write_stamp(buffer, packet_size, sequence, realtime_ns());
+            send_packet(socket_fd, buffer, packet_size, opts.dest_ip_addr, opts.port);
+            progress.packets_sent.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // A batched packet is only stamped once it's sent, below, so it has no sequence number yet
+        if (log_wants_frame(log, false))
+        {
+            frame_record record{};
+            record.event = log_event::sent;
+            record.time_ns = realtime_ns();
+            record.index = index;
+            record.frame_size = static_cast<uint32_t>(packet_size);
+            record.payload_offset = static_cast<uint32_t>(PADDED_UDP_HEADER_SIZE);
+            record.payload_size = static_cast<uint32_t>(data_size);
+            record.has_sequence = stamped;
+            record.sequence = sequence;
+
+            log_frame(log, record, log_wants_bytes(log, false) ? reinterpret_cast<const uint8_t*>(packet) : nullptr, nullptr, 0);
+        }
+
+        if (stamped) ++sequence;
+    }
+
+    if (packet_count(packets) > 0)
+    {
+        transmit_target target = create_transmit_target(socket_fd, interface_name, opts, packets);
+
+        if (opts.use_xdp)
+        {
+            set_xdp_destination(target.xsk, interface_name, opts.dest_mac_addr);
+            target.xsk.stamp = stamp_packets(opts);
+
+            std::cout << interface_name << ": " << "Sending through AF_XDP queue " << target.xsk.queue
+                << " in " << (target.xsk.zero_copy ? "zero-copy" : "copy") << " mode" << std::endl;
+        }
+        else if (opts.use_uring)
+        {
+            target.uring.stamp = stamp_packets(opts);
+
+            std::cout << interface_name << ": " << "Sending through io_uring, " << target.uring.batch_size << " packets per submission"
+                << (target.uring.registered ? " out of registered buffers" : "") << std::endl;
+        }
+        else
+        {
+            target.batch.stamp = stamp_packets(opts);
+        }
+
+        if (load_mode)
+        {
+            send_load(interface_name, target, packets, opts, progress);
+        }
+        else
+        {
+            send_to_target(target, packets, 0, packet_count(packets));
+            progress.packets_sent.store(packet_count(packets), std::memory_order_relaxed);
+        }
+
+        if (opts.use_xdp)
+        {
+            xdp_finish_sending(target.xsk);
+            destroy_xdp_socket(target.xsk);
+        }
+
+        if (opts.use_uring) destroy_uring_tx(target.uring);
+    }
+
+    progress.done.store(true, std::memory_order_release);
+}
@@ -0,0 +1,31 @@
+#ifndef TRAFFIC_GENERATOR_TRANSMITTER_H
+#define TRAFFIC_GENERATOR_TRANSMITTER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "../util/log.h"
+#include "../util/options.h"
+
+// Shared between the transmitter and the receivers, so that in load mode the receivers know how
+// many frames they should have seen, and when to stop waiting for more
+struct transmit_progress
+{
+    std::atomic<uint64_t> packets_sent{0};
+    std::atomic<bool> done{false};
+
+    // Filled in by load mode: bytes put on the wire so far (see ethernet_wire_size), and once it's
+    // finished, how long sending took
+    std::atomic<uint64_t> wire_bytes{0};
+    std::atomic<uint64_t> elapsed_ns{0};
+
+    // Set to end load mode early, at the next batch - how a soak is stopped
+    std::atomic<bool> stop{false};
+};
+
+// Sends every input once (or, in load mode, replays them at the configured rate) on socket_fd - or,
+// with --xdp, on an AF_XDP socket of its own, in which case socket_fd isn't used
+void transmit_thread(int socket_fd, const std::string interface_name, const options& opts, transmit_progress& progress, log_queue& log);
+
+#endif //TRAFFIC_GENERATOR_TRANSMITTER_H
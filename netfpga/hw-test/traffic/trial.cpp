@@ -0,0 +1,85 @@
+#include "trial.h"
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "../network/socket.h"
+#include "soak.h"
+#include "transmitter.h"
+
+trial_result run_trial(const options& opts, logger& log)
+{
+    transmit_progress progress;
+
+    // Every group has to exist before any worker starts, since the workers hold references into them
+    std::cout << "Creating receivers" << std::endl;
+    std::vector<receive_group> groups;
+    for (const std::string& interface_name: opts.receive_interfaces)
+    {
+        std::cout << "  Creating " << opts.rx_threads << " receiver(s) for " << interface_name << std::endl;
+        groups.push_back(create_receive_group(interface_name, opts, log));
+        std::cout << "    Done" << std::endl;
+    }
+
+    std::cout << "Starting receiver threads" << std::endl;
+    std::vector<std::thread> receivers;
+    for (receive_group& group: groups)
+    {
+        for (size_t worker = 0; worker < group.sources.size(); ++worker)
+        {
+            const int cpu = opts.rx_cpus.empty() ? -1 : opts.rx_cpus[receivers.size() % opts.rx_cpus.size()];
+            receivers.emplace_back(receive_worker, std::ref(group), worker, cpu, std::cref(opts), std::cref(progress));
+        }
+    }
+
+    std::cout << "Starting transmit thread" << std::endl;
+    std::string interface_name = opts.transmit_interface;
+    std::cout << "  Creating transmitter for " << interface_name << std::endl;
+    const int socket_fd = opts.use_xdp ? -1 : create_transmit_socket(interface_name);
+    std::thread transmitter
+    (
+        transmit_thread,
+        socket_fd,
+        interface_name,
+        std::cref(opts),
+        std::ref(progress),
+        std::ref(get_log_queue(log, interface_name))
+    );
+    std::cout << "    Done" << std::endl;
+
+    std::atomic<bool> receivers_finished{false};
+    std::thread reporter;
+    if (opts.soak) reporter = std::thread(soak_thread, std::ref(groups), std::ref(progress), std::cref(opts), std::cref(receivers_finished));
+
+    for (std::thread& receiver: receivers) receiver.join();
+    transmitter.join();
+
+    receivers_finished.store(true, std::memory_order_release);
+    if (reporter.joinable()) reporter.join();
+    if (socket_fd >= 0) close(socket_fd);
+
+    // Whatever the threads logged goes out before the results
+    flush_logger(log);
+
+    trial_result result{};
+    result.sent = progress.packets_sent.load(std::memory_order_relaxed);
+    result.wire_bytes = progress.wire_bytes.load(std::memory_order_relaxed);
+    result.elapsed_ns = progress.elapsed_ns.load(std::memory_order_relaxed);
+
+    for (receive_group& group: groups)
+        result.receivers.push_back(finish_receive_group(group, opts, progress));
+
+    return result;
+}
+
+bool trial_passed(const trial_result& result)
+{
+    for (const receive_result& receiver: result.receivers)
+        if (!receive_passed(receiver)) return false;
+
+    return true;
+}
@@ -0,0 +1,29 @@
+#ifndef TRAFFIC_GENERATOR_TRIAL_H
+#define TRAFFIC_GENERATOR_TRIAL_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../util/log.h"
+#include "../util/options.h"
+#include "receiver.h"
+
+// One run of the generator: receivers on every receiving interface, and the transmitter, until
+// everything sent has come back or the receivers give up waiting
+struct trial_result
+{
+    uint64_t sent;
+    std::vector<receive_result> receivers;
+
+    // Only filled in in load mode
+    uint64_t wire_bytes;
+    uint64_t elapsed_ns;
+};
+
+// Every thread logs its frames through log
+trial_result run_trial(const options& opts, logger& log);
+
+// Whether every receiving interface passed (see receive_passed)
+bool trial_passed(const trial_result& result);
+
+#endif //TRAFFIC_GENERATOR_TRIAL_H
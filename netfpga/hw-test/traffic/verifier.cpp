@@ -0,0 +1,211 @@
+#include "verifier.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "../util/hex.h"
+
+// FNV-1a; payloads are short, and this only has to tell the expected outputs apart
+static uint64_t hash_payload(const uint8_t* payload, size_t payload_len)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < payload_len; ++i)
+    {
+        hash ^= payload[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    // 0 marks an empty slot
+    return hash == 0 ? 1 : hash;
+}
+
+expected_set create_expected_set(const std::vector<std::string>& hex_outputs)
+{
+    expected_set expected{};
+
+    for (const auto& hex_output : hex_outputs)
+        expected.messages.push_back(string_to_hex(hex_output));
+
+    expected.copies.assign(expected.messages.size(), 0);
+
+    size_t slots = 16;
+    while (slots < expected.messages.size() * 2) slots *= 2;
+
+    expected.slot_hashes.assign(slots, 0);
+    expected.slot_indices.assign(slots, 0);
+    expected.slot_mask = slots - 1;
+
+    for (size_t i = 0; i < expected.messages.size(); ++i)
+    {
+        const std::vector<uint8_t>& message = expected.messages[i];
+        const uint64_t hash = hash_payload(message.data(), message.size());
+
+        // The same output can be expected for more than one input; the first copy stands for them all
+        const long first = find_expected(expected, message.data(), message.size());
+        if (first >= 0)
+        {
+            ++expected.copies[first];
+            continue;
+        }
+
+        expected.copies[i] = 1;
+
+        size_t slot = hash & expected.slot_mask;
+        while (expected.slot_hashes[slot] != 0) slot = (slot + 1) & expected.slot_mask;
+
+        expected.slot_hashes[slot] = hash;
+        expected.slot_indices[slot] = static_cast<uint32_t>(i);
+    }
+
+    return expected;
+}
+
+long find_expected(const expected_set& expected, const uint8_t* payload, size_t payload_len)
+{
+    const uint64_t hash = hash_payload(payload, payload_len);
+
+    for (size_t slot = hash & expected.slot_mask; expected.slot_hashes[slot] != 0; slot = (slot + 1) & expected.slot_mask)
+    {
+        if (expected.slot_hashes[slot] != hash) continue;
+
+        const uint32_t index = expected.slot_indices[slot];
+        if (matches_expected(expected, index, payload, payload_len)) return index;
+    }
+
+    return -1;
+}
+
+bool matches_expected(const expected_set& expected, size_t index, const uint8_t* payload, size_t payload_len)
+{
+    const std::vector<uint8_t>& message = expected.messages[index];
+    return payload_len == message.size() && std::memcmp(payload, message.data(), payload_len) == 0;
+}
+
+expected_claims create_expected_claims(const expected_set& expected)
+{
+    expected_claims claims{};
+    claims.claimed = std::make_unique<std::atomic<uint32_t>[]>(expected.messages.size());
+
+    return claims;
+}
+
+bool claim_expected(expected_claims& claims, const expected_set& expected, size_t index)
+{
+    std::atomic<uint32_t>& claimed = claims.claimed[index];
+
+    // Checked first, so that extra copies, however many, never push the count past what's expected
+    uint32_t current = claimed.load(std::memory_order_relaxed);
+    while (current < expected.copies[index])
+    {
+        if (claimed.compare_exchange_weak(current, current + 1, std::memory_order_relaxed)) return true;
+    }
+
+    return false;
+}
+
+sequence_tracker create_sequence_tracker(uint64_t limit, size_t window_words)
+{
+    return sequence_tracker
+    {
+        .seen = {},
+        .highest = 0,
+        .any_seen = false,
+        .limit = limit,
+        .window_words = window_words,
+        .base_word = 0,
+        .retired = 0
+    };
+}
+
+// Retires words from the bottom of the bitmap to make room for word. Normally that's a window's worth
+// once the bitmap has grown to two windows, so it never grows past that, and the words are only ever
+// moved once per window. After a gap longer than a window (a burst of loss, say), everything up to a
+// window below word goes at once. Only the bits that were set are kept count of, so the sequence
+// numbers that were never seen come out as lost when the trackers are merged.
+static void slide_window(sequence_tracker& tracker, uint64_t word)
+{
+    if (word - tracker.base_word < 2 * tracker.window_words) return;
+
+    const uint64_t base_word = std::max(tracker.base_word + tracker.window_words, word + 1 - tracker.window_words);
+    const size_t retiring = static_cast<size_t>(std::min<uint64_t>(base_word - tracker.base_word, tracker.seen.size()));
+    for (size_t i = 0; i < retiring; ++i)
+        tracker.retired += __builtin_popcountll(tracker.seen[i]);
+
+    tracker.seen.erase(tracker.seen.begin(), tracker.seen.begin() + static_cast<std::ptrdiff_t>(retiring));
+    tracker.base_word = base_word;
+}
+
+sequence_status track_sequence(sequence_tracker& tracker, uint64_t sequence)
+{
+    if (sequence >= tracker.limit) return sequence_status::out_of_range;
+
+    const uint64_t absolute_word = sequence / 64;
+    const uint64_t bit = 1ull << (sequence % 64);
+
+    if (tracker.window_words > 0)
+    {
+        if (absolute_word < tracker.base_word) return sequence_status::reordered;
+        slide_window(tracker, absolute_word);
+    }
+
+    const size_t word = static_cast<size_t>(absolute_word - tracker.base_word);
+
+    // Grow geometrically, so a long run only reallocates a handful of times - but never past the two
+    // windows slide_window keeps room for
+    if (word >= tracker.seen.size())
+    {
+        size_t words = std::max(word + 1, tracker.seen.size() * 2);
+        if (tracker.window_words > 0) words = std::min(words, 2 * tracker.window_words);
+
+        tracker.seen.resize(words, 0);
+    }
+
+    if (tracker.seen[word] & bit) return sequence_status::duplicate;
+    tracker.seen[word] |= bit;
+
+    const bool late = tracker.any_seen && sequence < tracker.highest;
+    tracker.highest = std::max(tracker.highest, sequence);
+    tracker.any_seen = true;
+
+    return late ? sequence_status::reordered : sequence_status::in_order;
+}
+
+sequence_totals merge_sequence_trackers(const std::vector<sequence_tracker>& trackers, uint64_t sent)
+{
+    sequence_totals totals{};
+
+    // The trackers' windows may have slid to different places; seen starts at the earliest of them
+    uint64_t first_word = UINT64_MAX;
+    uint64_t end_word = 0;
+    for (const auto& tracker : trackers)
+    {
+        first_word = std::min(first_word, tracker.base_word);
+        end_word = std::max(end_word, tracker.base_word + tracker.seen.size());
+        totals.unique += tracker.retired;
+    }
+
+    if (first_word > end_word) first_word = end_word;
+    const size_t words = static_cast<size_t>(end_word - first_word);
+
+    std::vector<uint64_t> seen(words, 0);
+    for (const auto& tracker : trackers)
+    {
+        const size_t offset = static_cast<size_t>(tracker.base_word - first_word);
+        for (size_t i = 0; i < tracker.seen.size(); ++i)
+        {
+            totals.duplicates += __builtin_popcountll(seen[offset + i] & tracker.seen[i]);
+            seen[offset + i] |= tracker.seen[i];
+        }
+    }
+
+    // Only sequence numbers the transmitter actually got to count towards what arrived
+    const uint64_t sent_words = sent / 64;
+    const size_t full_words = sent_words > first_word ? static_cast<size_t>(std::min<uint64_t>(sent_words - first_word, words)) : 0;
+    for (size_t i = 0; i < full_words; ++i)
+        totals.unique += __builtin_popcountll(seen[i]);
+
+    if (sent_words >= first_word && full_words < words && sent % 64 != 0)
+        totals.unique += __builtin_popcountll(seen[full_words] & ((1ull << (sent % 64)) - 1));
+
+    return totals;
+}
@@ -0,0 +1,96 @@
+#ifndef TRAFFIC_GENERATOR_VERIFIER_H
+#define TRAFFIC_GENERATOR_VERIFIER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The expected outputs, plus an open-addressing table from payload hash to output, so an unstamped
+// frame can be matched against every output at once instead of relying on it arriving in order.
+// Built once and only read afterwards, so all the receive workers share it.
+struct expected_set
+{
+    std::vector<std::vector<uint8_t>> messages;
+
+    // The table only holds the first copy of an output expected more than once; this is how many
+    // copies there are, at the first copy's index (and 0 at the others)
+    std::vector<uint32_t> copies;
+
+    // Linear probing over a power-of-two table at most half full; a hash of 0 marks an empty slot
+    std::vector<uint64_t> slot_hashes;
+    std::vector<uint32_t> slot_indices;
+    size_t slot_mask;
+};
+
+expected_set create_expected_set(const std::vector<std::string>& hex_outputs);
+
+// The index of an expected message equal to payload, or -1 if there's none
+long find_expected(const expected_set& expected, const uint8_t* payload, size_t payload_len);
+
+bool matches_expected(const expected_set& expected, size_t index, const uint8_t* payload, size_t payload_len);
+
+// How many copies of each expected output unstamped frames have matched so far. Without a stamp, a
+// frame that matches an output says nothing about which input it came from, so each output can only
+// be matched as many times as it's expected: a DUT sending back one valid output for every input
+// matches it once, and every other copy is an extra. Shared by all the workers in a group.
+struct expected_claims
+{
+    std::unique_ptr<std::atomic<uint32_t>[]> claimed;
+};
+
+expected_claims create_expected_claims(const expected_set& expected);
+
+// Claims a copy of the output find_expected returned. Returns false if every copy has already been
+// claimed, in which case the frame is one more than the DUT should have sent.
+bool claim_expected(expected_claims& claims, const expected_set& expected, size_t index);
+
+// Which sequence numbers one worker has seen, as a bitmap that grows as they arrive, so that it can
+// tell a frame that's arrived twice from one that's arrived late.
+//
+// A run with no end (a soak) can't keep a bit for every frame it's ever sent, so its trackers only
+// keep a window of the most recent sequence numbers: the words that fall out of the window are
+// retired, their bits only counted. A frame older than the window is counted as reordered (and,
+// since it's too late to be counted as seen, as lost). One further ahead moves the window up to it,
+// however far that is, so a long burst of loss only costs the frames actually lost.
+struct sequence_tracker
+{
+    std::vector<uint64_t> seen;
+    uint64_t highest;
+    bool any_seen;
+
+    // Sequence numbers from here up can't have been sent - most likely the stamp itself was corrupted.
+    // A soak with no end moves it up as the transmitter goes.
+    uint64_t limit;
+
+    // In words of 64 sequence numbers; 0 keeps every one. seen[0] covers base_word.
+    size_t window_words;
+    uint64_t base_word;
+    uint64_t retired;
+};
+
+enum class sequence_status
+{
+    in_order,
+    reordered,
+    duplicate,
+    out_of_range,
+};
+
+sequence_tracker create_sequence_tracker(uint64_t limit, size_t window_words = 0);
+sequence_status track_sequence(sequence_tracker& tracker, uint64_t sequence);
+
+struct sequence_totals
+{
+    uint64_t unique;      // distinct sequence numbers below sent seen by any worker
+    uint64_t duplicates;  // frames one worker saw whose sequence number another worker had already seen
+};
+
+// Combines every worker's tracker. A frame fanned out to two different workers is only a duplicate
+// in hindsight, since neither worker saw the other's copy - and once the copies have been retired
+// from their windows, not even then.
+sequence_totals merge_sequence_trackers(const std::vector<sequence_tracker>& trackers, uint64_t sent);
+
+#endif //TRAFFIC_GENERATOR_VERIFIER_H
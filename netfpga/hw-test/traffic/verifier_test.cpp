@@ -0,0 +1,151 @@
+// Checks of the receive side's bookkeeping (traffic/verifier.h) that don't need a network: how
+// unstamped frames are matched against the expected outputs, and how the sequence trackers count
+// loss. Built and run by `make check`.
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "verifier.h"
+#include "../util/hex.h"
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            std::cout << __FILE__ << ":" << __LINE__ << ": check failed: " << #condition << std::endl; \
+            ++failures; \
+        } \
+    } while (0)
+
+// What receive_worker makes of an unstamped frame: a match, an extra copy of a valid output, or
+// nothing that was expected at all
+enum class unstamped_verdict { match, extra, mismatch };
+
+static unstamped_verdict receive_unstamped(const expected_set& expected, expected_claims& claims, const std::string& hex_payload)
+{
+    const std::vector<uint8_t> payload = string_to_hex(hex_payload);
+
+    const long index = find_expected(expected, payload.data(), payload.size());
+    if (index < 0) return unstamped_verdict::mismatch;
+
+    return claim_expected(claims, expected, index) ? unstamped_verdict::match : unstamped_verdict::extra;
+}
+
+static void check_unstamped_outputs()
+{
+    const expected_set expected = create_expected_set({"0a0a", "0b0b", "0c0c", "0a0a"});
+    CHECK(expected.copies[0] == 2);
+    CHECK(expected.copies[3] == 0);
+
+    // Every output, in any order, matches once
+    {
+        expected_claims claims = create_expected_claims(expected);
+        CHECK(receive_unstamped(expected, claims, "0c0c") == unstamped_verdict::match);
+        CHECK(receive_unstamped(expected, claims, "0a0a") == unstamped_verdict::match);
+        CHECK(receive_unstamped(expected, claims, "0b0b") == unstamped_verdict::match);
+        CHECK(receive_unstamped(expected, claims, "0a0a") == unstamped_verdict::match);
+        CHECK(receive_unstamped(expected, claims, "0a0a") == unstamped_verdict::extra);
+    }
+
+    // A DUT sending the same valid output for every input only gets credit for one of them
+    {
+        expected_claims claims = create_expected_claims(expected);
+        CHECK(receive_unstamped(expected, claims, "0b0b") == unstamped_verdict::match);
+        CHECK(receive_unstamped(expected, claims, "0b0b") == unstamped_verdict::extra);
+        CHECK(receive_unstamped(expected, claims, "0b0b") == unstamped_verdict::extra);
+        CHECK(receive_unstamped(expected, claims, "0b0b") == unstamped_verdict::extra);
+    }
+
+    // An output that's wrong for its input but valid for another one leaves that other output short
+    {
+        expected_claims claims = create_expected_claims(expected);
+        CHECK(receive_unstamped(expected, claims, "0a0a") == unstamped_verdict::match);
+        CHECK(receive_unstamped(expected, claims, "0c0c") == unstamped_verdict::match);
+        CHECK(receive_unstamped(expected, claims, "0c0c") == unstamped_verdict::extra);
+        CHECK(receive_unstamped(expected, claims, "0a0a") == unstamped_verdict::match);
+        CHECK(receive_unstamped(expected, claims, "0d0d") == unstamped_verdict::mismatch);
+    }
+}
+
+// Tracks sequence numbers [from, to) on one tracker, checking each one's in order
+static void track_range(sequence_tracker& tracker, uint64_t from, uint64_t to)
+{
+    bool in_order = true;
+    for (uint64_t sequence = from; sequence < to; ++sequence)
+        in_order = track_sequence(tracker, sequence) == sequence_status::in_order && in_order;
+
+    CHECK(in_order);
+}
+
+static void check_sequence_window()
+{
+    constexpr size_t window_words = 4;
+    constexpr uint64_t window = window_words * 64;
+
+    // A gap longer than the window: the frames after it are still in order, and only the gap is lost
+    {
+        std::vector<sequence_tracker> trackers = {create_sequence_tracker(UINT64_MAX, window_words)};
+        sequence_tracker& tracker = trackers[0];
+
+        track_range(tracker, 0, 100);
+        track_range(tracker, 100 + 3 * window, 100 + 5 * window);
+        CHECK(tracker.seen.size() <= 2 * window_words);
+
+        const sequence_totals totals = merge_sequence_trackers(trackers, 100 + 5 * window);
+        CHECK(totals.unique == 100 + 2 * window);
+        CHECK(totals.duplicates == 0);
+
+        // Something from before the jump arriving now is too late to count
+        CHECK(track_sequence(tracker, 50) == sequence_status::reordered);
+        CHECK(track_sequence(tracker, 100 + 5 * window - 1) == sequence_status::duplicate);
+    }
+
+    // A long run with a burst of loss many windows long in the middle, and a gap that only just fits
+    {
+        std::vector<sequence_tracker> trackers = {create_sequence_tracker(UINT64_MAX, window_words)};
+        sequence_tracker& tracker = trackers[0];
+
+        track_range(tracker, 0, 10 * window);
+        track_range(tracker, 50 * window + 7, 60 * window);
+        track_range(tracker, 61 * window, 100 * window);
+
+        const sequence_totals totals = merge_sequence_trackers(trackers, 100 * window);
+        CHECK(totals.unique == 10 * window + (10 * window - 7) + 39 * window);
+        CHECK(100 * window - totals.unique == 40 * window + 7 + window);
+    }
+
+    // Without a window, every sequence number is kept, and a gap is only ever loss
+    {
+        std::vector<sequence_tracker> trackers = {create_sequence_tracker(1000)};
+        sequence_tracker& tracker = trackers[0];
+
+        track_range(tracker, 0, 10);
+        track_range(tracker, 900, 1000);
+        CHECK(track_sequence(tracker, 5) == sequence_status::duplicate);
+        CHECK(track_sequence(tracker, 20) == sequence_status::reordered);
+        CHECK(track_sequence(tracker, 1000) == sequence_status::out_of_range);
+
+        const sequence_totals totals = merge_sequence_trackers(trackers, 1000);
+        CHECK(totals.unique == 111);
+    }
+}
+
+int main()
+{
+    check_unstamped_outputs();
+    check_sequence_window();
+
+    if (failures > 0)
+    {
+        std::cout << failures << " checks failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
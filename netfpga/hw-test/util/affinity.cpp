@@ -0,0 +1,54 @@
+#include "affinity.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#include <pthread.h>
+#include <sched.h>
+
+void pin_current_thread(int cpu)
+{
+    if (cpu < 0) return;
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (ret != 0)
+    {
+        std::cerr << "Failed to pin thread to CPU " << cpu << ": " << ret << std::endl;
+        exit(-1);
+    }
+}
+
+std::vector<int> parse_cpu_list(const std::string& list)
+{
+    std::vector<int> cpus;
+
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ','))
+    {
+        if (range.empty()) continue;
+
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+
+        for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    }
+
+    return cpus;
+}
+
+std::string cpu_list_to_string(const std::vector<int>& cpus)
+{
+    std::stringstream list;
+    for (size_t i = 0; i < cpus.size(); ++i)
+        list << (i == 0 ? "" : ",") << cpus[i];
+
+    return list.str();
+}
@@ -0,0 +1,15 @@
+#ifndef TRAFFIC_GENERATOR_AFFINITY_H
+#define TRAFFIC_GENERATOR_AFFINITY_H
+
+#include <string>
+#include <vector>
+
+// Pins the calling thread to cpu, so the scheduler can't migrate it away from its caches (or from the
+// CPU its RX queue's interrupts land on). A cpu below 0 leaves the thread unpinned.
+void pin_current_thread(int cpu);
+
+// Parses a CPU list like "2,3,8-11"
+std::vector<int> parse_cpu_list(const std::string& list);
+std::string cpu_list_to_string(const std::vector<int>& cpus);
+
+#endif //TRAFFIC_GENERATOR_AFFINITY_H
@@ -0,0 +1,109 @@
+#include "histogram.h"
+
+#include <algorithm>
+#include <sstream>
+
+static constexpr unsigned int LINEAR_BITS = 7;                            // exact below 2^7
+static constexpr uint64_t LINEAR_BUCKETS = 1ull << LINEAR_BITS;
+static constexpr uint64_t SUB_BUCKETS = LINEAR_BUCKETS / 2;                // per power of two above that
+static constexpr uint64_t BUCKET_COUNT = LINEAR_BUCKETS + (64 - LINEAR_BITS) * SUB_BUCKETS;
+
+static size_t bucket_index(uint64_t value)
+{
+    if (value < LINEAR_BUCKETS) return static_cast<size_t>(value);
+
+    const unsigned int exponent = 63 - __builtin_clzll(value);
+    const uint64_t sub_bucket = (value >> (exponent - LINEAR_BITS + 1)) - SUB_BUCKETS;
+
+    return static_cast<size_t>(LINEAR_BUCKETS + (exponent - LINEAR_BITS) * SUB_BUCKETS + sub_bucket);
+}
+
+// The smallest value that lands in bucket index
+static uint64_t bucket_value(size_t index)
+{
+    if (index < LINEAR_BUCKETS) return index;
+
+    const unsigned int exponent = LINEAR_BITS + (index - LINEAR_BUCKETS) / SUB_BUCKETS;
+    const uint64_t sub_bucket = (index - LINEAR_BUCKETS) % SUB_BUCKETS;
+
+    return (SUB_BUCKETS + sub_bucket) << (exponent - LINEAR_BITS + 1);
+}
+
+latency_histogram create_latency_histogram()
+{
+    return latency_histogram
+    {
+        .counts = std::vector<uint64_t>(BUCKET_COUNT, 0),
+        .total = 0,
+        .min = UINT64_MAX,
+        .max = 0,
+        .sum = 0
+    };
+}
+
+void record_latency(latency_histogram& histogram, uint64_t value_ns)
+{
+    ++histogram.counts[bucket_index(value_ns)];
+    ++histogram.total;
+    histogram.min = std::min(histogram.min, value_ns);
+    histogram.max = std::max(histogram.max, value_ns);
+    histogram.sum += value_ns;
+}
+
+void clear_latency_histogram(latency_histogram& histogram)
+{
+    std::fill(histogram.counts.begin(), histogram.counts.end(), 0);
+    histogram.total = 0;
+    histogram.min = UINT64_MAX;
+    histogram.max = 0;
+    histogram.sum = 0;
+}
+
+void merge_latency_histogram(latency_histogram& histogram, const latency_histogram& other)
+{
+    for (size_t i = 0; i < BUCKET_COUNT; ++i)
+        histogram.counts[i] += other.counts[i];
+
+    histogram.total += other.total;
+    histogram.min = std::min(histogram.min, other.min);
+    histogram.max = std::max(histogram.max, other.max);
+    histogram.sum += other.sum;
+}
+
+uint64_t latency_percentile(const latency_histogram& histogram, double percentile)
+{
+    if (histogram.total == 0) return 0;
+
+    const auto rank = static_cast<uint64_t>(static_cast<long double>(histogram.total) * percentile / 100.0L);
+    const uint64_t target = std::max<uint64_t>(1, std::min(rank, histogram.total));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+        seen += histogram.counts[i];
+        if (seen >= target) return std::clamp(bucket_value(i), histogram.min, histogram.max);
+    }
+
+    return histogram.max;
+}
+
+std::string latency_summary(const latency_histogram& histogram)
+{
+    std::stringstream summary;
+
+    if (histogram.total == 0)
+    {
+        summary << "no samples";
+        return summary.str();
+    }
+
+    summary << histogram.total << " samples, "
+        << "min " << histogram.min << " ns, "
+        << "mean " << static_cast<uint64_t>(histogram.sum / histogram.total) << " ns, "
+        << "p50 " << latency_percentile(histogram, 50) << " ns, "
+        << "p99 " << latency_percentile(histogram, 99) << " ns, "
+        << "p99.9 " << latency_percentile(histogram, 99.9) << " ns, "
+        << "max " << histogram.max << " ns";
+
+    return summary.str();
+}
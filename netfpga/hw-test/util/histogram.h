@@ -0,0 +1,35 @@
+#ifndef TRAFFIC_GENERATOR_HISTOGRAM_H
+#define TRAFFIC_GENERATOR_HISTOGRAM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Log-linear histogram of nanosecond values: exact below 128 ns, and above that every power of two is
+// split into 64 buckets, so any recorded value is off by at most 1/64 (~1.6%). Fixed size no matter
+// how many values are recorded, so a run of millions of packets costs nothing extra.
+struct latency_histogram
+{
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    long double sum;
+};
+
+latency_histogram create_latency_histogram();
+void record_latency(latency_histogram& histogram, uint64_t value_ns);
+
+// Forgets everything recorded, keeping the buckets' storage
+void clear_latency_histogram(latency_histogram& histogram);
+
+// Adds everything recorded in other into histogram
+void merge_latency_histogram(latency_histogram& histogram, const latency_histogram& other);
+
+// The smallest recorded value (at bucket precision) that at least percentile% of values are at or below
+uint64_t latency_percentile(const latency_histogram& histogram, double percentile);
+
+// min/mean/p50/p99/p99.9/max, on one line
+std::string latency_summary(const latency_histogram& histogram);
+
+#endif //TRAFFIC_GENERATOR_HISTOGRAM_H
@@ -0,0 +1,312 @@
+#include "log.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Per thread; big enough to ride out a burst of hex dumps while the writer catches up
+constexpr size_t LOG_QUEUE_CAPACITY = 4 << 20;
+
+// How long the writer sleeps when every queue is empty
+constexpr auto LOG_IDLE_SLEEP = std::chrono::milliseconds(1);
+
+// Every entry in a queue starts with one of these, and is padded out to a multiple of 8 bytes. An
+// entry that would run past the end of the buffer is preceded by a padding-only entry that fills the
+// rest of it, so every entry is contiguous.
+struct entry_header
+{
+    uint32_t size;
+    uint32_t padding_only;
+    frame_record record;
+    uint32_t frame_bytes;
+    uint32_t expected_bytes;
+};
+
+static constexpr size_t align8(size_t size) { return (size + 7) & ~size_t{7}; }
+
+bool parse_log_level(const std::string& name, log_level& level)
+{
+    for (log_level candidate: {log_level::quiet, log_level::errors, log_level::frames, log_level::dump})
+    {
+        if (name == log_level_name(candidate))
+        {
+            level = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char* log_level_name(log_level level)
+{
+    switch (level)
+    {
+        case log_level::quiet:  return "quiet";
+        case log_level::errors: return "errors";
+        case log_level::frames: return "frames";
+        case log_level::dump:   return "dump";
+    }
+
+    return "unknown";
+}
+
+void log_frame(log_queue& queue, const frame_record& record, const uint8_t* frame, const uint8_t* expected, size_t expected_size)
+{
+    if (queue.capacity == 0) return;
+
+    const size_t frame_bytes = frame ? record.frame_size : 0;
+    const size_t expected_bytes = expected ? expected_size : 0;
+    const size_t size = align8(sizeof(entry_header) + frame_bytes + expected_bytes);
+
+    const uint64_t head = queue.head.load(std::memory_order_relaxed);
+    const uint64_t tail = queue.tail.load(std::memory_order_acquire);
+
+    const size_t offset = head & (queue.capacity - 1);
+    const size_t to_end = queue.capacity - offset;
+    const size_t padding = size > to_end ? to_end : 0;
+
+    if (size > queue.capacity / 2 || queue.capacity - (head - tail) < padding + size)
+    {
+        queue.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint8_t* entry = queue.buffer.get() + offset;
+    if (padding > 0)
+    {
+        const uint32_t padding_header[2] = {static_cast<uint32_t>(padding), 1};
+        std::memcpy(entry, padding_header, sizeof(padding_header));
+        entry = queue.buffer.get();
+    }
+
+    entry_header header{};
+    header.size = static_cast<uint32_t>(size);
+    header.record = record;
+    header.frame_bytes = static_cast<uint32_t>(frame_bytes);
+    header.expected_bytes = static_cast<uint32_t>(expected_bytes);
+
+    std::memcpy(entry, &header, sizeof(header));
+    if (frame_bytes > 0) std::memcpy(entry + sizeof(header), frame, frame_bytes);
+    if (expected_bytes > 0) std::memcpy(entry + sizeof(header) + frame_bytes, expected, expected_bytes);
+
+    queue.head.store(head + padding + size, std::memory_order_release);
+}
+
+static void append_hex(std::string& text, const uint8_t* data, size_t size)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    text += '"';
+    for (size_t i = 0; i < size; ++i)
+    {
+        text += digits[data[i] >> 4];
+        text += digits[data[i] & 0x0f];
+    }
+    text += '"';
+}
+
+static void append_field(std::string& text, const char* name, uint64_t value)
+{
+    text += ",\"";
+    text += name;
+    text += "\":";
+    text += std::to_string(value);
+}
+
+static void format_entry(std::string& text, const log_queue& queue, const entry_header& header, const uint8_t* bytes)
+{
+    const frame_record& record = header.record;
+
+    text += "{\"event\":\"";
+    text += record.event == log_event::sent ? "sent" : "received";
+    text += "\",\"thread\":\"";
+    text += queue.name;
+    text += '"';
+
+    append_field(text, "time_ns", record.time_ns);
+    if (record.event == log_event::sent) append_field(text, "index", record.index);
+    append_field(text, "size", record.frame_size);
+
+    if (record.verdict)
+    {
+        text += ",\"verdict\":\"";
+        text += record.verdict;
+        text += '"';
+    }
+
+    if (record.reordered) text += ",\"reordered\":true";
+    if (record.has_sequence) append_field(text, "sequence", record.sequence);
+    if (record.has_latency) append_field(text, "latency_ns", record.latency_ns);
+
+    if (header.frame_bytes > 0)
+    {
+        text += ",\"frame\":";
+        append_hex(text, bytes, header.frame_bytes);
+
+        if (record.payload_offset + record.payload_size <= header.frame_bytes && record.payload_size > 0)
+        {
+            text += ",\"payload\":";
+            append_hex(text, bytes + record.payload_offset, record.payload_size);
+        }
+    }
+
+    if (header.expected_bytes > 0)
+    {
+        text += ",\"expected\":";
+        append_hex(text, bytes + header.frame_bytes, header.expected_bytes);
+    }
+
+    text += "}\n";
+}
+
+// Formats everything in queue into text. Returns how many records that was.
+static size_t drain_queue(log_queue& queue, std::string& text)
+{
+    uint64_t tail = queue.tail.load(std::memory_order_relaxed);
+    const uint64_t head = queue.head.load(std::memory_order_acquire);
+
+    size_t records = 0;
+    while (tail != head)
+    {
+        const uint8_t* entry = queue.buffer.get() + (tail & (queue.capacity - 1));
+
+        uint32_t prefix[2];
+        std::memcpy(prefix, entry, sizeof(prefix));
+
+        if (prefix[1] == 0)
+        {
+            entry_header header{};
+            std::memcpy(&header, entry, sizeof(header));
+            format_entry(text, queue, header, entry + sizeof(header));
+            ++records;
+        }
+
+        tail += prefix[0];
+    }
+
+    queue.tail.store(tail, std::memory_order_release);
+    return records;
+}
+
+static std::vector<log_queue*> snapshot_queues(logger& log)
+{
+    std::lock_guard<std::mutex> guard(log.queues_lock);
+
+    std::vector<log_queue*> queues;
+    for (const std::unique_ptr<log_queue>& queue: log.queues) queues.push_back(queue.get());
+    return queues;
+}
+
+static void writer_thread(logger& log)
+{
+    std::string text;
+
+    while (true)
+    {
+        // Checked before draining, so that everything queued before the stop was asked for is written
+        const bool stopping = log.stop.load(std::memory_order_acquire);
+
+        size_t records = 0;
+        {
+            std::lock_guard<std::mutex> guard(log.write_lock);
+
+            for (log_queue* queue: snapshot_queues(log))
+            {
+                records += drain_queue(*queue, text);
+
+                if (!text.empty())
+                {
+                    fwrite(text.data(), 1, text.size(), log.out);
+                    text.clear();
+                }
+            }
+        }
+
+        if (records > 0) continue;
+        if (stopping) break;
+
+        std::this_thread::sleep_for(LOG_IDLE_SLEEP);
+    }
+}
+
+void open_logger(logger& log, log_level level, const std::string& path)
+{
+    log.level = level;
+    log.owns_out = !path.empty();
+    log.out = log.owns_out ? fopen(path.c_str(), "w") : stdout;
+
+    if (!log.out)
+    {
+        perror(("Failed to open " + path).c_str());
+        exit(-1);
+    }
+
+    log.writer = std::thread(writer_thread, std::ref(log));
+}
+
+log_queue& get_log_queue(logger& log, const std::string& name)
+{
+    std::lock_guard<std::mutex> guard(log.queues_lock);
+
+    for (const std::unique_ptr<log_queue>& queue: log.queues)
+        if (queue->name == name) return *queue;
+
+    auto queue = std::make_unique<log_queue>();
+    queue->name = name;
+    queue->level = log.level;
+
+    // Nothing's queued below errors, so there's no need for a buffer at all
+    queue->capacity = log.level == log_level::quiet ? 0 : LOG_QUEUE_CAPACITY;
+    if (queue->capacity > 0) queue->buffer = std::make_unique<uint8_t[]>(queue->capacity);
+
+    log.queues.push_back(std::move(queue));
+    return *log.queues.back();
+}
+
+static bool queues_empty(logger& log)
+{
+    for (log_queue* queue: snapshot_queues(log))
+    {
+        if (queue->head.load(std::memory_order_acquire) != queue->tail.load(std::memory_order_acquire))
+            return false;
+    }
+
+    return true;
+}
+
+void flush_logger(logger& log)
+{
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> guard(log.write_lock);
+            if (queues_empty(log))
+            {
+                fflush(log.out);
+                return;
+            }
+        }
+
+        std::this_thread::sleep_for(LOG_IDLE_SLEEP);
+    }
+}
+
+void close_logger(logger& log)
+{
+    flush_logger(log);
+
+    log.stop.store(true, std::memory_order_release);
+    log.writer.join();
+
+    for (log_queue* queue: snapshot_queues(log))
+    {
+        const uint64_t dropped = queue->dropped.load(std::memory_order_relaxed);
+        if (dropped > 0)
+            std::cout << queue->name << ": " << dropped << " log records dropped, as the log writer couldn't keep up" << std::endl;
+    }
+
+    if (log.owns_out) fclose(log.out);
+    else fflush(log.out);
+}
@@ -0,0 +1,118 @@
+#ifndef TRAFFIC_GENERATOR_LOG_H
+#define TRAFFIC_GENERATOR_LOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Per-frame logging, kept off the send and receive paths. Each thread pushes fixed-size records (and
+// the frame's bytes, only when they're wanted) into a single-producer, single-consumer ring of its
+// own; a writer thread drains the rings and turns the records into JSON lines, one per frame. A
+// thread never waits on the log: if its ring is full, the record is dropped and counted instead.
+enum class log_level
+{
+    quiet,   // nothing per frame
+    errors,  // only frames that didn't match, came back damaged or came back twice, hex dumped
+    frames,  // a compact record per frame; hex dumps only for the errors
+    dump,    // a record per frame with every frame hex dumped, as the generator used to print
+};
+
+bool parse_log_level(const std::string& name, log_level& level);
+const char* log_level_name(log_level level);
+
+enum class log_event : uint8_t
+{
+    sent,
+    received,
+};
+
+// Everything a record says about a frame apart from its bytes. verdict has to be a string literal, as
+// only the pointer is queued.
+struct frame_record
+{
+    log_event event;
+    bool has_sequence;
+    bool has_latency;
+    bool reordered;
+    const char* verdict;
+
+    uint64_t time_ns;
+    uint64_t index;         // the input (or packet of a profile) a sent frame was built from
+    uint64_t sequence;
+    uint64_t latency_ns;
+    uint32_t frame_size;
+
+    // Where the UDP payload starts in the frame, and how long it is, when there is one
+    uint32_t payload_offset;
+    uint32_t payload_size;
+};
+
+// Bytes are pushed at head and popped at tail; both only ever grow, and are taken modulo the
+// (power-of-two) size of the buffer. Each sits on its own cache line, as each has its own writer.
+struct log_queue
+{
+    std::string name;
+    log_level level;
+    std::unique_ptr<uint8_t[]> buffer;
+    size_t capacity;
+
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+// Whether a frame's record is wanted at all, and whether its bytes should go with it
+inline bool log_wants_frame(const log_queue& queue, bool error)
+{
+    return queue.level >= log_level::frames || (queue.level == log_level::errors && error);
+}
+
+inline bool log_wants_bytes(const log_queue& queue, bool error)
+{
+    return queue.level == log_level::dump || (error && queue.level != log_level::quiet);
+}
+
+struct logger
+{
+    log_level level;
+    FILE* out;
+    bool owns_out;
+
+    // Queues are looked up by name, so a thread that's restarted (by the benchmark, say) picks its
+    // old queue back up. They're never freed before the logger is, so the pointers stay good.
+    std::mutex queues_lock;
+    std::vector<std::unique_ptr<log_queue>> queues;
+
+    // Held by the writer while it's working through what it's popped, so flush_logger can tell when
+    // it's really done
+    std::mutex write_lock;
+    std::thread writer;
+    std::atomic<bool> stop{false};
+};
+
+// Sets log up in place (it holds a thread and mutexes) and starts its writer. Records go to path, or
+// standard output if it's empty.
+void open_logger(logger& log, log_level level, const std::string& path);
+
+// The queue for the thread called name, created if there isn't one yet. Only one thread may push to
+// a queue at a time.
+log_queue& get_log_queue(logger& log, const std::string& name);
+
+// Queues a frame's record, with its bytes if frame isn't null, and expected (the output the frame
+// should have carried) if it isn't null either
+void log_frame(log_queue& queue, const frame_record& record, const uint8_t* frame, const uint8_t* expected, size_t expected_size);
+
+// Waits until everything queued so far has been written out - so the log and the results that
+// follow it on standard output don't interleave
+void flush_logger(logger& log);
+
+// Flushes, stops the writer, reports anything dropped and closes the output
+void close_logger(logger& log);
+
+#endif //TRAFFIC_GENERATOR_LOG_H
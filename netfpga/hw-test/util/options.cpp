@@ -5,8 +5,12 @@
 #include "options.h"
 
 #include <iostream>
+#include <getopt.h>
 #include <unistd.h>
 
+#include "../network/fanout.h"
+#include "../traffic/soft_dut.h"
+#include "../util/affinity.h"
 #include "../util/string_utils.h"
 
 void print_options(const options& opts)
@@ -19,6 +23,79 @@ void print_options(const options& opts)
     std::cout << "  Port:                    " << opts.port << std::endl;
     std::cout << "  Inputs:                  " << vec_to_string(opts.inputs) << std::endl;
     std::cout << "  Expected Outputs:        " << vec_to_string(opts.expected_outputs) << std::endl;
+    std::cout << "  Receive Path:            " << (opts.use_rx_ring ? "TPACKET_V3 ring" : "recvfrom") << std::endl;
+    if (opts.use_rx_ring)
+    {
+        std::cout << "    Block Size:            " << opts.ring_config.block_size << std::endl;
+        std::cout << "    Block Count:           " << opts.ring_config.block_count << std::endl;
+        std::cout << "    Frame Size:            " << opts.ring_config.frame_size << std::endl;
+        std::cout << "    Block Timeout (ms):    " << opts.ring_config.block_timeout_ms << std::endl;
+    }
+    std::cout << "  Transmit Batch Size:     " << (opts.batch_size == 0 ? "(none, one sendto per packet)" : std::to_string(opts.batch_size)) << std::endl;
+    if (is_load_mode(opts))
+    {
+        std::cout << "  Load Mode:" << std::endl;
+        std::cout << "    Packet Count:          " << (opts.packet_count == 0 ? "(unlimited)" : std::to_string(opts.packet_count)) << std::endl;
+        std::cout << "    Duration (s):          " << (opts.duration_s == 0 ? "(unlimited)" : std::to_string(opts.duration_s)) << std::endl;
+        if (opts.rate_gbps > 0)
+            std::cout << "    Rate:                  " << opts.rate_gbps << " Gbps" << std::endl;
+        else if (opts.rate_pps > 0)
+            std::cout << "    Rate:                  " << opts.rate_pps << " pps" << std::endl;
+        else
+            std::cout << "    Rate:                  (unpaced)" << std::endl;
+        std::cout << "    Burst:                 " << opts.burst << std::endl;
+    }
+    std::cout << "  Measure Latency:         " << (opts.measure_latency ? "yes" : "no") << std::endl;
+    std::cout << "  Receive Threads:         " << opts.rx_threads << std::endl;
+    if (opts.rx_threads > 1)
+        std::cout << "    Fanout Mode:           " << fanout_mode_name(opts.fanout_mode) << std::endl;
+    std::cout << "  Receive CPUs:            " << (opts.rx_cpus.empty() ? "(unpinned)" : cpu_list_to_string(opts.rx_cpus)) << std::endl;
+    std::cout << "  Transmit CPU:            " << (opts.tx_cpu < 0 ? "(unpinned)" : std::to_string(opts.tx_cpu)) << std::endl;
+    if (!opts.pcap_input.empty())
+        std::cout << "  Replaying:               " << opts.pcap_input << (opts.pcap_timing ? " (at its original timing)" : "") << std::endl;
+    if (!opts.pcap_output.empty())
+        std::cout << "  Capturing To:            " << opts.pcap_output << std::endl;
+    std::cout << "  Receive Filter:          " << (opts.use_receive_filter ? "yes" : "(none, every frame reaches user space)") << std::endl;
+    if (opts.use_xdp)
+    {
+        std::cout << "  AF_XDP:" << std::endl;
+        std::cout << "    First Queue:           " << opts.xdp_queue << std::endl;
+        std::cout << "    Zero-Copy:             " << (opts.xdp_settings.force_copy ? "no" : "if the driver supports it") << std::endl;
+        std::cout << "    XDP Mode:              " << (opts.xdp_settings.force_skb ? "generic (SKB)" : "native if the driver supports it") << std::endl;
+    }
+    if (opts.use_uring)
+        std::cout << "  I/O Engine:              io_uring" << std::endl;
+    if (!opts.soft_dut_ingress.empty())
+    {
+        std::cout << "  Soft DUT:" << std::endl;
+        std::cout << "    Interfaces:            " << opts.soft_dut_ingress << " -> " << opts.soft_dut_egress << std::endl;
+        std::cout << "    Transform:             " << opts.soft_dut_transform << std::endl;
+        std::cout << "    CPU:                   " << (opts.soft_dut_cpu < 0 ? "(unpinned)" : std::to_string(opts.soft_dut_cpu)) << std::endl;
+    }
+    std::cout << "  Receive Timeout (ms):    " << opts.receive_timeout_ms << std::endl;
+    if (opts.benchmark)
+    {
+        std::vector<std::string> sizes;
+        for (size_t size: opts.benchmark_frame_sizes) sizes.push_back(std::to_string(size));
+
+        std::cout << "  Benchmark:" << std::endl;
+        std::cout << "    Frame Sizes:           " << join(sizes, ",") << std::endl;
+        std::cout << "    Trial Duration (s):    " << opts.benchmark_trial_s << std::endl;
+        std::cout << "    Line Rate (Gbps):      " << opts.line_rate_gbps << std::endl;
+        std::cout << "    Resolution (%):        " << opts.benchmark_resolution << std::endl;
+        std::cout << "    Loss Tolerance (%):    " << opts.benchmark_loss_tolerance << std::endl;
+        std::cout << "    Report:                " << opts.benchmark_report << ".csv, " << opts.benchmark_report << ".json" << std::endl;
+    }
+    if (uses_profile(opts)) print_traffic_profile(opts.profile);
+    if (opts.soak)
+    {
+        std::cout << "  Soak:" << std::endl;
+        std::cout << "    Report Interval (s):   " << opts.soak_interval_s << std::endl;
+        std::cout << "    Metrics File:          " << (opts.soak_metrics.empty() ? "(none)" : opts.soak_metrics) << std::endl;
+        std::cout << "    Prometheus Port:       " << (opts.prometheus_port == 0 ? "(none)" : std::to_string(opts.prometheus_port)) << std::endl;
+    }
+    std::cout << "  Log Level:               " << log_level_name(opts.verbosity) << std::endl;
+    std::cout << "  Log File:                " << (opts.log_file.empty() ? "(standard output)" : opts.log_file) << std::endl;
 }
 
 void print_help()
@@ -32,8 +109,157 @@ void print_help()
     std::cout << "  -p Port" << std::endl;
     std::cout << "  -i Inputs (specify as hex strings)" << std::endl;
     std::cout << "  -o Expected Outputs (specify as hex strings)" << std::endl;
+    std::cout << "  --rx-ring Receive through a memory-mapped TPACKET_V3 ring instead of one recvfrom per frame" << std::endl;
+    std::cout << "  --rx-ring-block-size Ring block size in bytes (multiple of the page size, default 1 MiB)" << std::endl;
+    std::cout << "  --rx-ring-block-count Number of ring blocks (default 64)" << std::endl;
+    std::cout << "  --rx-ring-frame-size Largest frame the ring accepts, in bytes (default 2048)" << std::endl;
+    std::cout << "  --rx-ring-block-timeout Milliseconds before a partially filled block is handed over (default 10)" << std::endl;
+    std::cout << "  --batch-size Build every packet up front, then send them with sendmmsg this many at a time" << std::endl;
+    std::cout << "  --count Load mode: replay the inputs in a loop until this many packets have been sent" << std::endl;
+    std::cout << "  --duration Load mode: replay the inputs in a loop for this many seconds" << std::endl;
+    std::cout << "  --rate-pps Load mode: target rate in packets per second (default unpaced)" << std::endl;
+    std::cout << "  --rate-gbps Load mode: target rate in Gbps of Ethernet wire time, including preamble and gap" << std::endl;
+    std::cout << "  --burst Load mode: packets allowed out back to back before pacing kicks in (default 1)" << std::endl;
+    std::cout << "  --latency Stamp each packet with a sequence number and transmit time, and report a latency histogram" << std::endl;
+    std::cout << "  --rx-threads Receive threads per interface, sharing its traffic through PACKET_FANOUT (default 1)" << std::endl;
+    std::cout << "  --fanout How frames are spread over the receive threads: lb (round robin, default), hash, cpu or qm" << std::endl;
+    std::cout << "    (hash, cpu and qm follow the flow hash, so they only spread traffic made up of several flows)" << std::endl;
+    std::cout << "  --rx-cpus CPUs to pin the receive threads to, in order, e.g. 2,3,8-11" << std::endl;
+    std::cout << "  --tx-cpu CPU to pin the transmit thread to" << std::endl;
+    std::cout << "  --pcap-in Replay the IPv4 packets of a pcap or pcapng file instead of the inputs" << std::endl;
+    std::cout << "    (once, as fast as possible or at --rate-*; --count/--duration loop it)" << std::endl;
+    std::cout << "  --pcap-timing Replay the pcap file at the pace it was captured at" << std::endl;
+    std::cout << "  --pcap-out Capture every received frame to this pcap file (one per interface, if there are several)" << std::endl;
+    std::cout << "  --no-filter Don't attach the BPF filter that keeps everything but the DUT's output in the kernel" << std::endl;
+    std::cout << "  --xdp Send and receive through AF_XDP sockets instead of the kernel's stack (needs -m)" << std::endl;
+    std::cout << "  --xdp-queue First NIC queue to bind to; receive thread N uses the queue after that plus N (default 0)" << std::endl;
+    std::cout << "    (on a multi-queue NIC, steer the DUT's output to those queues, e.g. with ethtool -N ... action Q)" << std::endl;
+    std::cout << "  --xdp-copy Don't try zero-copy, even if the driver supports it" << std::endl;
+    std::cout << "  --xdp-skb Attach the XDP program in generic (SKB) mode, even if the driver supports native mode" << std::endl;
+    std::cout << "  --io-uring Send and receive through io_uring: batched, linked writes out of registered buffers, and a" << std::endl;
+    std::cout << "    multishot receive per socket into provided buffers (--pcap-in is still sent with sendmmsg)" << std::endl;
+    std::cout << "  --soft-dut Run a software stand-in for the packet processor between two interfaces, given as INGRESS,EGRESS" << std::endl;
+    std::cout << "    (e.g. the far ends of veth pairs whose near ends are -t and -r; see the runSelfTest Gradle task)" << std::endl;
+    std::cout << "  --soft-dut-transform What the soft DUT does to each payload: " << payload_transform_names() << " (default echo)" << std::endl;
+    std::cout << "  --soft-dut-cpu CPU to pin the soft DUT to" << std::endl;
+    std::cout << "  --rx-timeout Milliseconds of silence (once the transmitter is done) before giving up on the rest (default 3000)" << std::endl;
+    std::cout << "  --benchmark Binary-search the zero-loss throughput at each frame size, RFC 2544 style, and write a report" << std::endl;
+    std::cout << "    (the inputs, if any, are only used as the payload pattern; --count, --duration and --rate-* are ignored)" << std::endl;
+    std::cout << "  --benchmark-sizes Ethernet frame sizes to test, FCS included (default 64,128,256,512,1024,1280,1518;" << std::endl;
+    std::cout << "    add e.g. 9018 if the interfaces are set up for jumbo frames)" << std::endl;
+    std::cout << "  --benchmark-trial Seconds each trial sends for (default 2)" << std::endl;
+    std::cout << "  --line-rate-gbps Link speed the search starts from (default 10)" << std::endl;
+    std::cout << "  --benchmark-resolution Stop searching once the bounds are this close, in percent of line rate (default 1)" << std::endl;
+    std::cout << "  --benchmark-loss Loss a trial may have and still pass, in percent (default 0)" << std::endl;
+    std::cout << "  --benchmark-report Report path, without extension; writes .csv and .json (default benchmark)" << std::endl;
+    std::cout << "  --profile Send the flows, frame sizes and payloads a traffic profile describes instead of the inputs" << std::endl;
+    std::cout << "    (see traffic/profile.h for the format; without --count or --duration, its packets are sent once each)" << std::endl;
+    std::cout << "  --soak Load mode that runs until interrupted (or for --count/--duration), reporting live counters" << std::endl;
+    std::cout << "    every interval; Ctrl-C stops the transmitter, waits for what's in flight and prints the summary" << std::endl;
+    std::cout << "  --soak-interval Seconds between soak reports (default 1)" << std::endl;
+    std::cout << "  --soak-metrics Append each soak report to this CSV file, one row per receiving interface" << std::endl;
+    std::cout << "  --prometheus-port Serve the soak's counters in the Prometheus text format on 127.0.0.1 at this port" << std::endl;
+    std::cout << "  --log-level What's logged per frame, as JSON lines: quiet, errors (frames that didn't match, hex dumped)," << std::endl;
+    std::cout << "    frames (a record per frame) or dump (every frame hex dumped) (default errors in load mode, frames otherwise)" << std::endl;
+    std::cout << "  --log-file Write the per-frame log here rather than to standard output" << std::endl;
 }
 
+// Long-only options are numbered from here so they can't collide with the short option characters
+enum long_option
+{
+    OPTION_RX_RING = 256,
+    OPTION_RX_RING_BLOCK_SIZE,
+    OPTION_RX_RING_BLOCK_COUNT,
+    OPTION_RX_RING_FRAME_SIZE,
+    OPTION_RX_RING_BLOCK_TIMEOUT,
+    OPTION_BATCH_SIZE,
+    OPTION_COUNT,
+    OPTION_DURATION,
+    OPTION_RATE_PPS,
+    OPTION_RATE_GBPS,
+    OPTION_BURST,
+    OPTION_LATENCY,
+    OPTION_RX_THREADS,
+    OPTION_FANOUT,
+    OPTION_RX_CPUS,
+    OPTION_TX_CPU,
+    OPTION_PCAP_IN,
+    OPTION_PCAP_TIMING,
+    OPTION_PCAP_OUT,
+    OPTION_NO_FILTER,
+    OPTION_XDP,
+    OPTION_XDP_QUEUE,
+    OPTION_XDP_COPY,
+    OPTION_XDP_SKB,
+    OPTION_SOFT_DUT,
+    OPTION_SOFT_DUT_TRANSFORM,
+    OPTION_SOFT_DUT_CPU,
+    OPTION_RX_TIMEOUT,
+    OPTION_BENCHMARK,
+    OPTION_BENCHMARK_SIZES,
+    OPTION_BENCHMARK_TRIAL,
+    OPTION_LINE_RATE_GBPS,
+    OPTION_BENCHMARK_RESOLUTION,
+    OPTION_BENCHMARK_LOSS,
+    OPTION_BENCHMARK_REPORT,
+    OPTION_PROFILE,
+    OPTION_LOG_LEVEL,
+    OPTION_LOG_FILE,
+    OPTION_SOAK,
+    OPTION_SOAK_INTERVAL,
+    OPTION_SOAK_METRICS,
+    OPTION_PROMETHEUS_PORT,
+    OPTION_IO_URING,
+};
+
+static const option long_options[] =
+{
+    {"rx-ring",               no_argument,       nullptr, OPTION_RX_RING},
+    {"rx-ring-block-size",    required_argument, nullptr, OPTION_RX_RING_BLOCK_SIZE},
+    {"rx-ring-block-count",   required_argument, nullptr, OPTION_RX_RING_BLOCK_COUNT},
+    {"rx-ring-frame-size",    required_argument, nullptr, OPTION_RX_RING_FRAME_SIZE},
+    {"rx-ring-block-timeout", required_argument, nullptr, OPTION_RX_RING_BLOCK_TIMEOUT},
+    {"batch-size",            required_argument, nullptr, OPTION_BATCH_SIZE},
+    {"count",                 required_argument, nullptr, OPTION_COUNT},
+    {"duration",              required_argument, nullptr, OPTION_DURATION},
+    {"rate-pps",              required_argument, nullptr, OPTION_RATE_PPS},
+    {"rate-gbps",             required_argument, nullptr, OPTION_RATE_GBPS},
+    {"burst",                 required_argument, nullptr, OPTION_BURST},
+    {"latency",               no_argument,       nullptr, OPTION_LATENCY},
+    {"rx-threads",            required_argument, nullptr, OPTION_RX_THREADS},
+    {"fanout",                required_argument, nullptr, OPTION_FANOUT},
+    {"rx-cpus",               required_argument, nullptr, OPTION_RX_CPUS},
+    {"tx-cpu",                required_argument, nullptr, OPTION_TX_CPU},
+    {"pcap-in",               required_argument, nullptr, OPTION_PCAP_IN},
+    {"pcap-timing",           no_argument,       nullptr, OPTION_PCAP_TIMING},
+    {"pcap-out",              required_argument, nullptr, OPTION_PCAP_OUT},
+    {"no-filter",             no_argument,       nullptr, OPTION_NO_FILTER},
+    {"xdp",                   no_argument,       nullptr, OPTION_XDP},
+    {"xdp-queue",             required_argument, nullptr, OPTION_XDP_QUEUE},
+    {"xdp-copy",              no_argument,       nullptr, OPTION_XDP_COPY},
+    {"xdp-skb",               no_argument,       nullptr, OPTION_XDP_SKB},
+    {"soft-dut",              required_argument, nullptr, OPTION_SOFT_DUT},
+    {"soft-dut-transform",    required_argument, nullptr, OPTION_SOFT_DUT_TRANSFORM},
+    {"soft-dut-cpu",          required_argument, nullptr, OPTION_SOFT_DUT_CPU},
+    {"rx-timeout",            required_argument, nullptr, OPTION_RX_TIMEOUT},
+    {"benchmark",             no_argument,       nullptr, OPTION_BENCHMARK},
+    {"benchmark-sizes",       required_argument, nullptr, OPTION_BENCHMARK_SIZES},
+    {"benchmark-trial",       required_argument, nullptr, OPTION_BENCHMARK_TRIAL},
+    {"line-rate-gbps",        required_argument, nullptr, OPTION_LINE_RATE_GBPS},
+    {"benchmark-resolution",  required_argument, nullptr, OPTION_BENCHMARK_RESOLUTION},
+    {"benchmark-loss",        required_argument, nullptr, OPTION_BENCHMARK_LOSS},
+    {"benchmark-report",      required_argument, nullptr, OPTION_BENCHMARK_REPORT},
+    {"profile",               required_argument, nullptr, OPTION_PROFILE},
+    {"log-level",             required_argument, nullptr, OPTION_LOG_LEVEL},
+    {"log-file",              required_argument, nullptr, OPTION_LOG_FILE},
+    {"soak",                  no_argument,       nullptr, OPTION_SOAK},
+    {"soak-interval",         required_argument, nullptr, OPTION_SOAK_INTERVAL},
+    {"soak-metrics",          required_argument, nullptr, OPTION_SOAK_METRICS},
+    {"prometheus-port",       required_argument, nullptr, OPTION_PROMETHEUS_PORT},
+    {"io-uring",              no_argument,       nullptr, OPTION_IO_URING},
+    {nullptr,                 0,                 nullptr, 0}
+};
+
 options get_options(int argc, char** argv)
 {
     std::vector<std::string> receive_interfaces;
@@ -44,9 +270,49 @@ options get_options(int argc, char** argv)
     std::string dest_ip_addr;
     std::string dest_mac_addr;
     std::string port;
+    bool use_rx_ring = false;
+    rx_ring_config ring_config;
+    size_t batch_size = 0;
+    uint64_t packet_count = 0;
+    double duration_s = 0;
+    double rate_pps = 0;
+    double rate_gbps = 0;
+    size_t burst = 1;
+    bool measure_latency = false;
+    size_t rx_threads = 1;
+    int fanout_mode = PACKET_FANOUT_LB;
+    std::vector<int> rx_cpus;
+    int tx_cpu = -1;
+    std::string pcap_input;
+    bool pcap_timing = false;
+    std::string pcap_output;
+    bool use_receive_filter = true;
+    bool use_xdp = false;
+    uint32_t xdp_queue = 0;
+    xdp_config xdp_settings;
+    std::string soft_dut_ingress;
+    std::string soft_dut_egress;
+    std::string soft_dut_transform = "echo";
+    int soft_dut_cpu = -1;
+    int receive_timeout_ms = 3000;
+    bool benchmark = false;
+    std::vector<size_t> benchmark_frame_sizes = {64, 128, 256, 512, 1024, 1280, 1518};
+    double benchmark_trial_s = 2;
+    double line_rate_gbps = 10;
+    double benchmark_resolution = 1;
+    double benchmark_loss_tolerance = 0;
+    std::string benchmark_report = "benchmark";
+    std::string profile_path;
+    std::string log_level_arg;
+    std::string log_file;
+    bool soak = false;
+    double soak_interval_s = 1;
+    std::string soak_metrics;
+    int prometheus_port = 0;
+    bool use_uring = false;
 
     int input;
-    while ((input = getopt(argc, argv, "s:d:t:r:p:i:o:m:h")) != -1)
+    while ((input = getopt_long(argc, argv, "s:d:t:r:p:i:o:m:h", long_options, nullptr)) != -1)
     {
         switch (input)
         {
@@ -74,6 +340,157 @@ options get_options(int argc, char** argv)
             case 'o':
                 expected_outputs.emplace_back(optarg);
                 break;
+            case OPTION_RX_RING:
+                use_rx_ring = true;
+                break;
+            case OPTION_RX_RING_BLOCK_SIZE:
+                ring_config.block_size = std::stoul(optarg);
+                break;
+            case OPTION_RX_RING_BLOCK_COUNT:
+                ring_config.block_count = std::stoul(optarg);
+                break;
+            case OPTION_RX_RING_FRAME_SIZE:
+                ring_config.frame_size = std::stoul(optarg);
+                break;
+            case OPTION_RX_RING_BLOCK_TIMEOUT:
+                ring_config.block_timeout_ms = std::stoul(optarg);
+                break;
+            case OPTION_BATCH_SIZE:
+                batch_size = std::stoul(optarg);
+                break;
+            case OPTION_COUNT:
+                packet_count = std::stoull(optarg);
+                break;
+            case OPTION_DURATION:
+                duration_s = std::stod(optarg);
+                break;
+            case OPTION_RATE_PPS:
+                rate_pps = std::stod(optarg);
+                break;
+            case OPTION_RATE_GBPS:
+                rate_gbps = std::stod(optarg);
+                break;
+            case OPTION_BURST:
+                burst = std::stoul(optarg);
+                break;
+            case OPTION_LATENCY:
+                measure_latency = true;
+                break;
+            case OPTION_RX_THREADS:
+                rx_threads = std::stoul(optarg);
+                break;
+            case OPTION_FANOUT:
+                fanout_mode = parse_fanout_mode(optarg);
+                if (fanout_mode < 0)
+                {
+                    std::cout << "Unknown fanout mode " << optarg << std::endl;
+                    exit(-1);
+                }
+                break;
+            case OPTION_RX_CPUS:
+                rx_cpus = parse_cpu_list(optarg);
+                break;
+            case OPTION_TX_CPU:
+                tx_cpu = std::stoi(optarg);
+                break;
+            case OPTION_PCAP_IN:
+                pcap_input = std::string(optarg);
+                break;
+            case OPTION_PCAP_TIMING:
+                pcap_timing = true;
+                break;
+            case OPTION_PCAP_OUT:
+                pcap_output = std::string(optarg);
+                break;
+            case OPTION_NO_FILTER:
+                use_receive_filter = false;
+                break;
+            case OPTION_XDP:
+                use_xdp = true;
+                break;
+            case OPTION_XDP_QUEUE:
+                xdp_queue = std::stoul(optarg);
+                break;
+            case OPTION_XDP_COPY:
+                xdp_settings.force_copy = true;
+                break;
+            case OPTION_XDP_SKB:
+                xdp_settings.force_skb = true;
+                break;
+            case OPTION_SOFT_DUT:
+            {
+                const std::string interfaces(optarg);
+                const size_t comma = interfaces.find(',');
+                if (comma == std::string::npos)
+                {
+                    std::cout << "--soft-dut takes two interfaces, INGRESS,EGRESS" << std::endl;
+                    exit(-1);
+                }
+                soft_dut_ingress = interfaces.substr(0, comma);
+                soft_dut_egress = interfaces.substr(comma + 1);
+                break;
+            }
+            case OPTION_SOFT_DUT_TRANSFORM:
+                soft_dut_transform = std::string(optarg);
+                if (!find_payload_transform(soft_dut_transform))
+                {
+                    std::cout << "Unknown soft DUT transform " << optarg << " (expected one of " << payload_transform_names() << ")" << std::endl;
+                    exit(-1);
+                }
+                break;
+            case OPTION_SOFT_DUT_CPU:
+                soft_dut_cpu = std::stoi(optarg);
+                break;
+            case OPTION_RX_TIMEOUT:
+                receive_timeout_ms = std::stoi(optarg);
+                break;
+            case OPTION_BENCHMARK:
+                benchmark = true;
+                break;
+            case OPTION_BENCHMARK_SIZES:
+                benchmark_frame_sizes.clear();
+                for (const std::string& size: split(optarg, ','))
+                    benchmark_frame_sizes.push_back(std::stoul(size));
+                break;
+            case OPTION_BENCHMARK_TRIAL:
+                benchmark_trial_s = std::stod(optarg);
+                break;
+            case OPTION_LINE_RATE_GBPS:
+                line_rate_gbps = std::stod(optarg);
+                break;
+            case OPTION_BENCHMARK_RESOLUTION:
+                benchmark_resolution = std::stod(optarg);
+                break;
+            case OPTION_BENCHMARK_LOSS:
+                benchmark_loss_tolerance = std::stod(optarg);
+                break;
+            case OPTION_BENCHMARK_REPORT:
+                benchmark_report = std::string(optarg);
+                break;
+            case OPTION_PROFILE:
+                profile_path = std::string(optarg);
+                break;
+            case OPTION_LOG_LEVEL:
+                log_level_arg = std::string(optarg);
+                break;
+            case OPTION_LOG_FILE:
+                log_file = std::string(optarg);
+                break;
+            case OPTION_SOAK:
+                soak = true;
+                break;
+            case OPTION_SOAK_INTERVAL:
+                soak_interval_s = std::stod(optarg);
+                break;
+            case OPTION_SOAK_METRICS:
+                soak_metrics = std::string(optarg);
+                break;
+            case OPTION_PROMETHEUS_PORT:
+                prometheus_port = std::stoi(optarg);
+                break;
+            case OPTION_IO_URING:
+                use_uring = true;
+                break;
             case 'h':
             default:
                 print_help();
@@ -99,6 +516,108 @@ options get_options(int argc, char** argv)
         exit(-1);
     }
 
+    if (rate_pps > 0 && rate_gbps > 0)
+    {
+        std::cout << "Only one of --rate-pps and --rate-gbps can be given" << std::endl;
+        exit(-1);
+    }
+
+    if ((packet_count > 0 || duration_s > 0 || soak) && inputs.empty() && pcap_input.empty() && profile_path.empty())
+    {
+        std::cout << "Load mode needs at least one input to replay" << std::endl;
+        exit(-1);
+    }
+
+    // AF_XDP frames go out exactly as we build them, so there's no ARP to fill the Ethernet header in
+    if (use_xdp && dest_mac_addr.empty())
+    {
+        std::cout << "--xdp needs the destination MAC address (-m)" << std::endl;
+        exit(-1);
+    }
+
+    if (use_xdp && !pcap_input.empty())
+    {
+        std::cout << "--xdp can't replay a pcap file" << std::endl;
+        exit(-1);
+    }
+
+    if (use_uring && (use_xdp || use_rx_ring))
+    {
+        std::cout << "--io-uring can't be combined with --xdp or --rx-ring" << std::endl;
+        exit(-1);
+    }
+
+    if (benchmark && !pcap_input.empty())
+    {
+        std::cout << "--benchmark sends its own frames, so it can't replay a pcap file" << std::endl;
+        exit(-1);
+    }
+
+    if (benchmark && (benchmark_frame_sizes.empty() || benchmark_trial_s <= 0 || line_rate_gbps <= 0 || benchmark_resolution <= 0))
+    {
+        std::cout << "--benchmark needs frame sizes, and a trial duration, line rate and resolution above 0" << std::endl;
+        exit(-1);
+    }
+
+    if (!profile_path.empty() && (!inputs.empty() || !expected_outputs.empty()))
+    {
+        std::cout << "--profile replaces the inputs, so it can't be given -i or -o" << std::endl;
+        exit(-1);
+    }
+
+    if (!profile_path.empty() && (!pcap_input.empty() || benchmark))
+    {
+        std::cout << "--profile can't be combined with --pcap-in or --benchmark" << std::endl;
+        exit(-1);
+    }
+
+    if (soak && benchmark)
+    {
+        std::cout << "--soak and --benchmark can't be combined" << std::endl;
+        exit(-1);
+    }
+
+    if (soak && soak_interval_s <= 0)
+    {
+        std::cout << "--soak-interval has to be above 0" << std::endl;
+        exit(-1);
+    }
+
+    if (!soak && (!soak_metrics.empty() || prometheus_port != 0))
+    {
+        std::cout << "--soak-metrics and --prometheus-port only apply to --soak" << std::endl;
+        exit(-1);
+    }
+
+    if (prometheus_port < 0 || prometheus_port > 65535)
+    {
+        std::cout << "--prometheus-port has to be a port number" << std::endl;
+        exit(-1);
+    }
+
+    traffic_profile profile{};
+    if (!profile_path.empty())
+    {
+        profile = load_traffic_profile(profile_path, single_flow(src_ip_addr, dest_ip_addr, static_cast<uint16_t>(std::stoi(port))));
+
+        // A profile is always sent in load mode, so that every packet is stamped and loss is exact
+        if (packet_count == 0 && duration_s == 0 && !soak) packet_count = profile.packet_count;
+    }
+
+    // At load rates, a record per frame would be more than anyone could read (or the writer could keep
+    // up with), so only the errors are logged unless asked otherwise
+    const bool load_mode = packet_count > 0 || duration_s > 0 || !pcap_input.empty() || benchmark || soak;
+    log_level verbosity = load_mode ? log_level::errors : log_level::frames;
+    if (!log_level_arg.empty() && !parse_log_level(log_level_arg, verbosity))
+    {
+        std::cout << "Unknown log level " << log_level_arg << "; expected quiet, errors, frames or dump" << std::endl;
+        exit(-1);
+    }
+
+    if (burst == 0) burst = 1;
+    if (batch_size > 0) xdp_settings.batch_size = static_cast<uint32_t>(batch_size);
+    if (rx_threads == 0) rx_threads = 1;
+
     return options
     {
         .receive_interfaces = std::move(receive_interfaces),
@@ -108,6 +627,46 @@ options get_options(int argc, char** argv)
         .dest_mac_addr = std::move(dest_mac_addr),
         .inputs = std::move(inputs),
         .expected_outputs = std::move(expected_outputs),
-        .port = std::stoi(port)
+        .port = std::stoi(port),
+        .use_rx_ring = use_rx_ring,
+        .ring_config = ring_config,
+        .batch_size = batch_size,
+        .packet_count = packet_count,
+        .duration_s = duration_s,
+        .rate_pps = rate_pps,
+        .rate_gbps = rate_gbps,
+        .burst = burst,
+        .measure_latency = measure_latency,
+        .rx_threads = rx_threads,
+        .fanout_mode = fanout_mode,
+        .rx_cpus = std::move(rx_cpus),
+        .tx_cpu = tx_cpu,
+        .pcap_input = std::move(pcap_input),
+        .pcap_timing = pcap_timing,
+        .pcap_output = std::move(pcap_output),
+        .use_receive_filter = use_receive_filter,
+        .use_xdp = use_xdp,
+        .use_uring = use_uring,
+        .xdp_queue = xdp_queue,
+        .xdp_settings = xdp_settings,
+        .soft_dut_ingress = std::move(soft_dut_ingress),
+        .soft_dut_egress = std::move(soft_dut_egress),
+        .soft_dut_transform = std::move(soft_dut_transform),
+        .soft_dut_cpu = soft_dut_cpu,
+        .receive_timeout_ms = receive_timeout_ms,
+        .benchmark = benchmark,
+        .benchmark_frame_sizes = std::move(benchmark_frame_sizes),
+        .benchmark_trial_s = benchmark_trial_s,
+        .line_rate_gbps = line_rate_gbps,
+        .benchmark_resolution = benchmark_resolution,
+        .benchmark_loss_tolerance = benchmark_loss_tolerance,
+        .benchmark_report = std::move(benchmark_report),
+        .profile = std::move(profile),
+        .verbosity = verbosity,
+        .log_file = std::move(log_file),
+        .soak = soak,
+        .soak_interval_s = soak_interval_s,
+        .soak_metrics = std::move(soak_metrics),
+        .prometheus_port = prometheus_port
     };
 }
\ No newline at end of file
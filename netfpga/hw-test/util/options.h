@@ -5,9 +5,15 @@
 #ifndef OPTIONS_H
 #define OPTIONS_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "../network/rx_ring.h"
+#include "../network/xdp.h"
+#include "../traffic/profile.h"
+#include "log.h"
+
 typedef struct
 {
     std::vector<std::string> receive_interfaces;
@@ -18,8 +24,68 @@ typedef struct
     std::vector<std::string> inputs;
     std::vector<std::string> expected_outputs;
     int port;
+    bool use_rx_ring;
+    rx_ring_config ring_config;
+    size_t batch_size;
+    uint64_t packet_count;
+    double duration_s;
+    double rate_pps;
+    double rate_gbps;
+    size_t burst;
+    bool measure_latency;
+    size_t rx_threads;
+    int fanout_mode;
+    std::vector<int> rx_cpus;
+    int tx_cpu;
+    std::string pcap_input;
+    bool pcap_timing;
+    std::string pcap_output;
+    bool use_receive_filter;
+    bool use_xdp;
+    bool use_uring;
+    uint32_t xdp_queue;
+    xdp_config xdp_settings;
+    std::string soft_dut_ingress;
+    std::string soft_dut_egress;
+    std::string soft_dut_transform;
+    int soft_dut_cpu;
+    int receive_timeout_ms;
+    bool benchmark;
+    std::vector<size_t> benchmark_frame_sizes;
+    double benchmark_trial_s;
+    double line_rate_gbps;
+    double benchmark_resolution;
+    double benchmark_loss_tolerance;
+    std::string benchmark_report;
+    traffic_profile profile;
+    log_level verbosity;
+    std::string log_file;
+    bool soak;
+    double soak_interval_s;
+    std::string soak_metrics;
+    int prometheus_port;
 } options;
 
+// A profile's packets replace the inputs
+inline bool uses_profile(const options& opts) { return !opts.profile.path.empty(); }
+
+// Load mode replays the inputs in a loop, for a packet count or a duration, instead of once each.
+// Replaying a pcap trace works the same way, even when it's only replayed once, and so does a soak,
+// which (without a count or duration) goes on until it's interrupted.
+inline bool is_load_mode(const options& opts)
+{
+    return opts.packet_count > 0 || opts.duration_s > 0 || !opts.pcap_input.empty() || opts.soak;
+}
+
+// Packets carry a stamp (see network/stamp.h) when we're measuring latency, in load mode (so loss,
+// duplication and reordering can be told apart), and when the receive side is fanned out over
+// several threads - which then can't rely on arrival order to tell which input a frame came from.
+// A replayed trace is sent exactly as captured, so it's never stamped.
+inline bool stamp_packets(const options& opts)
+{
+    return opts.pcap_input.empty() && (opts.measure_latency || is_load_mode(opts) || opts.rx_threads > 1);
+}
+
 void print_options(const options& opts);
 options get_options(int argc, char** argv);
 
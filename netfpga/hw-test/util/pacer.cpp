@@ -0,0 +1,58 @@
+#include "pacer.h"
+
+#include <algorithm>
+#include <ctime>
+
+uint64_t monotonic_ns()
+{
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+}
+
+void wait_until_ns(uint64_t deadline_ns)
+{
+    constexpr uint64_t spin_ns = 100000;
+
+    uint64_t now = monotonic_ns();
+    if (now + spin_ns < deadline_ns)
+    {
+        const uint64_t sleep_ns = deadline_ns - now - spin_ns;
+        timespec duration{};
+        duration.tv_sec = static_cast<time_t>(sleep_ns / 1000000000ull);
+        duration.tv_nsec = static_cast<long>(sleep_ns % 1000000000ull);
+        nanosleep(&duration, nullptr);
+    }
+
+    while (monotonic_ns() < deadline_ns) {}
+}
+
+pacer create_pacer(double tokens_per_second, double bucket_size)
+{
+    return pacer
+    {
+        .tokens_per_ns = tokens_per_second / 1e9,
+        .bucket_size = bucket_size,
+        .tokens = bucket_size,
+        .last_refill_ns = monotonic_ns()
+    };
+}
+
+static void refill(pacer& p, uint64_t now)
+{
+    p.tokens = std::min(p.bucket_size, p.tokens + static_cast<double>(now - p.last_refill_ns) * p.tokens_per_ns);
+    p.last_refill_ns = now;
+}
+
+void pacer_wait(pacer& p, double cost)
+{
+    if (p.tokens_per_ns <= 0) return;
+
+    const double needed = std::min(cost, p.bucket_size);
+
+    refill(p, monotonic_ns());
+    while (p.tokens < needed)
+        refill(p, monotonic_ns());
+
+    p.tokens -= cost;
+}
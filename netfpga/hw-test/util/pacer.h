@@ -0,0 +1,33 @@
+#ifndef TRAFFIC_GENERATOR_PACER_H
+#define TRAFFIC_GENERATOR_PACER_H
+
+#include <cstdint>
+
+// CLOCK_MONOTONIC in nanoseconds. Served from the vDSO, so it costs a few tens of nanoseconds and no
+// syscall - cheap enough to spin on.
+uint64_t monotonic_ns();
+
+// Waits until monotonic_ns() reaches deadline_ns: sleeps through most of a long wait, then spins the
+// last stretch, since waking from a sleep can take tens of microseconds
+void wait_until_ns(uint64_t deadline_ns);
+
+// Token bucket: tokens accrue at a fixed rate up to bucket_size, and sending something costs tokens.
+// A bucket holding several packets' worth lets that many go out back to back (a burst) before the
+// pacer starts spacing them out.
+struct pacer
+{
+    double tokens_per_ns;
+    double bucket_size;
+    double tokens;
+    uint64_t last_refill_ns;
+};
+
+// tokens_per_second of 0 makes an unpaced pacer, whose pacer_wait never waits
+pacer create_pacer(double tokens_per_second, double bucket_size);
+
+// Busy-waits until the bucket can cover cost (or is full, if cost is larger than the whole bucket),
+// then takes cost from it. Any shortfall is carried over as debt, so a large cost just delays the
+// next call rather than breaking the average rate.
+void pacer_wait(pacer& p, double cost);
+
+#endif //TRAFFIC_GENERATOR_PACER_H
@@ -0,0 +1,417 @@
+#include "pcap.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr uint32_t PCAP_MAGIC_MICROSECONDS = 0xa1b2c3d4;
+static constexpr uint32_t PCAP_MAGIC_NANOSECONDS  = 0xa1b23c4d;
+static constexpr uint32_t PCAPNG_SECTION_HEADER   = 0x0a0d0d0a;
+static constexpr uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1a2b3c4d;
+
+static constexpr uint32_t PCAPNG_INTERFACE_DESCRIPTION = 1;
+static constexpr uint32_t PCAPNG_SIMPLE_PACKET         = 3;
+static constexpr uint32_t PCAPNG_ENHANCED_PACKET       = 6;
+static constexpr uint16_t PCAPNG_OPTION_END            = 0;
+static constexpr uint16_t PCAPNG_OPTION_TSRESOL        = 9;
+
+static constexpr size_t PCAP_CHUNK_SIZE = 1 << 20;
+static constexpr size_t PCAP_CHUNK_LIMIT = 64;
+
+static uint16_t read16(const pcap_reader& reader, size_t offset)
+{
+    uint16_t value;
+    std::memcpy(&value, reader.map + offset, sizeof(value));
+    return reader.swapped ? __builtin_bswap16(value) : value;
+}
+
+static uint32_t read32(const pcap_reader& reader, size_t offset)
+{
+    uint32_t value;
+    std::memcpy(&value, reader.map + offset, sizeof(value));
+    return reader.swapped ? __builtin_bswap32(value) : value;
+}
+
+static uint64_t ticks_to_ns(uint64_t ticks, uint64_t ticks_per_second)
+{
+    return (ticks / ticks_per_second) * 1000000000ull + (ticks % ticks_per_second) * 1000000000ull / ticks_per_second;
+}
+
+pcap_reader open_pcap(const std::string& path)
+{
+    pcap_reader reader{};
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        perror(("Failed to open " + path).c_str());
+        exit(-1);
+    }
+
+    struct stat status{};
+    if (fstat(fd, &status) < 0)
+    {
+        perror("fstat");
+        exit(-1);
+    }
+
+    reader.map_size = static_cast<size_t>(status.st_size);
+    if (reader.map_size < 24)
+    {
+        std::cerr << path << " is too short to be a pcap file" << std::endl;
+        exit(-1);
+    }
+
+    void* map = mmap(nullptr, reader.map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror("Failed to map pcap file");
+        exit(-1);
+    }
+
+    // Records are read front to back, once; let the kernel read ahead aggressively and drop pages behind us
+    madvise(map, reader.map_size, MADV_SEQUENTIAL);
+    reader.map = static_cast<const uint8_t*>(map);
+
+    uint32_t magic;
+    std::memcpy(&magic, reader.map, sizeof(magic));
+
+    if (magic == PCAPNG_SECTION_HEADER)
+    {
+        // The section header block parses itself (and sets the byte order) in next_pcap_record
+        reader.pcapng = true;
+        reader.first_record = 0;
+    }
+    else
+    {
+        if (magic == PCAP_MAGIC_MICROSECONDS || magic == PCAP_MAGIC_NANOSECONDS)
+            reader.swapped = false;
+        else if (__builtin_bswap32(magic) == PCAP_MAGIC_MICROSECONDS || __builtin_bswap32(magic) == PCAP_MAGIC_NANOSECONDS)
+            reader.swapped = true;
+        else
+        {
+            std::cerr << path << " is neither a pcap nor a pcapng file" << std::endl;
+            exit(-1);
+        }
+
+        const uint32_t native_magic = reader.swapped ? __builtin_bswap32(magic) : magic;
+        reader.ticks_per_second = native_magic == PCAP_MAGIC_NANOSECONDS ? 1000000000ull : 1000000ull;
+
+        // The upper bits of the link type field carry FCS information we don't need
+        reader.link_type = read32(reader, 20) & 0xffff;
+        reader.first_record = 24;
+    }
+
+    reader.offset = reader.first_record;
+    return reader;
+}
+
+void close_pcap(pcap_reader& reader)
+{
+    if (reader.map) munmap(const_cast<uint8_t*>(reader.map), reader.map_size);
+    reader.map = nullptr;
+}
+
+void rewind_pcap(pcap_reader& reader)
+{
+    reader.offset = reader.first_record;
+    if (reader.pcapng) reader.interfaces.clear();
+}
+
+static bool next_classic_record(pcap_reader& reader, pcap_record& record)
+{
+    constexpr size_t record_header_size = 16;
+
+    if (reader.offset + record_header_size > reader.map_size) return false;
+
+    const uint32_t seconds = read32(reader, reader.offset);
+    const uint32_t fraction = read32(reader, reader.offset + 4);
+    const uint32_t captured = read32(reader, reader.offset + 8);
+
+    // A record cut off by the end of the file (a capture that was killed mid-write) ends the trace
+    if (reader.offset + record_header_size + captured > reader.map_size) return false;
+
+    record.data = reader.map + reader.offset + record_header_size;
+    record.size = captured;
+    record.timestamp_ns = static_cast<uint64_t>(seconds) * 1000000000ull + ticks_to_ns(fraction, reader.ticks_per_second);
+    record.link_type = reader.link_type;
+
+    reader.offset += record_header_size + captured;
+    return true;
+}
+
+static void parse_section_header(pcap_reader& reader, size_t block)
+{
+    uint32_t byte_order;
+    std::memcpy(&byte_order, reader.map + block + 8, sizeof(byte_order));
+    reader.swapped = byte_order != PCAPNG_BYTE_ORDER_MAGIC;
+
+    // Interface ids are only meaningful within their section
+    reader.interfaces.clear();
+}
+
+static void parse_interface_description(pcap_reader& reader, size_t block, size_t block_length)
+{
+    pcapng_interface interface{};
+    interface.link_type = read16(reader, block + 8);
+    interface.ticks_per_second = 1000000;
+
+    size_t option = block + 16;
+    const size_t options_end = block + block_length - 4;
+    while (option + 4 <= options_end)
+    {
+        const uint16_t code = read16(reader, option);
+        const uint16_t length = read16(reader, option + 2);
+        if (code == PCAPNG_OPTION_END) break;
+
+        if (code == PCAPNG_OPTION_TSRESOL && length >= 1 && option + 5 <= options_end)
+        {
+            // The top bit picks a power of two rather than a power of ten
+            const uint8_t resolution = reader.map[option + 4];
+            const uint8_t exponent = resolution & 0x7f;
+            uint64_t ticks = 1;
+            for (uint8_t i = 0; i < exponent && ticks < UINT64_MAX / 10; ++i) ticks *= (resolution & 0x80) ? 2 : 10;
+            interface.ticks_per_second = ticks;
+        }
+
+        option += 4 + ((length + 3u) & ~3u);
+    }
+
+    reader.interfaces.push_back(interface);
+}
+
+static bool next_pcapng_record(pcap_reader& reader, pcap_record& record)
+{
+    while (reader.offset + 12 <= reader.map_size)
+    {
+        const size_t block = reader.offset;
+
+        uint32_t type;
+        std::memcpy(&type, reader.map + block, sizeof(type));
+
+        // The section header's type reads the same in either byte order, but its length doesn't - so
+        // the byte order has to be settled before reading that
+        if (type == PCAPNG_SECTION_HEADER) parse_section_header(reader, block);
+        else type = read32(reader, block);
+
+        const uint32_t block_length = read32(reader, block + 4);
+        if (block_length < 12 || block + block_length > reader.map_size) return false;
+
+        reader.offset += block_length;
+
+        if (type == PCAPNG_INTERFACE_DESCRIPTION && block_length >= 20)
+        {
+            parse_interface_description(reader, block, block_length);
+        }
+        else if (type == PCAPNG_ENHANCED_PACKET && block_length >= 32)
+        {
+            const uint32_t interface_id = read32(reader, block + 8);
+            if (interface_id >= reader.interfaces.size()) continue;
+
+            const pcapng_interface& interface = reader.interfaces[interface_id];
+            const uint64_t ticks = (static_cast<uint64_t>(read32(reader, block + 12)) << 32) | read32(reader, block + 16);
+            const uint32_t captured = read32(reader, block + 20);
+            if (28 + captured + 4 > block_length) return false;
+
+            record.data = reader.map + block + 28;
+            record.size = captured;
+            record.timestamp_ns = ticks_to_ns(ticks, interface.ticks_per_second);
+            record.link_type = interface.link_type;
+            return true;
+        }
+        else if (type == PCAPNG_SIMPLE_PACKET && block_length >= 16 && !reader.interfaces.empty())
+        {
+            // Simple packet blocks have no timestamp, and always belong to the first interface
+            const uint32_t original = read32(reader, block + 8);
+
+            record.data = reader.map + block + 12;
+            record.size = std::min<size_t>(original, block_length - 16);
+            record.timestamp_ns = 0;
+            record.link_type = reader.interfaces[0].link_type;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool next_pcap_record(pcap_reader& reader, pcap_record& record)
+{
+    return reader.pcapng ? next_pcapng_record(reader, record) : next_classic_record(reader, record);
+}
+
+bool pcap_record_ipv4(const pcap_record& record, const uint8_t*& ip_packet, size_t& ip_packet_size)
+{
+    size_t header_size = 0;
+    size_t type_offset = 0;
+
+    switch (record.link_type)
+    {
+        case PCAP_LINKTYPE_RAW:
+        case PCAP_LINKTYPE_IPV4:
+            break;
+        case PCAP_LINKTYPE_ETHERNET:
+            header_size = 14;
+            type_offset = 12;
+            break;
+        case PCAP_LINKTYPE_LINUX_SLL:
+            header_size = 16;
+            type_offset = 14;
+            break;
+        default:
+            return false;
+    }
+
+    if (record.size < header_size) return false;
+
+    if (header_size > 0)
+    {
+        uint16_t ether_type = (record.data[type_offset] << 8) | record.data[type_offset + 1];
+
+        // Look through a single 802.1Q tag
+        if (ether_type == 0x8100 && record.link_type == PCAP_LINKTYPE_ETHERNET && record.size >= 18)
+        {
+            ether_type = (record.data[16] << 8) | record.data[17];
+            header_size += 4;
+        }
+
+        if (ether_type != 0x0800) return false;
+    }
+
+    ip_packet = record.data + header_size;
+    ip_packet_size = record.size - header_size;
+
+    // 20 bytes is the smallest IPv4 header there is
+    return ip_packet_size >= 20 && (ip_packet[0] >> 4) == 4;
+}
+
+static void write_all(FILE* file, const uint8_t* data, size_t size)
+{
+    if (fwrite(data, 1, size, file) != size)
+    {
+        perror("Failed to write pcap file");
+        exit(-1);
+    }
+}
+
+static void pcap_writer_thread(pcap_writer& writer)
+{
+    std::unique_lock<std::mutex> lock(writer.mutex);
+
+    while (true)
+    {
+        writer.condition.wait(lock, [&] { return !writer.full.empty() || writer.closing; });
+        if (writer.full.empty()) break;
+
+        pcap_chunk chunk = std::move(writer.full.front());
+        writer.full.pop_front();
+
+        // The disk write happens with the lock dropped, so receivers can keep handing chunks over
+        lock.unlock();
+        write_all(writer.file, chunk.data.data(), chunk.data.size());
+        chunk.data.clear();
+        lock.lock();
+
+        writer.free.push_back(std::move(chunk));
+        writer.condition.notify_all();
+    }
+}
+
+void open_pcap_writer(pcap_writer& writer, const std::string& path)
+{
+    writer.file = fopen(path.c_str(), "wb");
+    if (!writer.file)
+    {
+        perror(("Failed to create " + path).c_str());
+        exit(-1);
+    }
+
+    // Nanosecond resolution, Ethernet, no practical snap length
+    struct
+    {
+        uint32_t magic;
+        uint16_t version_major;
+        uint16_t version_minor;
+        int32_t this_zone;
+        uint32_t sigfigs;
+        uint32_t snap_length;
+        uint32_t link_type;
+    } header{PCAP_MAGIC_NANOSECONDS, 2, 4, 0, 0, 262144, PCAP_LINKTYPE_ETHERNET};
+
+    write_all(writer.file, reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+
+    writer.chunks_outstanding = 0;
+    writer.closing = false;
+    writer.thread = std::thread(pcap_writer_thread, std::ref(writer));
+}
+
+static void take_chunk(pcap_writer& writer, pcap_chunk& chunk)
+{
+    std::unique_lock<std::mutex> lock(writer.mutex);
+
+    if (writer.free.empty() && writer.chunks_outstanding >= PCAP_CHUNK_LIMIT)
+        writer.condition.wait(lock, [&] { return !writer.free.empty(); });
+
+    if (!writer.free.empty())
+    {
+        chunk = std::move(writer.free.back());
+        writer.free.pop_back();
+    }
+    else
+    {
+        ++writer.chunks_outstanding;
+    }
+
+    chunk.data.reserve(PCAP_CHUNK_SIZE);
+}
+
+void flush_pcap_chunk(pcap_writer& writer, pcap_chunk& chunk)
+{
+    if (chunk.data.empty()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(writer.mutex);
+        writer.full.push_back(std::move(chunk));
+    }
+    writer.condition.notify_all();
+
+    chunk = pcap_chunk{};
+}
+
+void write_pcap_record(pcap_writer& writer, pcap_chunk& chunk, const uint8_t* frame, size_t frame_size, uint64_t timestamp_ns)
+{
+    const size_t record_size = 16 + frame_size;
+
+    if (!chunk.data.empty() && chunk.data.size() + record_size > PCAP_CHUNK_SIZE) flush_pcap_chunk(writer, chunk);
+    if (chunk.data.capacity() == 0) take_chunk(writer, chunk);
+
+    const uint32_t record_header[4] =
+    {
+        static_cast<uint32_t>(timestamp_ns / 1000000000ull),
+        static_cast<uint32_t>(timestamp_ns % 1000000000ull),
+        static_cast<uint32_t>(frame_size),
+        static_cast<uint32_t>(frame_size),
+    };
+
+    const uint8_t* header_bytes = reinterpret_cast<const uint8_t*>(record_header);
+    chunk.data.insert(chunk.data.end(), header_bytes, header_bytes + sizeof(record_header));
+    chunk.data.insert(chunk.data.end(), frame, frame + frame_size);
+}
+
+void close_pcap_writer(pcap_writer& writer)
+{
+    {
+        std::lock_guard<std::mutex> lock(writer.mutex);
+        writer.closing = true;
+    }
+    writer.condition.notify_all();
+
+    writer.thread.join();
+    fclose(writer.file);
+}
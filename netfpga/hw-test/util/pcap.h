@@ -0,0 +1,104 @@
+#ifndef TRAFFIC_GENERATOR_PCAP_H
+#define TRAFFIC_GENERATOR_PCAP_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Link types we know how to find the IPv4 packet in
+constexpr uint32_t PCAP_LINKTYPE_ETHERNET  = 1;
+constexpr uint32_t PCAP_LINKTYPE_RAW       = 101;
+constexpr uint32_t PCAP_LINKTYPE_LINUX_SLL = 113;
+constexpr uint32_t PCAP_LINKTYPE_IPV4      = 228;
+
+// One captured packet, pointing straight into the mapped file
+struct pcap_record
+{
+    const uint8_t* data;
+    size_t size;
+    uint64_t timestamp_ns;
+    uint32_t link_type;
+};
+
+struct pcapng_interface
+{
+    uint32_t link_type;
+    uint64_t ticks_per_second;
+};
+
+// Reads a pcap or pcapng file through a read-only mapping, so records are handed out in place and a
+// trace of any size costs no more than the pages being walked. Either byte order is handled, as are
+// the microsecond and nanosecond flavours of classic pcap and per-interface timestamp resolution in
+// pcapng.
+struct pcap_reader
+{
+    const uint8_t* map;
+    size_t map_size;
+    size_t offset;
+    size_t first_record;
+
+    bool pcapng;
+    bool swapped;
+
+    // Classic pcap: one link type and resolution for the whole file
+    uint32_t link_type;
+    uint64_t ticks_per_second;
+
+    // pcapng: one entry per interface description block in the current section
+    std::vector<pcapng_interface> interfaces;
+};
+
+pcap_reader open_pcap(const std::string& path);
+void close_pcap(pcap_reader& reader);
+
+// Fills record with the next packet in the file. Returns false at the end of the file.
+bool next_pcap_record(pcap_reader& reader, pcap_record& record);
+
+// Starts again from the first packet
+void rewind_pcap(pcap_reader& reader);
+
+// Points ip_packet at the IPv4 packet inside record, skipping whatever link layer header its link
+// type has. Returns false if the record isn't IPv4.
+bool pcap_record_ipv4(const pcap_record& record, const uint8_t*& ip_packet, size_t& ip_packet_size);
+
+// Writes a nanosecond-resolution Ethernet pcap from a thread of its own, so capturing never blocks a
+// receiver on the disk. Receivers fill chunks of records and hand over whole chunks, so the lock is
+// taken once per chunk rather than once per frame; spent chunks are recycled. Only when every chunk
+// is waiting on the disk does a receiver have to wait for one.
+struct pcap_chunk
+{
+    std::vector<uint8_t> data;
+};
+
+struct pcap_writer
+{
+    FILE* file;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<pcap_chunk> full;
+    std::vector<pcap_chunk> free;
+    size_t chunks_outstanding;
+    bool closing;
+};
+
+// Creates path and starts the writer thread. The writer isn't movable, since its thread refers to it.
+void open_pcap_writer(pcap_writer& writer, const std::string& path);
+
+// Appends a record to chunk, handing the chunk to the writer first if it's full. A fresh chunk is
+// taken from the writer as needed.
+void write_pcap_record(pcap_writer& writer, pcap_chunk& chunk, const uint8_t* frame, size_t frame_size, uint64_t timestamp_ns);
+
+// Hands over whatever is in chunk
+void flush_pcap_chunk(pcap_writer& writer, pcap_chunk& chunk);
+
+// Writes everything that's been handed over, stops the thread and closes the file
+void close_pcap_writer(pcap_writer& writer);
+
+#endif //TRAFFIC_GENERATOR_PCAP_H
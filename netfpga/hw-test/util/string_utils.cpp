@@ -9,6 +9,8 @@
 
 std::string join(const std::vector<std::string>& arr, const std::string& delim)
 {
+    if (arr.empty()) return "";
+
     return std::accumulate
     (
         std::next(arr.begin()),
@@ -21,4 +23,15 @@ std::string join(const std::vector<std::string>& arr, const std::string& delim)
 std::string vec_to_string(const std::vector<std::string>& arr)
 {
     return "[" + join(arr, ", ") + "]";
-}
\ No newline at end of file
+}
+
+std::vector<std::string> split(const std::string& str, char delim)
+{
+    std::vector<std::string> parts;
+    std::stringstream stream(str);
+    std::string part;
+    while (std::getline(stream, part, delim))
+        parts.push_back(part);
+
+    return parts;
+}
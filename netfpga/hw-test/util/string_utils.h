@@ -10,5 +10,6 @@
 
 std::string join(const std::vector<std::string>& arr, const std::string& delim);
 std::string vec_to_string(const std::vector<std::string>& arr);
+std::vector<std::string> split(const std::string& str, char delim);
 
 #endif //STRING_UTILS_H
@@ -1,12 +1,28 @@
 #include "Vpacket_body_processor.h"
 #include "util/options.h"
 #include "util/hex.h"
+#include "util/profiler.h"
+#include "util/reference.h"
+#include "util/stall.h"
+#include "util/trace.h"
 #include <verilated.h>
+
+// Verilator defines VM_TRACE_FST when the model's built with --trace-fst rather than --trace. FST is
+// compressed, and much cheaper to write, but a model can only be traced in the one format.
+#if VM_TRACE_FST
+#include <verilated_fst_c.h>
+using Waveform = VerilatedFstC;
+#else
 #include <verilated_vcd_c.h>
+using Waveform = VerilatedVcdC;
+#endif
 
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <iomanip>
 #include <iostream>
@@ -19,35 +35,60 @@
 using Wire256 = std::array<uint32_t, 8>;
 using Wire32  = uint32_t;
 
-static VerilatedVcdC* waveform = nullptr;
+static Waveform* waveform = nullptr;
+
+// Whether the current cycle is dumped to the waveform, as the trace gate decides
+static trace_gate trace = full_trace_gate();
+static bool tracing = false;
+
+// Quiet mode: no beat is formatted or printed unless it fails to match, so a long simulation runs as
+// fast as the model does
+static bool quiet = false;
+
+// The golden model the kernel's checked against, if any, stepped along with it (see reference.h)
+static reference_model* reference = nullptr;
 
 // Simple simulation time for Verilator
 static vluint64_t sim_time = 0;
 double sc_time_stamp() { return sim_time; }
 
+// Gives the reference model the clock edge the kernel's about to see
+static void step_reference(Vpacket_body_processor* top)
+{
+    if (top->reset) reference_reset(*reference);
+    else if (top->enable) reference_cycle(*reference, top->i__024valid, top->i__024data, top->i__024keep, top->i__024last);
+}
+
 // One clock tick: 0 -> 1 -> 0 with evals
 static void tick(Vpacket_body_processor* top)
 {
+    if (reference) step_reference(top);
+
     top->clock = 1;
     top->eval();
-    if (waveform) waveform->dump(sim_time);
+    if (tracing) waveform->dump(sim_time);
     ++sim_time;
 
     top->clock = 0;
     top->eval();
-    if (waveform) waveform->dump(sim_time);
+    if (tracing) waveform->dump(sim_time);
     ++sim_time;
 }
 
+// Called before every tick of a cycle, once the beats going in on it have been profiled. Resets
+// between cycles are dumped or not along with the cycle before them.
+static void update_tracing(size_t clock_cycle, const profiler& prof)
+{
+    tracing = waveform && trace_gate_open(trace, clock_cycle, prof);
+}
+
 struct Transmission {
     Wire256 data{}; // 256-bit word as 8x32-bit
     Wire32  keep{}; // 32 lanes of 1 byte each
 };
 
-std::vector<Transmission> string_to_nf_stream(const std::string& hex_string)
+std::vector<Transmission> bytes_to_nf_stream(std::vector<uint8_t> bytes)
 {
-    std::vector<uint8_t> bytes = string_to_hex(hex_string);
-
     // If you want empty input to mean "no beats", this is the cleanest outcome.
     if (bytes.empty()) return {};
 
@@ -95,6 +136,11 @@ std::vector<Transmission> string_to_nf_stream(const std::string& hex_string)
     return out;
 }
 
+std::vector<Transmission> string_to_nf_stream(const std::string& hex_string)
+{
+    return bytes_to_nf_stream(string_to_hex(hex_string));
+}
+
 std::string nf_data_to_string(const Wire256& value)
 {
     // Unpack into bytes (inverse of the packing in string_to_nf_data)
@@ -139,6 +185,27 @@ struct OutputInterface {
     bool    last;
 };
 
+// Turns a packet's beats into a message, with the correct .last flags
+template <typename InterfaceT>
+std::vector<InterfaceT> make_message(const std::vector<Transmission>& beats)
+{
+    std::vector<InterfaceT> msg;
+    msg.reserve(beats.size());
+
+    for (size_t i = 0; i < beats.size(); ++i)
+    {
+        msg.push_back(InterfaceT{
+            .data = beats[i].data,
+            .keep = beats[i].keep,
+            .last = (i == 0)
+        });
+    }
+
+    std::reverse(msg.begin(), msg.end());
+
+    return msg;
+}
+
 // Generic packer: turns a list of hex strings into a vector-of-messages,
 // where each message is a vector of beats with correct .last flags.
 template <typename InterfaceT>
@@ -149,23 +216,7 @@ std::vector<std::vector<InterfaceT>> make_messages(const std::vector<std::string
 
     for (const auto& hex_string : hex_strings)
     {
-        const std::vector<Transmission> beats = string_to_nf_stream(hex_string);
-
-        std::vector<InterfaceT> msg;
-        msg.reserve(beats.size());
-
-        for (size_t i = 0; i < beats.size(); ++i)
-        {
-            msg.push_back(InterfaceT{
-                .data = beats[i].data,
-                .keep = beats[i].keep,
-                .last = (i == 0)
-            });
-        }
-
-        std::reverse(msg.begin(), msg.end());
-
-        messages.push_back(std::move(msg));
+        messages.push_back(make_message<InterfaceT>(string_to_nf_stream(hex_string)));
     }
 
     return messages;
@@ -181,6 +232,45 @@ std::vector<std::vector<OutputInterface>> make_expected_outputs(const std::vecto
     return make_messages<OutputInterface>(expected_outputs_strings);
 }
 
+// Adds options.random_packets packets of random bytes, of whatever lengths, for the reference model
+// to check
+static void add_random_inputs(std::vector<std::vector<InputInterface>>& inputs, const options& options)
+{
+    std::mt19937_64 random(options.random_seed);
+    std::uniform_int_distribution<size_t> length(1, options.random_max_bytes);
+
+    inputs.reserve(inputs.size() + options.random_packets);
+
+    std::vector<uint8_t> bytes;
+    for (size_t p = 0; p < options.random_packets; ++p)
+    {
+        bytes.resize(length(random));
+        for (uint8_t& byte : bytes) byte = reference_random_byte(options.reference, random);
+
+        inputs.push_back(make_message<InputInterface>(bytes_to_nf_stream(bytes)));
+    }
+}
+
+// What the reference model worked out the kernel should have put out
+static std::vector<std::vector<OutputInterface>> reference_outputs(const reference_model& model)
+{
+    std::vector<std::vector<OutputInterface>> outputs;
+    outputs.reserve(model.packets.size());
+
+    for (const std::vector<reference_beat>& packet : model.packets)
+    {
+        std::vector<OutputInterface> beats;
+        beats.reserve(packet.size());
+
+        for (const reference_beat& beat : packet)
+            beats.push_back(OutputInterface{.data = beat.data, .keep = beat.keep, .last = beat.last});
+
+        outputs.push_back(std::move(beats));
+    }
+
+    return outputs;
+}
+
 static void default_inputs(Vpacket_body_processor* top) {
     for (int w = 0; w < 8; ++w) top->i__024data[w] = 0;
     top->i__024valid = false;
@@ -205,14 +295,36 @@ static OutputInterface capture_output(Vpacket_body_processor* top) {
     return out;
 }
 
+static void print_beat(
+    const char* direction,
+    size_t packet_index,
+    size_t beat_index,
+    size_t clock_cycle,
+    const Wire256& data,
+    Wire32 keep,
+    bool last
+) {
+    if (quiet) return;
+
+    std::cout << "Packet " << packet_index
+              << " " << direction << " beat " << beat_index << ":\n"
+              << "  Clock Cycle: " << clock_cycle << '\n'
+              << "  Data:        " << nf_data_to_string(data) << '\n'
+              << "  Keep:        " << std::hex << keep << std::dec << '\n'
+              << "  Last:        " << (last ? "true" : "false") << std::endl;
+}
+
 std::vector<std::vector<OutputInterface>> simulate(
     Vpacket_body_processor* top,
     const std::vector<std::vector<InputInterface>>& input_packets,
+    profiler& prof,
     size_t max_idle_cycles_per_packet = 1000
 ) {
     std::vector<std::vector<OutputInterface>> output_packets;
     output_packets.reserve(input_packets.size());
 
+    update_tracing(0, prof);
+
     // Initialize signals
     top->reset  = 1;
     top->enable = 1;
@@ -241,14 +353,10 @@ std::vector<std::vector<OutputInterface>> simulate(
             if (input_beat_index < packet_inputs.size()) {
                 const auto& in = packet_inputs[input_beat_index];
 
-                std::cout << "Packet " << packet_index
-                          << " Input beat " << input_beat_index << ":\n"
-                          << "  Clock Cycle: " << clock_cycle << '\n'
-                          << "  Data:        " << nf_data_to_string(in.data) << '\n'
-                          << "  Keep:        " << std::hex << in.keep << std::dec << '\n'
-                          << "  Last:        " << (in.last ? "true" : "false") << std::endl;
+                print_beat("Input", packet_index, input_beat_index, clock_cycle, in.data, in.keep, in.last);
 
                 drive_inputs(top, in);
+                profile_input_beat(prof, packet_index, clock_cycle);
                 ++input_beat_index;
             } else {
                 // Packet fully injected: go idle until outputs are drained
@@ -256,6 +364,7 @@ std::vector<std::vector<OutputInterface>> simulate(
             }
 
             // Tick
+            update_tracing(clock_cycle, prof);
             tick(top);
             ++clock_cycle;
 
@@ -263,14 +372,10 @@ std::vector<std::vector<OutputInterface>> simulate(
             if (top->o__024valid) {
                 OutputInterface out = capture_output(top);
 
-                std::cout << "Packet " << packet_index
-                          << " Output beat " << packet_outputs.size() << ":\n"
-                          << "  Clock Cycle: " << clock_cycle << '\n'
-                          << "  Data:        " << nf_data_to_string(out.data) << '\n'
-                          << "  Keep:        " << std::hex << out.keep << std::dec << '\n'
-                          << "  Last:        " << (out.last ? "true" : "false") << std::endl;
+                print_beat("Output", packet_index, packet_outputs.size(), clock_cycle, out.data, out.keep, out.last);
 
                 packet_outputs.push_back(out);
+                profile_output_beat(prof, packet_index, clock_cycle, out.last);
 
                 if (out.last) {
                     saw_last_output = true;
@@ -285,6 +390,8 @@ std::vector<std::vector<OutputInterface>> simulate(
                     --idle_cycles_left;
                 }
             }
+
+            profile_cycle(prof, true, top->o__024valid);
         }
 
         if (!saw_last_output) {
@@ -310,14 +417,206 @@ std::vector<std::vector<OutputInterface>> simulate(
     return output_packets;
 }
 
+// Reassembles the output stream into packets by last, as the beats come out
+struct StreamCapture {
+    std::vector<std::vector<OutputInterface>> packets;
+    std::vector<OutputInterface> current;
+};
+
+static void capture_stream_beat(StreamCapture& capture, const OutputInterface& out, size_t clock_cycle)
+{
+    print_beat("Output", capture.packets.size(), capture.current.size(), clock_cycle, out.data, out.keep, out.last);
+
+    capture.current.push_back(out);
+
+    if (out.last) {
+        capture.packets.push_back(std::move(capture.current));
+        capture.current.clear();
+    }
+}
+
+static void print_stream_report(
+    const profiler& prof,
+    const stall_state& input_stalls,
+    const stall_state& output_stalls
+) {
+    if (prof.packets.empty()) return;
+
+    // Throughput is over the busy window: from the first beat in to the last beat out
+    const size_t busy_cycles = prof.packets.back().last_output_cycle - prof.packets.front().first_input_cycle;
+
+    size_t input_beats = 0;
+    size_t output_beats = 0;
+    size_t latency_min = SIZE_MAX;
+    size_t latency_max = 0;
+    size_t latency_total = 0;
+    for (const packet_profile& packet : prof.packets) {
+        const size_t latency = packet_latency(packet);
+        input_beats += packet.input_beats;
+        output_beats += packet.output_beats;
+        latency_min = std::min(latency_min, latency);
+        latency_max = std::max(latency_max, latency);
+        latency_total += latency;
+    }
+
+    std::cout << "Stream report:\n"
+              << "  Packets:              " << prof.packets.size() << '\n'
+              << "  Busy cycles:          " << busy_cycles << '\n'
+              << "  Input beats/cycle:    " << static_cast<double>(input_beats) / busy_cycles << '\n'
+              << "  Output beats/cycle:   " << static_cast<double>(output_beats) / busy_cycles << '\n'
+              << "  Input stalls:         " << stall_pattern_to_string(input_stalls.pattern)
+              << " (" << input_stalls.total_stalled_cycles << " cycles)\n"
+              << "  Output stalls:        " << stall_pattern_to_string(output_stalls.pattern)
+              << " (" << output_stalls.total_stalled_cycles << " cycles)\n"
+              << "  Latency (cycles, first input beat to last output beat):\n"
+              << "    Min:  " << latency_min << '\n'
+              << "    Mean: " << static_cast<double>(latency_total) / prof.packets.size() << '\n'
+              << "    Max:  " << latency_max << std::endl;
+}
+
+// Streams the packets in back to back, packet_gap idle cycles apart, resetting only once at the
+// start. This is what pipelined traffic looks like to the kernel - unlike simulate(), and unlike
+// gapl_wrapper, which both reset it between packets - so a kernel that keeps state from one packet
+// to the next may legitimately produce different outputs here.
+//
+// On a cycle input_stalls stalls, no beat is offered (valid is low). On a cycle output_stalls
+// stalls, the output isn't ready, so the kernel is disabled, and the beat offered isn't taken - it's
+// offered again on the next cycle - just as processor_controller does when its output queue fills.
+std::vector<std::vector<OutputInterface>> simulate_stream(
+    Vpacket_body_processor* top,
+    const std::vector<std::vector<InputInterface>>& input_packets,
+    size_t packet_gap,
+    stall_state& input_stalls,
+    stall_state& output_stalls,
+    profiler& prof,
+    size_t max_idle_cycles = 1000
+) {
+    for (size_t p = 0; p < input_packets.size(); ++p) {
+        if (input_packets[p].empty()) {
+            std::cerr << "simulate_stream: packet " << p << " has no beats to stream" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    StreamCapture capture;
+    capture.packets.reserve(input_packets.size());
+
+    update_tracing(0, prof);
+
+    // Initialize signals
+    default_inputs(top);
+    top->reset  = 1;
+    top->enable = 1;
+    tick(top);
+
+    // Finish reset
+    top->reset = 0;
+    tick(top);
+
+    size_t clock_cycle = 0;
+
+    size_t packet_index     = 0;
+    size_t input_beat_index = 0;
+    size_t gap_cycles_left  = 0;
+    size_t idle_cycles_left = max_idle_cycles;
+
+    // Idle cycles are only counted while the output's ready, so a kernel that's never let run would
+    // never run out of them. However the stalls fall, though, something should go in or come out
+    // every so often: no stretch of stalls is longer than MAX_STALL_CYCLES, and a long run of them
+    // back to back is vanishingly unlikely. Anything much longer than that is taken for a hang.
+    const size_t max_stuck_cycles = max_idle_cycles + packet_gap + 10 * MAX_STALL_CYCLES;
+    size_t stuck_cycles = 0;
+
+    while (capture.packets.size() < input_packets.size() && idle_cycles_left > 0 && stuck_cycles < max_stuck_cycles)
+    {
+        ++stuck_cycles;
+
+        const bool input_stalled  = next_stall(input_stalls);
+        const bool output_stalled = next_stall(output_stalls);
+
+        top->enable = !output_stalled;
+
+        if (packet_index < input_packets.size() && gap_cycles_left == 0 && !input_stalled) {
+            const auto& packet_inputs = input_packets[packet_index];
+            const auto& in = packet_inputs[input_beat_index];
+
+            drive_inputs(top, in);
+        } else {
+            default_inputs(top);
+            if (gap_cycles_left > 0) --gap_cycles_left;
+        }
+
+        // A beat offered while the kernel's disabled isn't taken
+        if (top->i__024valid && top->enable) {
+            const auto& packet_inputs = input_packets[packet_index];
+            const auto& in = packet_inputs[input_beat_index];
+            stuck_cycles = 0;
+
+            print_beat("Input", packet_index, input_beat_index, clock_cycle, in.data, in.keep, in.last);
+
+            profile_input_beat(prof, packet_index, clock_cycle);
+
+            if (++input_beat_index == packet_inputs.size()) {
+                ++packet_index;
+                input_beat_index = 0;
+                gap_cycles_left  = packet_gap;
+            }
+        }
+
+        update_tracing(clock_cycle, prof);
+        tick(top);
+        ++clock_cycle;
+
+        // Likewise, nothing comes out while it's disabled
+        const bool output_valid = top->o__024valid && top->enable;
+        if (output_valid) {
+            const OutputInterface out = capture_output(top);
+            profile_output_beat(prof, capture.packets.size(), clock_cycle, out.last);
+            capture_stream_beat(capture, out, clock_cycle);
+            idle_cycles_left = max_idle_cycles;
+            stuck_cycles = 0;
+        } else if (packet_index >= input_packets.size() && !output_stalled) {
+            // As in simulate(), only count idle cycles once everything's been injected, and only
+            // those the kernel could have used
+            --idle_cycles_left;
+        }
+
+        profile_cycle(prof, top->enable, output_valid);
+    }
+
+    if (capture.packets.size() < input_packets.size() && stuck_cycles >= max_stuck_cycles) {
+        std::cerr << "simulate_stream: no beat went in or came out for "
+                  << max_stuck_cycles << " cycles while waiting for packet "
+                  << capture.packets.size() << " (clock_cycle="
+                  << clock_cycle << ")\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (capture.packets.size() < input_packets.size()) {
+        std::cerr << "simulate_stream: timeout waiting for last output of packet "
+                  << capture.packets.size() << " after "
+                  << max_idle_cycles << " idle cycles (clock_cycle="
+                  << clock_cycle << ")\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::cout << "Finished simulation after " << clock_cycle << " clock cycles" << std::endl;
+    print_stream_report(prof, input_stalls, output_stalls);
+
+    return std::move(capture.packets);
+}
+
+// Pads output_packets in place (rather than a copy of what can be millions of packets), and sets
+// first_mismatched_packet to the index of the first packet that doesn't match, if any does
 bool check_simulation_success(
     const std::vector<std::vector<OutputInterface>>& expected_packets,
-    const std::vector<std::vector<OutputInterface>>& output_packets
+    std::vector<std::vector<OutputInterface>>& output_packets,
+    size_t& first_mismatched_packet
 ) {
-    // Make a padded copy of outputs:
+    // Pad the outputs:
     // - pad with "real" beats: data=0, keep=all 1s
     // - move 'last' to the final padded beat (not the original early last)
-    std::vector<std::vector<OutputInterface>> padded_outputs = output_packets;
+    std::vector<std::vector<OutputInterface>>& padded_outputs = output_packets;
 
     const size_t packets_to_pad = std::min(expected_packets.size(), padded_outputs.size());
     for (size_t p = 0; p < packets_to_pad; ++p) {
@@ -359,6 +658,12 @@ bool check_simulation_success(
 
     bool simulation_success = true;
 
+    size_t beats_matched = 0;
+    size_t beats_mismatched = 0;
+    size_t packets_mismatched = 0;
+
+    first_mismatched_packet = SIZE_MAX;
+
     if (expected_packets.size() != padded_outputs.size()) {
         std::cerr << "Test Error: expected and outputs packet-count mismatch\n"
                   << "  Expected packets: " << expected_packets.size() << '\n'
@@ -375,26 +680,23 @@ bool check_simulation_success(
                       << "  Expected beats: " << expected.size() << '\n'
                       << "  Actual beats:   " << outputs.size() << std::endl;
             simulation_success = false;
+            ++packets_mismatched;
+            first_mismatched_packet = std::min(first_mismatched_packet, p);
             continue;
         }
 
+        bool packet_matches = true;
+
         for (size_t i = 0; i < expected.size(); ++i) {
             const auto& exp = expected[i];
             const auto& out = outputs[i];
 
-            bool data_matches = true;
-            for (size_t w = 0; w < 8; ++w) {
-                if (exp.data[w] != out.data[w]) {
-                    data_matches = false;
-                    break;
-                }
-            }
-
+            const bool data_matches = std::memcmp(exp.data.data(), out.data.data(), sizeof(Wire256)) == 0;
             const bool keep_matches = (exp.keep == out.keep);
             const bool last_matches = (exp.last == out.last);
             const bool matches = data_matches && keep_matches && last_matches;
 
-            std::cout << "Packet " << p << " Output " << i << std::endl;
+            if (!quiet) std::cout << "Packet " << p << " Output " << i << std::endl;
 
             if (!matches) {
                 std::cerr << "Test Error: mismatch at packet " << p << ", output " << i << '\n'
@@ -405,18 +707,81 @@ bool check_simulation_success(
                           << "  Expected last: " << (exp.last ? "true" : "false") << '\n'
                           << "  Actual last:   " << (out.last ? "true" : "false") << std::endl;
                 simulation_success = false;
+                packet_matches = false;
+                ++beats_mismatched;
             } else {
+                ++beats_matched;
+                if (quiet) continue;
+
                 std::cerr << "Test Success: match at packet " << p << ", output " << i << '\n'
                           << "  Data: " << nf_data_to_string(out.data) << '\n'
                           << "  Keep: " << std::hex << out.keep << std::dec << '\n'
                           << "  Last: " << (out.last ? "true" : "false") << std::endl;
             }
         }
+
+        if (!packet_matches) {
+            ++packets_mismatched;
+            first_mismatched_packet = std::min(first_mismatched_packet, p);
+        }
     }
 
+    std::cout << "Checked " << expected_packets.size() << " packets ("
+              << beats_matched + beats_mismatched << " beats): "
+              << expected_packets.size() - packets_mismatched << " packets matched, "
+              << packets_mismatched << " mismatched; "
+              << beats_matched << " beats matched, "
+              << beats_mismatched << " mismatched" << std::endl;
+
     return simulation_success;
 }
 
+// Simulates inputs on a model of its own, tracing to waveform_path if it isn't empty, and stepping
+// golden along with it if it isn't null. Everything about a run - the stalls included, as they're
+// seeded - is the same every time, so a run can be replayed just to trace it.
+static std::vector<std::vector<OutputInterface>> run_simulation(
+    const options& options,
+    const std::vector<std::vector<InputInterface>>& inputs,
+    const std::string& waveform_path,
+    reference_model* golden,
+    profiler& prof
+) {
+    Vpacket_body_processor* top = new Vpacket_body_processor();
+    reference = golden;
+
+    // A replay's waveform lines up with the run it replays
+    sim_time = 0;
+
+    if (!waveform_path.empty()) {
+        Verilated::traceEverOn(true);
+        waveform = new Waveform;
+        top->trace(waveform, 99);
+        waveform->open(waveform_path.c_str());
+    }
+
+    // Both get their own stream of random numbers from the one seed
+    stall_state input_stalls  = create_stall_state(options.input_stalls, options.stall_seed);
+    stall_state output_stalls = create_stall_state(options.output_stalls, options.stall_seed + 1);
+
+    // Simulate packet-by-packet (drain until last for each packet), or stream them back to back
+    std::vector<std::vector<OutputInterface>> outputs = options.stream
+        ? simulate_stream(top, inputs, options.packet_gap, input_stalls, output_stalls, prof)
+        : simulate(top, inputs, prof);
+
+    top->final();
+
+    if (waveform) {
+        waveform->close();
+        delete waveform;
+        waveform = nullptr;
+    }
+
+    delete top;
+    reference = nullptr;
+
+    return outputs;
+}
+
 int main(int argc, char** argv) {
     Verilated::commandArgs(argc, argv);
 
@@ -424,15 +789,6 @@ int main(int argc, char** argv) {
     std::cout << "Using parameters..." << std::endl;
     print_options(options);
 
-    Vpacket_body_processor* top = new Vpacket_body_processor();
-
-    if (!options.waveform_path.empty()) {
-        Verilated::traceEverOn(true);
-        waveform = new VerilatedVcdC;
-        top->trace(waveform, 99);
-        waveform->open(options.waveform_path.c_str());
-    }
-
     // Convert to internal packetized representation
     std::vector<std::vector<InputInterface>> inputs =
         make_inputs(options.inputs);
@@ -440,20 +796,68 @@ int main(int argc, char** argv) {
     std::vector<std::vector<OutputInterface>> expected_outputs =
         make_expected_outputs(options.expected_outputs);
 
-    // Simulate packet-by-packet (drain until last for each packet)
-    std::vector<std::vector<OutputInterface>> outputs =
-        simulate(top, inputs);
+    add_random_inputs(inputs, options);
 
-    top->final();
+    // Repeated as a whole, so expected outputs still line up with their inputs
+    if (options.repeat > 1) {
+        const size_t input_count = inputs.size();
+        const size_t expected_count = expected_outputs.size();
 
-    if (waveform) {
-        waveform->close();
-        delete waveform;
-        waveform = nullptr;
+        inputs.reserve(input_count * options.repeat);
+        expected_outputs.reserve(expected_count * options.repeat);
+
+        for (size_t r = 1; r < options.repeat; ++r) {
+            inputs.insert(inputs.end(), inputs.begin(), inputs.begin() + input_count);
+            expected_outputs.insert(expected_outputs.end(), expected_outputs.begin(), expected_outputs.begin() + expected_count);
+        }
     }
 
-    delete top;
+    quiet = options.quiet;
+    trace = options.trace;
+
+    profiler prof = create_profiler(inputs.size());
+
+    // Tracing the first mismatch has to wait for a replay, so this run isn't traced at all
+    const std::string waveform_path = trace.on_mismatch ? "" : options.waveform_path;
+
+    // Works out the expected outputs as the kernel runs, seeing just what it sees
+    const bool use_reference = options.reference != reference_kind::none;
+    reference_model golden = create_reference_model(options.reference);
+
+    const auto simulation_start = std::chrono::steady_clock::now();
+
+    std::vector<std::vector<OutputInterface>> outputs =
+        run_simulation(options, inputs, waveform_path, use_reference ? &golden : nullptr, prof);
+
+    const double simulation_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - simulation_start).count();
+
+    std::cout << "Simulated " << prof.cycles << " clock cycles in " << simulation_seconds << " s ("
+              << static_cast<double>(prof.cycles) / simulation_seconds << " cycles/s)" << std::endl;
+
+    if (!options.profile_path.empty()) write_profile_json(prof, options.profile_path);
+
+    if (use_reference) expected_outputs = reference_outputs(golden);
+
+    size_t first_mismatched_packet;
+    const bool test_pass = check_simulation_success(expected_outputs, outputs, first_mismatched_packet);
+
+    if (trace.on_mismatch) {
+        if (first_mismatched_packet < prof.packets.size()) {
+            trace = mismatch_trace_gate(trace, prof.packets[first_mismatched_packet]);
+
+            std::cout << "Replaying to trace packet " << first_mismatched_packet << ", the first mismatch: "
+                      << trace_gate_to_string(trace) << std::endl;
+
+            // The replay's beats are the same as the first run's, so there's no need to print them again
+            quiet = true;
+
+            profiler replay_prof = create_profiler(inputs.size());
+            run_simulation(options, inputs, options.waveform_path, nullptr, replay_prof);
+        } else {
+            std::cout << "No mismatch to trace, so no waveform was written" << std::endl;
+        }
+    }
 
-    const bool test_pass = check_simulation_success(expected_outputs, outputs);
     return test_pass ? 0 : 1;
 }
@@ -11,9 +11,36 @@
 
 void print_options(const options& opts)
 {
-    std::cout << "  Inputs:                  " << vec_to_string(opts.inputs) << std::endl;
-    std::cout << "  Expected Outputs:        " << vec_to_string(opts.expected_outputs) << std::endl;
+    if (opts.quiet)
+    {
+        std::cout << "  Inputs:                  " << opts.inputs.size() << " packets" << std::endl;
+        std::cout << "  Expected Outputs:        " << opts.expected_outputs.size() << " packets" << std::endl;
+    }
+    else
+    {
+        std::cout << "  Inputs:                  " << vec_to_string(opts.inputs) << std::endl;
+        std::cout << "  Expected Outputs:        " << vec_to_string(opts.expected_outputs) << std::endl;
+    }
+    std::cout << "  Reference Model:         " << reference_kind_to_string(opts.reference) << std::endl;
+    if (opts.random_packets > 0)
+    {
+        std::cout << "  Random Packets:          " << opts.random_packets << " of up to " << opts.random_max_bytes
+                  << " bytes, seed " << opts.random_seed << std::endl;
+    }
+    std::cout << "  Repeat:                  " << opts.repeat << std::endl;
     std::cout << "  Waveform Path:           " << opts.waveform_path << std::endl;
+    if (!opts.waveform_path.empty())
+        std::cout << "  Trace:                   " << trace_gate_to_string(opts.trace) << std::endl;
+    std::cout << "  Profile Path:            " << opts.profile_path << std::endl;
+    std::cout << "  Quiet:                   " << (opts.quiet ? "true" : "false") << std::endl;
+    std::cout << "  Stream:                  " << (opts.stream ? "true" : "false") << std::endl;
+    if (opts.stream)
+    {
+        std::cout << "  Packet Gap:              " << opts.packet_gap << " cycles" << std::endl;
+        std::cout << "  Input Stalls:            " << stall_pattern_to_string(opts.input_stalls) << std::endl;
+        std::cout << "  Output Stalls:           " << stall_pattern_to_string(opts.output_stalls) << std::endl;
+        std::cout << "  Stall Seed:              " << opts.stall_seed << std::endl;
+    }
 }
 
 void print_help()
@@ -21,18 +48,67 @@ void print_help()
     std::cout << "Usage" << std::endl;
     std::cout << "  -i Inputs (specify as hex strings)" << std::endl;
     std::cout << "  -o Expected Outputs (specify as hex strings)" << std::endl;
-    std::cout << "  -w Waveform Path" << std::endl;
+    std::cout << "  -R Check the outputs against a reference model instead: aes, md5, cms or regex" << std::endl;
+    std::cout << "  -N Random packets to send after the inputs, checked against the reference model" << std::endl;
+    std::cout << "  -L Longest random packet, in bytes (default 64)" << std::endl;
+    std::cout << "  -S Seed for the random packets (default 1)" << std::endl;
+    std::cout << "  -n Send the inputs this many times over (default 1)" << std::endl;
+    std::cout << "  -w Waveform Path (FST or VCD, whichever kernel_test was built to trace)" << std::endl;
+    std::cout << "  -c Only trace cycles <start>:<stop> (either can be left out)" << std::endl;
+    std::cout << "  -k Only trace while this packet (by index) is in the kernel" << std::endl;
+    std::cout << "  -m Only trace the first mismatching packet, and this many cycles before it" << std::endl;
+    std::cout << "  -j Profile Path (per-packet cycles and pipeline histograms, as JSON)" << std::endl;
+    std::cout << "  -q Quiet: only print beats that don't match, and a summary" << std::endl;
+    std::cout << "  -s Stream packets back to back, without resetting between them" << std::endl;
+    std::cout << "  -g Idle cycles between streamed packets (default 0)" << std::endl;
+    std::cout << "  -b Input stall pattern when streaming: cycles with no valid input (default none)" << std::endl;
+    std::cout << "  -p Output stall pattern when streaming: cycles the output isn't ready (default none)" << std::endl;
+    std::cout << "     none, random:<percent>, periodic:<flowing>:<stalled> or bursty:<percent>:<burst>" << std::endl;
+    std::cout << "     (<stalled> and <burst> at most " << MAX_STALL_CYCLES << " cycles)" << std::endl;
+    std::cout << "  -r Seed for the random stall patterns (default 1)" << std::endl;
+}
+
+static stall_pattern get_stall_pattern(const char* text)
+{
+    stall_pattern pattern;
+    if (!parse_stall_pattern(text, pattern))
+    {
+        std::cerr << "Invalid stall pattern: " << text << std::endl;
+        print_help();
+        exit(-1);
+    }
+
+    return pattern;
 }
 
 options get_options(int argc, char** argv)
 {
     std::vector<std::string> inputs;
     std::vector<std::string> expected_outputs;
+    size_t repeat = 1;
+
+    reference_kind reference = reference_kind::none;
+    size_t random_packets = 0;
+    size_t random_max_bytes = 64;
+    uint64_t random_seed = 1;
 
     std::string waveform_path;
+    trace_gate trace = full_trace_gate();
+    bool trace_gated = false;
+
+    std::string profile_path;
+    bool quiet = false;
+
+    bool stream = false;
+    size_t packet_gap = 0;
+
+    stall_pattern input_stalls = get_stall_pattern("none");
+    stall_pattern output_stalls = get_stall_pattern("none");
+    bool stalls_given = false;
+    uint64_t stall_seed = 1;
 
     int input;
-    while ((input = getopt(argc, argv, "i:o:w:h")) != -1)
+    while ((input = getopt(argc, argv, "i:o:R:N:L:S:n:w:c:k:m:j:qsg:b:p:r:h")) != -1)
     {
         switch (input)
         {
@@ -42,9 +118,71 @@ options get_options(int argc, char** argv)
             case 'o':
                 expected_outputs.emplace_back(optarg);
                 break;
+            case 'R':
+                if (!parse_reference_kind(optarg, reference))
+                {
+                    std::cerr << "Unknown reference model: " << optarg << std::endl;
+                    print_help();
+                    exit(-1);
+                }
+                break;
+            case 'N':
+                random_packets = std::stoul(optarg);
+                break;
+            case 'L':
+                random_max_bytes = std::stoul(optarg);
+                break;
+            case 'S':
+                random_seed = std::stoull(optarg);
+                break;
+            case 'n':
+                repeat = std::stoul(optarg);
+                break;
             case 'w':
                 waveform_path = std::string(optarg);
                 break;
+            case 'c':
+                if (!parse_cycle_window(optarg, trace.start_cycle, trace.stop_cycle))
+                {
+                    std::cerr << "Invalid cycle window: " << optarg << std::endl;
+                    print_help();
+                    exit(-1);
+                }
+                trace_gated = true;
+                break;
+            case 'k':
+                trace.on_packet = true;
+                trace.packet = std::stoul(optarg);
+                trace_gated = true;
+                break;
+            case 'm':
+                trace.on_mismatch = true;
+                trace.pre_trigger_cycles = std::stoul(optarg);
+                trace_gated = true;
+                break;
+            case 'j':
+                profile_path = std::string(optarg);
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            case 's':
+                stream = true;
+                break;
+            case 'g':
+                packet_gap = std::stoul(optarg);
+                break;
+            case 'b':
+                input_stalls = get_stall_pattern(optarg);
+                stalls_given = true;
+                break;
+            case 'p':
+                output_stalls = get_stall_pattern(optarg);
+                stalls_given = true;
+                break;
+            case 'r':
+                stall_seed = std::stoull(optarg);
+                break;
             case 'h':
             default:
                 print_help();
@@ -52,10 +190,61 @@ options get_options(int argc, char** argv)
         }
     }
 
+    // The reference model works out what to expect, of every packet
+    if (reference != reference_kind::none && !expected_outputs.empty())
+    {
+        std::cerr << "Expected outputs (-o) can't be given with a reference model (-R)" << std::endl;
+        exit(-1);
+    }
+
+    if (random_packets > 0 && reference == reference_kind::none)
+    {
+        std::cerr << "Random packets (-N) need a reference model (-R) to check them against" << std::endl;
+        exit(-1);
+    }
+
+    if (random_max_bytes == 0)
+    {
+        std::cerr << "Random packets need at least one byte (-L)" << std::endl;
+        exit(-1);
+    }
+
+    if (stalls_given && !stream)
+    {
+        std::cerr << "Stall patterns only apply when streaming (-s)" << std::endl;
+        exit(-1);
+    }
+
+    if (trace_gated && waveform_path.empty())
+    {
+        std::cerr << "Trace gating (-c, -k, -m) needs a waveform (-w)" << std::endl;
+        exit(-1);
+    }
+
+    // The mismatch trigger picks its own window
+    if (trace.on_mismatch && (trace.on_packet || trace.start_cycle != 0 || trace.stop_cycle != SIZE_MAX))
+    {
+        std::cerr << "Tracing the first mismatch (-m) can't be combined with -c or -k" << std::endl;
+        exit(-1);
+    }
+
     return options
     {
         .inputs = std::move(inputs),
         .expected_outputs = std::move(expected_outputs),
-        .waveform_path = std::move(waveform_path)
+        .reference = reference,
+        .random_packets = random_packets,
+        .random_max_bytes = random_max_bytes,
+        .random_seed = random_seed,
+        .repeat = repeat,
+        .waveform_path = std::move(waveform_path),
+        .trace = trace,
+        .profile_path = std::move(profile_path),
+        .quiet = quiet,
+        .stream = stream,
+        .packet_gap = packet_gap,
+        .input_stalls = input_stalls,
+        .output_stalls = output_stalls,
+        .stall_seed = stall_seed
     };
 }
\ No newline at end of file
@@ -5,14 +5,52 @@
 #ifndef OPTIONS_H
 #define OPTIONS_H
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "reference.h"
+#include "stall.h"
+#include "trace.h"
+
 typedef struct
 {
     std::vector<std::string> inputs;
     std::vector<std::string> expected_outputs;
+
+    // Check the outputs against this golden model (see reference.h), rather than expected outputs
+    reference_kind reference;
+
+    // Packets of random bytes to send after the inputs, each 1 to random_max_bytes long
+    size_t random_packets;
+    size_t random_max_bytes;
+    uint64_t random_seed;
+
+    // How many times over to send the inputs (and expect the outputs), for a long run from a few
+    // vectors
+    size_t repeat;
+
     std::string waveform_path;
+
+    // Which cycles go into the waveform (see trace.h)
+    trace_gate trace;
+
+    // Where to write the cycle-level profile (see profiler.h) as JSON, if anywhere
+    std::string profile_path;
+
+    // Only print beats that don't match, and a summary
+    bool quiet;
+
+    // Streaming mode: packets go in back to back, packet_gap idle cycles apart, without a reset
+    // between them
+    bool stream;
+    size_t packet_gap;
+
+    // When streaming, which cycles offer no input, and which the output isn't ready on
+    stall_pattern input_stalls;
+    stall_pattern output_stalls;
+    uint64_t stall_seed;
 } options;
 
 void print_options(const options& opts);
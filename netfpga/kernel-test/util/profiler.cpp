@@ -0,0 +1,181 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+profiler create_profiler(size_t packet_count)
+{
+    return profiler
+    {
+        .packets = std::vector<packet_profile>(packet_count, packet_profile{}),
+        .cycles = 0,
+        .enabled_cycles = 0,
+        .output_valid_cycles = 0,
+        .packets_in_flight = 0,
+        .occupancy = {}
+    };
+}
+
+void profile_input_beat(profiler& prof, size_t packet, size_t cycle)
+{
+    packet_profile& profile = prof.packets.at(packet);
+
+    if (!profile.started)
+    {
+        profile.started = true;
+        profile.first_input_cycle = cycle;
+        ++prof.packets_in_flight;
+    }
+
+    ++profile.input_beats;
+}
+
+void profile_output_beat(profiler& prof, size_t packet, size_t cycle, bool last)
+{
+    packet_profile& profile = prof.packets.at(packet);
+
+    if (profile.output_beats == 0) profile.first_output_cycle = cycle;
+    ++profile.output_beats;
+
+    if (last && !profile.finished)
+    {
+        profile.finished = true;
+        profile.last_output_cycle = cycle;
+        if (prof.packets_in_flight > 0) --prof.packets_in_flight;
+    }
+}
+
+void profile_cycle(profiler& prof, bool enabled, bool output_valid)
+{
+    ++prof.cycles;
+    if (enabled) ++prof.enabled_cycles;
+    if (output_valid) ++prof.output_valid_cycles;
+
+    ++prof.occupancy[prof.packets_in_flight];
+}
+
+size_t packet_latency(const packet_profile& packet)
+{
+    return packet.last_output_cycle - packet.first_input_cycle;
+}
+
+size_t packet_pipeline_depth(const packet_profile& packet)
+{
+    return packet.first_output_cycle - packet.first_input_cycle;
+}
+
+cycle_histogram latency_histogram(const profiler& prof)
+{
+    cycle_histogram histogram;
+    for (const packet_profile& packet: prof.packets)
+        if (packet.finished) ++histogram[packet_latency(packet)];
+
+    return histogram;
+}
+
+cycle_histogram pipeline_depth_histogram(const profiler& prof)
+{
+    cycle_histogram histogram;
+    for (const packet_profile& packet: prof.packets)
+        if (packet.finished) ++histogram[packet_pipeline_depth(packet)];
+
+    return histogram;
+}
+
+cycle_histogram initiation_interval_histogram(const profiler& prof)
+{
+    cycle_histogram histogram;
+    for (size_t p = 1; p < prof.packets.size(); ++p)
+    {
+        const packet_profile& previous = prof.packets[p - 1];
+        const packet_profile& current = prof.packets[p];
+
+        if (previous.started && current.started)
+            ++histogram[current.first_input_cycle - previous.first_input_cycle];
+    }
+
+    return histogram;
+}
+
+static void write_histogram(std::ostream& out, const char* name, const cycle_histogram& histogram)
+{
+    size_t samples = 0;
+    size_t total = 0;
+    for (const auto& [value, count]: histogram)
+    {
+        samples += count;
+        total += value * count;
+    }
+
+    out << "    \"" << name << "\": {\"samples\": " << samples;
+    if (samples > 0)
+    {
+        out << ", \"min\": " << histogram.begin()->first
+            << ", \"mean\": " << static_cast<double>(total) / static_cast<double>(samples)
+            << ", \"max\": " << histogram.rbegin()->first;
+    }
+
+    out << ", \"counts\": [";
+    bool first = true;
+    for (const auto& [value, count]: histogram)
+    {
+        out << (first ? "" : ", ") << "[" << value << ", " << count << "]";
+        first = false;
+    }
+    out << "]}";
+}
+
+void write_profile_json(const profiler& prof, const std::string& path)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cerr << "Failed to open profile " << path << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    const double duty_cycle = prof.cycles > 0
+        ? static_cast<double>(prof.output_valid_cycles) / static_cast<double>(prof.cycles)
+        : 0;
+
+    out << "{\n"
+        << "  \"cycles\": " << prof.cycles << ",\n"
+        << "  \"enabled_cycles\": " << prof.enabled_cycles << ",\n"
+        << "  \"output_valid_cycles\": " << prof.output_valid_cycles << ",\n"
+        << "  \"output_valid_duty_cycle\": " << duty_cycle << ",\n"
+        << "  \"histograms\": {\n";
+
+    write_histogram(out, "latency", latency_histogram(prof));
+    out << ",\n";
+    write_histogram(out, "pipeline_depth", pipeline_depth_histogram(prof));
+    out << ",\n";
+    write_histogram(out, "initiation_interval", initiation_interval_histogram(prof));
+    out << ",\n";
+    write_histogram(out, "occupancy", prof.occupancy);
+    out << "\n  },\n";
+
+    out << "  \"packets\": [";
+    for (size_t p = 0; p < prof.packets.size(); ++p)
+    {
+        const packet_profile& packet = prof.packets[p];
+
+        out << (p == 0 ? "\n" : ",\n")
+            << "    {\"index\": " << p
+            << ", \"input_beats\": " << packet.input_beats
+            << ", \"output_beats\": " << packet.output_beats;
+
+        if (packet.started) out << ", \"first_input_cycle\": " << packet.first_input_cycle;
+        if (packet.output_beats > 0) out << ", \"first_output_cycle\": " << packet.first_output_cycle;
+        if (packet.finished)
+        {
+            out << ", \"last_output_cycle\": " << packet.last_output_cycle
+                << ", \"pipeline_depth\": " << packet_pipeline_depth(packet)
+                << ", \"latency\": " << packet_latency(packet);
+        }
+
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+}
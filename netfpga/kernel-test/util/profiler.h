@@ -0,0 +1,64 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+// Cycle-level profile of a simulation: when each packet's first beat went in, and its first and
+// last beats came out, and, every cycle, how many packets were in the kernel and whether a beat came
+// out. From those, pipeline depth (first beat in to first beat out), latency (first beat in to last
+// beat out) and initiation interval (first beat in to the next packet's first beat in), comparable
+// across variations without synthesizing any of them.
+
+typedef struct
+{
+    bool started;
+    bool finished;
+
+    size_t first_input_cycle;
+    size_t first_output_cycle;
+    size_t last_output_cycle;
+    size_t input_beats;
+    size_t output_beats;
+} packet_profile;
+
+typedef std::map<size_t, size_t> cycle_histogram;
+
+typedef struct
+{
+    std::vector<packet_profile> packets;
+
+    // Every cycle simulated, and those the kernel was enabled on / put out a beat on
+    size_t cycles;
+    size_t enabled_cycles;
+    size_t output_valid_cycles;
+
+    // Packets started but not finished yet, and how many cycles each count of those lasted
+    size_t packets_in_flight;
+    cycle_histogram occupancy;
+} profiler;
+
+profiler create_profiler(size_t packet_count);
+
+// Called as each beat goes in or comes out, packet being the index of the packet it belongs to
+void profile_input_beat(profiler& prof, size_t packet, size_t cycle);
+void profile_output_beat(profiler& prof, size_t packet, size_t cycle, bool last);
+
+// Called once every cycle, after the beats on it
+void profile_cycle(profiler& prof, bool enabled, bool output_valid);
+
+size_t packet_latency(const packet_profile& packet);
+size_t packet_pipeline_depth(const packet_profile& packet);
+
+// Packets are only counted once finished, in the order they were sent
+cycle_histogram latency_histogram(const profiler& prof);
+cycle_histogram pipeline_depth_histogram(const profiler& prof);
+cycle_histogram initiation_interval_histogram(const profiler& prof);
+
+// The packets, the cycle counts and every histogram above (as [value, count] pairs, by value), along
+// with the output valid duty cycle. Exits if path can't be written.
+void write_profile_json(const profiler& prof, const std::string& path);
+
+#endif //PROFILER_H
@@ -0,0 +1,513 @@
+#include "reference.h"
+
+#include <cstring>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define REFERENCE_X86 1
+#endif
+
+/* BEATS */
+
+// The beat's bytes in hex string order, most significant first
+static void beat_to_bytes(const uint32_t* data, uint8_t* bytes)
+{
+    for (size_t i = 0; i < 32; ++i)
+        bytes[31 - i] = static_cast<uint8_t>(data[i / 4] >> (8 * (i % 4)));
+}
+
+static std::array<uint32_t, 8> bytes_to_beat(const uint8_t* bytes)
+{
+    std::array<uint32_t, 8> data{};
+    for (size_t i = 0; i < 32; ++i)
+        data[i / 4] |= static_cast<uint32_t>(bytes[31 - i]) << (8 * (i % 4));
+
+    return data;
+}
+
+/* AES */
+
+static const uint8_t aes_s_box[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static uint8_t aes_xtime(uint8_t b)
+{
+    return static_cast<uint8_t>((b << 1) ^ ((b & 0x80) ? 0x1b : 0x00));
+}
+
+// The kernel's key is fixed at zero, so its round keys are worked out once
+typedef struct
+{
+    uint8_t bytes[11][16];
+} aes_round_keys;
+
+static aes_round_keys expand_zero_key()
+{
+    aes_round_keys keys{};
+
+    uint8_t round_constant = 0x01;
+    for (size_t round = 1; round <= 10; ++round)
+    {
+        const uint8_t* previous = keys.bytes[round - 1];
+        uint8_t* current = keys.bytes[round];
+
+        // RotWord, SubWord and the round constant on the previous key's last column
+        const uint8_t transformed[4] = {
+            static_cast<uint8_t>(aes_s_box[previous[13]] ^ round_constant),
+            aes_s_box[previous[14]],
+            aes_s_box[previous[15]],
+            aes_s_box[previous[12]],
+        };
+
+        for (size_t i = 0; i < 4; ++i) current[i] = previous[i] ^ transformed[i];
+        for (size_t i = 4; i < 16; ++i) current[i] = previous[i] ^ current[i - 4];
+
+        round_constant = aes_xtime(round_constant);
+    }
+
+    return keys;
+}
+
+static const aes_round_keys aes_keys = expand_zero_key();
+
+static void aes_encrypt_software(const uint8_t* in, uint8_t* out)
+{
+    uint8_t state[16];
+    for (size_t i = 0; i < 16; ++i) state[i] = in[i] ^ aes_keys.bytes[0][i];
+
+    for (size_t round = 1; round <= 10; ++round)
+    {
+        // SubBytes and ShiftRows together: row r of column c comes from column c + r
+        uint8_t shifted[16];
+        for (size_t c = 0; c < 4; ++c)
+            for (size_t r = 0; r < 4; ++r)
+                shifted[4 * c + r] = aes_s_box[state[4 * ((c + r) % 4) + r]];
+
+        if (round < 10)
+        {
+            for (size_t c = 0; c < 4; ++c)
+            {
+                const uint8_t* column = shifted + 4 * c;
+                const uint8_t all = column[0] ^ column[1] ^ column[2] ^ column[3];
+                for (size_t r = 0; r < 4; ++r)
+                    state[4 * c + r] = column[r] ^ all ^ aes_xtime(column[r] ^ column[(r + 1) % 4]);
+            }
+        }
+        else
+        {
+            std::memcpy(state, shifted, sizeof(state));
+        }
+
+        for (size_t i = 0; i < 16; ++i) state[i] ^= aes_keys.bytes[round][i];
+    }
+
+    std::memcpy(out, state, sizeof(state));
+}
+
+#if REFERENCE_X86
+
+// Compiled for AES-NI whatever the rest is compiled for, and only called once the CPU's known to
+// have it
+__attribute__((target("aes,sse2")))
+static void aes_encrypt_ni(const uint8_t* in, uint8_t* out)
+{
+    __m128i state = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    state = _mm_xor_si128(state, _mm_loadu_si128(reinterpret_cast<const __m128i*>(aes_keys.bytes[0])));
+
+    for (size_t round = 1; round < 10; ++round)
+        state = _mm_aesenc_si128(state, _mm_loadu_si128(reinterpret_cast<const __m128i*>(aes_keys.bytes[round])));
+    state = _mm_aesenclast_si128(state, _mm_loadu_si128(reinterpret_cast<const __m128i*>(aes_keys.bytes[10])));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), state);
+}
+
+static const bool aes_ni = __builtin_cpu_supports("aes");
+
+#else
+
+static const bool aes_ni = false;
+
+#endif
+
+bool reference_uses_aes_ni()
+{
+    return aes_ni;
+}
+
+static void aes_encrypt(const uint8_t* in, uint8_t* out)
+{
+#if REFERENCE_X86
+    if (aes_ni)
+    {
+        aes_encrypt_ni(in, out);
+        return;
+    }
+#endif
+
+    aes_encrypt_software(in, out);
+}
+
+/* MD5 */
+
+// Every message hashed here is a 32-byte beat, which pads out to exactly one block: the beat, then
+// 0x80, then its length in bits (256)
+static const uint32_t md5_k[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static const uint32_t md5_shift[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+static const uint32_t md5_initial[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+
+// Which word of the block round i reads
+static size_t md5_word(size_t i)
+{
+    switch (i / 16)
+    {
+        case 0:  return i;
+        case 1:  return (5 * i + 1) % 16;
+        case 2:  return (3 * i + 5) % 16;
+        default: return (7 * i) % 16;
+    }
+}
+
+static void md5_block(const uint8_t* message, uint32_t block[16])
+{
+    for (size_t w = 0; w < 8; ++w)
+    {
+        block[w] = static_cast<uint32_t>(message[4 * w])
+                 | static_cast<uint32_t>(message[4 * w + 1]) << 8
+                 | static_cast<uint32_t>(message[4 * w + 2]) << 16
+                 | static_cast<uint32_t>(message[4 * w + 3]) << 24;
+    }
+
+    block[8] = 0x80;
+    for (size_t w = 9; w < 16; ++w) block[w] = 0;
+    block[14] = 256;
+}
+
+static uint32_t rotate_left(uint32_t x, uint32_t n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+// The digest as its 4 words, little-endian: the digest's bytes are their bytes in order
+static void md5(const uint8_t* message, uint32_t digest[4])
+{
+    uint32_t block[16];
+    md5_block(message, block);
+
+    uint32_t a = md5_initial[0], b = md5_initial[1], c = md5_initial[2], d = md5_initial[3];
+
+    for (size_t i = 0; i < 64; ++i)
+    {
+        uint32_t f;
+        switch (i / 16)
+        {
+            case 0:  f = (b & c) | (~b & d); break;
+            case 1:  f = (d & b) | (~d & c); break;
+            case 2:  f = b ^ c ^ d;          break;
+            default: f = c ^ (b | ~d);       break;
+        }
+
+        f += a + md5_k[i] + block[md5_word(i)];
+        a = d;
+        d = c;
+        c = b;
+        b += rotate_left(f, md5_shift[i]);
+    }
+
+    digest[0] = md5_initial[0] + a;
+    digest[1] = md5_initial[1] + b;
+    digest[2] = md5_initial[2] + c;
+    digest[3] = md5_initial[3] + d;
+}
+
+// Four messages at once, one to a 32-bit lane, for cms's four hashes of each beat. MD5 is serial
+// within a message, so the md5 model's one hash a beat gets nothing from this, and stays scalar.
+static void md5_x4(const uint8_t messages[4][32], uint32_t digests[4][4])
+{
+#if defined(__SSE2__)
+    uint32_t blocks[4][16];
+    for (size_t lane = 0; lane < 4; ++lane) md5_block(messages[lane], blocks[lane]);
+
+    __m128i block[16];
+    for (size_t w = 0; w < 16; ++w)
+    {
+        block[w] = _mm_set_epi32(
+            static_cast<int>(blocks[3][w]), static_cast<int>(blocks[2][w]),
+            static_cast<int>(blocks[1][w]), static_cast<int>(blocks[0][w]));
+    }
+
+    const __m128i ones = _mm_set1_epi32(-1);
+
+    __m128i a = _mm_set1_epi32(static_cast<int>(md5_initial[0]));
+    __m128i b = _mm_set1_epi32(static_cast<int>(md5_initial[1]));
+    __m128i c = _mm_set1_epi32(static_cast<int>(md5_initial[2]));
+    __m128i d = _mm_set1_epi32(static_cast<int>(md5_initial[3]));
+
+    for (size_t i = 0; i < 64; ++i)
+    {
+        __m128i f;
+        switch (i / 16)
+        {
+            case 0:  f = _mm_or_si128(_mm_and_si128(b, c), _mm_andnot_si128(b, d)); break;
+            case 1:  f = _mm_or_si128(_mm_and_si128(d, b), _mm_andnot_si128(d, c)); break;
+            case 2:  f = _mm_xor_si128(_mm_xor_si128(b, c), d);                     break;
+            default: f = _mm_xor_si128(c, _mm_or_si128(b, _mm_xor_si128(d, ones))); break;
+        }
+
+        f = _mm_add_epi32(f, a);
+        f = _mm_add_epi32(f, _mm_set1_epi32(static_cast<int>(md5_k[i])));
+        f = _mm_add_epi32(f, block[md5_word(i)]);
+
+        const __m128i rotated = _mm_or_si128(
+            _mm_sll_epi32(f, _mm_cvtsi32_si128(static_cast<int>(md5_shift[i]))),
+            _mm_srl_epi32(f, _mm_cvtsi32_si128(static_cast<int>(32 - md5_shift[i]))));
+
+        a = d;
+        d = c;
+        c = b;
+        b = _mm_add_epi32(b, rotated);
+    }
+
+    uint32_t words[4][4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(words[0]), _mm_add_epi32(a, _mm_set1_epi32(static_cast<int>(md5_initial[0]))));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(words[1]), _mm_add_epi32(b, _mm_set1_epi32(static_cast<int>(md5_initial[1]))));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(words[2]), _mm_add_epi32(c, _mm_set1_epi32(static_cast<int>(md5_initial[2]))));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(words[3]), _mm_add_epi32(d, _mm_set1_epi32(static_cast<int>(md5_initial[3]))));
+
+    for (size_t lane = 0; lane < 4; ++lane)
+        for (size_t w = 0; w < 4; ++w)
+            digests[lane][w] = words[w][lane];
+#else
+    for (size_t lane = 0; lane < 4; ++lane) md5(messages[lane], digests[lane]);
+#endif
+}
+
+/* REGEX */
+
+// The kernel's email NFA, which matches an upper case address as soon as there are two characters
+// after a dot in its domain
+static bool is_email_url(uint8_t c)
+{
+    return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-';
+}
+
+static bool is_email_local(uint8_t c)
+{
+    return is_email_url(c) || c == '.' || c == '_';
+}
+
+static void scan_email(reference_model& model, uint8_t c)
+{
+    const bool n1 = model.nfa_nodes & 0x01;
+    const bool n2 = model.nfa_nodes & 0x02;
+    const bool n3 = model.nfa_nodes & 0x04;
+    const bool n4 = model.nfa_nodes & 0x08;
+    const bool n5 = model.nfa_nodes & 0x10;
+
+    const bool url = is_email_url(c);
+
+    // The start node's always live, so n1 is too on any local character
+    const bool next_n1 = is_email_local(c);
+    const bool next_n2 = (n1 && c == '@') || ((n2 || n3) && url);
+    const bool next_n3 = n2 && c == '.';
+    const bool next_n4 = n3 && url;
+    const bool next_n5 = (n4 || n5) && url;
+
+    model.nfa_nodes = static_cast<uint8_t>(next_n1 | next_n2 << 1 | next_n3 << 2 | next_n4 << 3 | next_n5 << 4);
+    model.nfa_matched = model.nfa_matched || next_n5;
+}
+
+/* MODELS */
+
+// Also the names an application's test.properties gives as its referenceModel, which
+// runKernelTest passes to -R when it's asked for random packets (-PkernelTestRandomPackets)
+bool parse_reference_kind(const std::string& text, reference_kind& kind)
+{
+    if (text == "aes")   { kind = reference_kind::aes;   return true; }
+    if (text == "md5")   { kind = reference_kind::md5;   return true; }
+    if (text == "cms")   { kind = reference_kind::cms;   return true; }
+    if (text == "regex") { kind = reference_kind::regex; return true; }
+
+    return false;
+}
+
+std::string reference_kind_to_string(reference_kind kind)
+{
+    switch (kind)
+    {
+        case reference_kind::aes:   return reference_uses_aes_ni() ? "aes (AES-NI)" : "aes";
+        case reference_kind::md5:   return "md5";
+        case reference_kind::cms:   return "cms";
+        case reference_kind::regex: return "regex";
+        case reference_kind::none:
+        default:                    return "none";
+    }
+}
+
+reference_model create_reference_model(reference_kind kind)
+{
+    reference_model model{};
+    model.kind = kind;
+    reference_reset(model);
+
+    return model;
+}
+
+void reference_reset(reference_model& model)
+{
+    for (auto& column : model.sketch) column.fill(0);
+
+    model.nfa_nodes = 0;
+    model.nfa_matched = false;
+}
+
+static void put_out(reference_model& model, const std::array<uint32_t, 8>& data, uint32_t keep, bool last)
+{
+    model.current.push_back(reference_beat{.data = data, .keep = keep, .last = last});
+
+    if (last)
+    {
+        model.packets.push_back(std::move(model.current));
+        model.current.clear();
+    }
+}
+
+static std::array<uint32_t, 8> aes_beat(const uint32_t* data)
+{
+    uint8_t bytes[32];
+    beat_to_bytes(data, bytes);
+
+    uint8_t encrypted[32];
+    aes_encrypt(bytes, encrypted);
+    aes_encrypt(bytes + 16, encrypted + 16);
+
+    return bytes_to_beat(encrypted);
+}
+
+static std::array<uint32_t, 8> md5_beat(const uint32_t* data)
+{
+    uint8_t bytes[32];
+    beat_to_bytes(data, bytes);
+
+    uint32_t digest[4];
+    md5(bytes, digest);
+
+    uint8_t hashed[32]{};
+    std::memcpy(hashed, digest, sizeof(digest));
+
+    return bytes_to_beat(hashed);
+}
+
+static std::array<uint32_t, 8> cms_beat(reference_model& model, const uint32_t* data)
+{
+    // Hash function h hashes the beat xor h, which only touches its last byte
+    uint8_t messages[4][32];
+    beat_to_bytes(data, messages[0]);
+    for (size_t h = 1; h < 4; ++h)
+    {
+        std::memcpy(messages[h], messages[0], 32);
+        messages[h][31] ^= static_cast<uint8_t>(h);
+    }
+
+    uint32_t digests[4][4];
+    md5_x4(messages, digests);
+
+    std::array<uint32_t, 8> sketch{};
+    for (size_t h = 0; h < 4; ++h)
+    {
+        // The low 4 bits of the digest, read as a number: its last byte's
+        const size_t index = (digests[h][3] >> 24) & 0xF;
+        model.sketch[h][index] = (model.sketch[h][index] + 1) & 0xF;
+
+        // Count i of hash h is the (16h + i)th nibble up
+        for (size_t i = 0; i < 16; ++i)
+        {
+            const size_t nibble = 16 * h + i;
+            sketch[nibble / 8] |= static_cast<uint32_t>(model.sketch[h][i]) << (4 * (nibble % 8));
+        }
+    }
+
+    return sketch;
+}
+
+void reference_cycle(reference_model& model, bool valid, const uint32_t* data, uint32_t keep, bool last)
+{
+    switch (model.kind)
+    {
+        case reference_kind::aes:
+            if (valid) put_out(model, aes_beat(data), keep, last);
+            break;
+
+        case reference_kind::md5:
+            if (valid) put_out(model, md5_beat(data), keep, last);
+            break;
+
+        case reference_kind::cms:
+            if (valid) put_out(model, cms_beat(model, data), keep, last);
+            break;
+
+        case reference_kind::regex:
+        {
+            // The kernel scans its input whether it's valid or not, and answers on last alone
+            uint8_t bytes[32];
+            beat_to_bytes(data, bytes);
+            for (uint8_t c : bytes) scan_email(model, c);
+
+            if (last)
+            {
+                std::array<uint32_t, 8> answer{};
+                answer[7] = static_cast<uint32_t>(model.nfa_matched) << 24;
+                put_out(model, answer, 0xFFFFFFFFu, true);
+            }
+            break;
+        }
+
+        case reference_kind::none:
+            break;
+    }
+}
+
+uint8_t reference_random_byte(reference_kind kind, std::mt19937_64& random)
+{
+    if (kind != reference_kind::regex) return static_cast<uint8_t>(random());
+
+    // Mostly address characters, with enough separators to complete one now and then, and the odd
+    // byte of anything to break one off
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-....@@@@";
+    const uint64_t draw = random();
+    if (draw % 16 == 0) return static_cast<uint8_t>(draw >> 8);
+
+    return static_cast<uint8_t>(alphabet[(draw >> 8) % (sizeof(alphabet) - 1)]);
+}
@@ -0,0 +1,73 @@
+#ifndef REFERENCE_H
+#define REFERENCE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Golden models of the netfpga applications' packet body processors (src/<application>), to check a
+// kernel against on any number of packets instead of a handful of hand-written expected outputs:
+//   aes    each beat's two 16-byte halves encrypted with AES-128 under the all-zero key
+//   md5    each beat's MD5 digest, in the first 16 bytes, the rest zero
+//   cms    a count-min sketch of the beats since reset: 4 hashes (MD5 of the beat xor 0..3) into
+//          16 4-bit counts each, the whole sketch put out after every beat
+//   regex  whether an email address has turned up since reset, put out on each packet's last beat
+//
+// Only two of them use SIMD: aes runs on AES-NI when the CPU has it, and cms hashes each beat's four
+// MD5s at once, a 32-bit SSE2 lane each. md5 and regex are scalar.
+//
+// A model is stepped a cycle at a time with exactly what the kernel sees (see reference_cycle),
+// rather than a packet at a time, so what it expects holds however the packets went in: reset
+// between them or streamed, with gaps or stalls. That matters to cms and regex, which keep state
+// from one beat to the next, and to regex in particular, which scans whatever's on its input every
+// cycle, valid or not.
+enum class reference_kind { none, aes, md5, cms, regex };
+
+// A beat as the kernel's ports carry it: 8 little-endian words, the first byte of the beat (in hex
+// string order) being the most significant
+typedef struct
+{
+    std::array<uint32_t, 8> data;
+    uint32_t keep;
+    bool last;
+} reference_beat;
+
+typedef struct
+{
+    reference_kind kind;
+
+    // cms: each hash function's 16 counts
+    std::array<std::array<uint8_t, 16>, 4> sketch;
+
+    // regex: the NFA's live nodes (n1 to n5 as bits 0 to 4), and whether it's matched since reset
+    uint8_t nfa_nodes;
+    bool nfa_matched;
+
+    // What the kernel should have put out so far, split into packets by last
+    std::vector<std::vector<reference_beat>> packets;
+    std::vector<reference_beat> current;
+} reference_model;
+
+// Returns false if text doesn't name a model as above
+bool parse_reference_kind(const std::string& text, reference_kind& kind);
+std::string reference_kind_to_string(reference_kind kind);
+
+reference_model create_reference_model(reference_kind kind);
+
+// Called on every clock edge the kernel sees: a reset, or with the inputs it's given. Cycles the
+// kernel is disabled on (enable low) aren't cycles at all, as far as it's concerned, so they
+// shouldn't be passed on.
+void reference_reset(reference_model& model);
+void reference_cycle(reference_model& model, bool valid, const uint32_t* data, uint32_t keep, bool last);
+
+// A random byte of packet body, from the bytes that exercise the model: regex's are mostly
+// characters of an email address, so some packets match; every other model's are uniform
+uint8_t reference_random_byte(reference_kind kind, std::mt19937_64& random);
+
+// Whether aes runs on AES-NI on this machine, rather than in software
+bool reference_uses_aes_ni();
+
+#endif //REFERENCE_H
@@ -0,0 +1,163 @@
+#include "stall.h"
+
+#include <sstream>
+#include <vector>
+
+static std::vector<std::string> split_fields(const std::string& text)
+{
+    std::vector<std::string> fields;
+    std::stringstream ss(text);
+
+    std::string field;
+    while (std::getline(ss, field, ':')) fields.push_back(field);
+
+    return fields;
+}
+
+static bool parse_count(const std::string& text, size_t& count)
+{
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+
+    count = std::stoul(text);
+    return true;
+}
+
+// A percentage of cycles to stall; 100 would never let anything through
+static bool parse_percent(const std::string& text, double& fraction)
+{
+    std::istringstream ss(text);
+
+    double percent;
+    if (!(ss >> percent) || !ss.eof() || percent < 0 || percent >= 100) return false;
+
+    fraction = percent / 100;
+    return true;
+}
+
+// For bursts of b cycles to make up a fraction f of all cycles, one has to start on p of the cycles
+// that aren't already in one. A burst starting stalls its first cycle, so each burst follows (1 - p)
+// / p flowing cycles on average, and f = b / (b + (1 - p) / p), which gives p = f / (b (1 - f) + f)
+static double burst_start_probability(const stall_pattern& pattern)
+{
+    const double f = pattern.stall_fraction;
+    const double b = static_cast<double>(pattern.stalled_cycles);
+
+    return f / (b * (1 - f) + f);
+}
+
+bool parse_stall_pattern(const std::string& text, stall_pattern& pattern)
+{
+    const std::vector<std::string> fields = split_fields(text);
+    if (fields.empty()) return false;
+
+    pattern = stall_pattern{.kind = stall_kind::none, .stall_fraction = 0, .flowing_cycles = 0, .stalled_cycles = 0};
+
+    if (fields[0] == "none")
+        return fields.size() == 1;
+
+    if (fields[0] == "random")
+    {
+        pattern.kind = stall_kind::random;
+        return fields.size() == 2 && parse_percent(fields[1], pattern.stall_fraction);
+    }
+
+    if (fields[0] == "periodic")
+    {
+        pattern.kind = stall_kind::periodic;
+        return fields.size() == 3
+            && parse_count(fields[1], pattern.flowing_cycles)
+            && parse_count(fields[2], pattern.stalled_cycles)
+            && pattern.flowing_cycles > 0
+            && pattern.stalled_cycles <= MAX_STALL_CYCLES;
+    }
+
+    // Any duty below 100% can be reached with bursts of any length, but the check's kept next to the
+    // formula rather than trusted to it: a start probability of 1 would stall every cycle
+    if (fields[0] == "bursty")
+    {
+        pattern.kind = stall_kind::bursty;
+        return fields.size() == 3
+            && parse_percent(fields[1], pattern.stall_fraction)
+            && parse_count(fields[2], pattern.stalled_cycles)
+            && pattern.stalled_cycles > 0
+            && pattern.stalled_cycles <= MAX_STALL_CYCLES
+            && burst_start_probability(pattern) < 1;
+    }
+
+    return false;
+}
+
+std::string stall_pattern_to_string(const stall_pattern& pattern)
+{
+    std::stringstream ss;
+
+    switch (pattern.kind)
+    {
+        case stall_kind::none:
+            ss << "none";
+            break;
+        case stall_kind::random:
+            ss << "random:" << pattern.stall_fraction * 100;
+            break;
+        case stall_kind::periodic:
+            ss << "periodic:" << pattern.flowing_cycles << ":" << pattern.stalled_cycles;
+            break;
+        case stall_kind::bursty:
+            ss << "bursty:" << pattern.stall_fraction * 100 << ":" << pattern.stalled_cycles;
+            break;
+    }
+
+    return ss.str();
+}
+
+stall_state create_stall_state(const stall_pattern& pattern, uint64_t seed)
+{
+    return stall_state
+    {
+        .pattern = pattern,
+        .random = std::mt19937_64(seed),
+        .cycle = 0,
+        .burst_cycles_left = 0,
+        .total_stalled_cycles = 0
+    };
+}
+
+static bool chance(stall_state& state, double probability)
+{
+    return std::uniform_real_distribution<double>(0, 1)(state.random) < probability;
+}
+
+bool next_stall(stall_state& state)
+{
+    const stall_pattern& pattern = state.pattern;
+    const size_t cycle = state.cycle++;
+
+    bool stall = false;
+    switch (pattern.kind)
+    {
+        case stall_kind::none:
+            break;
+
+        case stall_kind::random:
+            stall = chance(state, pattern.stall_fraction);
+            break;
+
+        case stall_kind::periodic:
+            stall = cycle % (pattern.flowing_cycles + pattern.stalled_cycles) >= pattern.flowing_cycles;
+            break;
+
+        case stall_kind::bursty:
+            if (state.burst_cycles_left == 0 && chance(state, burst_start_probability(pattern)))
+                state.burst_cycles_left = pattern.stalled_cycles;
+
+            if (state.burst_cycles_left > 0)
+            {
+                --state.burst_cycles_left;
+                stall = true;
+            }
+            break;
+    }
+
+    if (stall) ++state.total_stalled_cycles;
+    return stall;
+}
@@ -0,0 +1,51 @@
+#ifndef STALL_H
+#define STALL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+
+// Which cycles of a stream stall, either upstream (a bubble: no valid input that cycle) or
+// downstream (backpressure: the output isn't ready, so the kernel is disabled that cycle, as
+// processor_controller does when its output queue fills). Written as:
+//   none                      never stalls
+//   random:<percent>          each cycle stalls independently with this probability
+//   periodic:<flowing>:<stalled>
+//                             this many cycles flowing, then this many stalled, repeating
+//   bursty:<percent>:<burst>  as random, but the stalls come <burst> cycles at a time - the same
+//                             average duty, at its worst for anything buffering in between
+//
+// A stretch of stalls longer than MAX_STALL_CYCLES isn't allowed, so that a stream that's made no
+// progress for much longer than that can be taken for a hung kernel rather than an unlucky pattern.
+enum class stall_kind { none, random, periodic, bursty };
+
+constexpr size_t MAX_STALL_CYCLES = 100000;
+
+typedef struct
+{
+    stall_kind kind;
+    double stall_fraction;
+    size_t flowing_cycles;
+    size_t stalled_cycles;
+} stall_pattern;
+
+typedef struct
+{
+    stall_pattern pattern;
+    std::mt19937_64 random;
+    size_t cycle;
+    size_t burst_cycles_left;
+    size_t total_stalled_cycles;
+} stall_state;
+
+// Returns false if text isn't a pattern as above
+bool parse_stall_pattern(const std::string& text, stall_pattern& pattern);
+std::string stall_pattern_to_string(const stall_pattern& pattern);
+
+stall_state create_stall_state(const stall_pattern& pattern, uint64_t seed);
+
+// Whether the next cycle stalls
+bool next_stall(stall_state& state);
+
+#endif //STALL_H
@@ -0,0 +1,88 @@
+#include "trace.h"
+
+#include <cstdint>
+#include <sstream>
+
+trace_gate full_trace_gate()
+{
+    return trace_gate
+    {
+        .start_cycle = 0,
+        .stop_cycle = SIZE_MAX,
+        .on_packet = false,
+        .packet = 0,
+        .on_mismatch = false,
+        .pre_trigger_cycles = 0
+    };
+}
+
+static bool parse_cycle(const std::string& text, size_t& cycle)
+{
+    if (text.find_first_not_of("0123456789") != std::string::npos) return false;
+    if (!text.empty()) cycle = std::stoul(text);
+
+    return true;
+}
+
+bool parse_cycle_window(const std::string& text, size_t& start_cycle, size_t& stop_cycle)
+{
+    const size_t colon = text.find(':');
+    if (colon == std::string::npos) return false;
+
+    start_cycle = 0;
+    stop_cycle = SIZE_MAX;
+
+    return parse_cycle(text.substr(0, colon), start_cycle)
+        && parse_cycle(text.substr(colon + 1), stop_cycle)
+        && start_cycle < stop_cycle;
+}
+
+bool trace_gate_open(const trace_gate& gate, size_t cycle, const profiler& prof)
+{
+    if (cycle < gate.start_cycle || cycle >= gate.stop_cycle) return false;
+
+    // Nothing's known to have gone wrong on the first run, so nothing's dumped
+    if (gate.on_mismatch) return false;
+
+    if (gate.on_packet)
+    {
+        if (gate.packet >= prof.packets.size()) return false;
+
+        const packet_profile& packet = prof.packets[gate.packet];
+        return packet.started && !packet.finished;
+    }
+
+    return true;
+}
+
+trace_gate mismatch_trace_gate(const trace_gate& gate, const packet_profile& packet)
+{
+    trace_gate replay = gate;
+    replay.on_mismatch = false;
+
+    if (packet.started)
+    {
+        replay.start_cycle = packet.first_input_cycle > gate.pre_trigger_cycles
+            ? packet.first_input_cycle - gate.pre_trigger_cycles
+            : 0;
+    }
+
+    // The cycle its last beat came out on, and one after
+    if (packet.finished) replay.stop_cycle = packet.last_output_cycle + 1;
+
+    return replay;
+}
+
+std::string trace_gate_to_string(const trace_gate& gate)
+{
+    std::stringstream ss;
+
+    ss << "cycles " << gate.start_cycle << " to ";
+    if (gate.stop_cycle == SIZE_MAX) ss << "end";
+    else ss << gate.stop_cycle;
+
+    if (gate.on_packet) ss << ", while packet " << gate.packet << " is in the kernel";
+    if (gate.on_mismatch) ss << ", first mismatch and " << gate.pre_trigger_cycles << " cycles before it";
+
+    return ss.str();
+}
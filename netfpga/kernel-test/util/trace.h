@@ -0,0 +1,49 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstddef>
+#include <string>
+
+#include "profiler.h"
+
+// Which cycles of a simulation make it into the waveform. Dumping every signal on every cycle is
+// what makes waveforms of long runs too expensive to leave on, so the dump can be limited to a window
+// of cycles, to the cycles one packet spends in the kernel, or to the first packet that comes out
+// wrong, along with the cycles leading up to it.
+//
+// Cycles are counted as the simulation reports them: from the first cycle after reset, whether or not
+// the kernel was enabled on it.
+
+typedef struct
+{
+    // Only cycles in [start_cycle, stop_cycle)
+    size_t start_cycle;
+    size_t stop_cycle;
+
+    // Only while this packet is in the kernel: from its first beat in, to its last beat out
+    bool on_packet;
+    size_t packet;
+
+    // Only around the first packet that doesn't match its expected output, from pre_trigger_cycles
+    // before its first beat went in. Which packet that is isn't known until the simulation's over, so
+    // it's run once without a waveform, and again (it's deterministic, stalls included) with the
+    // window narrowed to that packet - see mismatch_trace_gate.
+    bool on_mismatch;
+    size_t pre_trigger_cycles;
+} trace_gate;
+
+// Every cycle
+trace_gate full_trace_gate();
+
+// "<start>:<stop>", either of which can be left out, for from the first cycle / to the last
+bool parse_cycle_window(const std::string& text, size_t& start_cycle, size_t& stop_cycle);
+
+// Whether the cycle about to be simulated is dumped. Beats driven on it have to be profiled already.
+bool trace_gate_open(const trace_gate& gate, size_t cycle, const profiler& prof);
+
+// The window to replay, once packet turned out to be the first mismatch
+trace_gate mismatch_trace_gate(const trace_gate& gate, const packet_profile& packet);
+
+std::string trace_gate_to_string(const trace_gate& gate);
+
+#endif //TRACE_H
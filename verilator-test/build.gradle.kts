@@ -13,6 +13,12 @@ data class TestProperties(
     var flatten: Boolean = true,
     var literalSimplication: Boolean = true,
     var waveform: Boolean = false,
+    var waveformFormat: String = "vcd",
+    var traceCycles: String? = null,
+    var traceMismatch: String? = null,
+    var vectors: String? = null,
+    var randomVectors: String? = null,
+    var vectorSeed: String? = null,
     var topModule: String? = null,
     var retimeDelayModel: String? = null,
     var retimingClockPeriod: String? = null,
@@ -42,6 +48,21 @@ fun loadTestProperties(testDirectory: File): TestProperties {
             "flatten" -> testProperties.flatten = value.toString().toBoolean()
             "literalSimplication" -> testProperties.literalSimplication = value.toString().toBoolean()
             "waveform" -> testProperties.waveform = value.toString().toBoolean()
+            "waveformFormat" -> testProperties.waveformFormat = value.toString().trim().lowercase().also {
+                if (it != "fst" && it != "vcd") throw GradleException("waveformFormat must be fst or vcd, not $it (in ${testDirectory.path})")
+            }
+            "traceCycles" -> testProperties.traceCycles = value.toString().trim()
+            "traceMismatch" -> testProperties.traceMismatch = value.toString().trim()
+            // Relative to the variation, or failing that the program, so variations can share a file
+            "vectors" -> testProperties.vectors = value.toString().trim().let { path ->
+                listOf(testDirectory, testDirectory.parentFile)
+                    .map { File(it, path) }
+                    .firstOrNull { it.isFile }
+                    ?.absolutePath
+                    ?: throw GradleException("vectors file $path not found (in ${testDirectory.path} or its program)")
+            }
+            "randomVectors" -> testProperties.randomVectors = value.toString().trim()
+            "vectorSeed" -> testProperties.vectorSeed = value.toString().trim()
             "topModule" -> testProperties.topModule = value.toString()
             "retime" -> if (value.toString().toBoolean()) testProperties.retimeDelayModel = testDirectory.listFiles()!!.first { it.isFile && it.name == "delay.yaml" }.absolutePath
             "retimingClockPeriod" -> testProperties.retimingClockPeriod = value.toString()
@@ -126,6 +147,9 @@ fun discoverTestCases(testsRoot: File): List<TestCase> =
 
 fun createVerilatorExeName(testCase: TestCase) = "test_${testCase.id}"
 
+// Headers shared by every test wrapper (see include/waveform.h)
+val includeRoot = file("include")
+
 fun createVerilatorSimCommand(testCase: TestCase, verilogFiles: List<File>, cppFiles: List<File>, properties: TestProperties): List<String> {
     val objDir = layout.buildDirectory.dir("tests/${testCase.qualifiedName}/cpp").get().asFile
 
@@ -146,7 +170,8 @@ fun createVerilatorSimCommand(testCase: TestCase, verilogFiles: List<File>, cppF
         add("--exe")
         addAll(cppFiles.map { it.absolutePath })
         addAll(listOf("--build", "-o", exeName))
-        if (properties.waveform) add("--trace")
+        addAll(listOf("-CFLAGS", "-I${includeRoot.absolutePath}"))
+        if (properties.waveform) add(if (properties.waveformFormat == "fst") "--trace-fst" else "--trace")
 
         addAll(properties.additionalVerilatorFlags)
         removeAll(properties.removeVerilatorFlags)
@@ -251,7 +276,7 @@ fun simulateTestCase(testCase: TestCase, testProperties: TestProperties, variati
     val waveformDir = layout.buildDirectory.dir("tests/${testCase.qualifiedName}/waveform").get().asFile
     val waveformFile = if (testProperties.waveform) {
         waveformDir.mkdirs()
-        File(waveformDir, "${testCase.id}.vcd")
+        File(waveformDir, "${testCase.id}.${testProperties.waveformFormat}")
     } else {
         null
     }
@@ -278,7 +303,17 @@ fun simulateTestCase(testCase: TestCase, testProperties: TestProperties, variati
     val runErr = ByteArrayOutputStream()
     val runRes = exec {
         isIgnoreExitValue = true
-        commandLine(listOfNotNull(exe.absolutePath, waveformFile?.absolutePath))
+        commandLine(buildList {
+            add(exe.absolutePath)
+            if (waveformFile != null) {
+                addAll(listOf("--waveform", waveformFile.absolutePath))
+                testProperties.traceCycles?.let { addAll(listOf("--trace-cycles", it)) }
+                testProperties.traceMismatch?.let { addAll(listOf("--trace-mismatch", it)) }
+            }
+            testProperties.vectors?.let { addAll(listOf("--vectors", it)) }
+            testProperties.randomVectors?.let { addAll(listOf("--random-vectors", it)) }
+            testProperties.vectorSeed?.let { addAll(listOf("--seed", it)) }
+        })
         errorOutput = runErr
         standardOutput = runErr
     }
@@ -0,0 +1,206 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+// A model, its clock, its reset and its waveform, and the checks made on it. Every wrapper drives its
+// model through one, so they all tick, reset and trace the same way:
+//
+//   int main(int argc, char** argv) {
+//       return runTest<Harness<Vtest>>(argc, argv, [](Harness<Vtest>& h) {
+//           h.reset();
+//           h->i = 1;
+//           h.tick();
+//           h.expectEqual(1u, static_cast<uint32_t>(h->o), "o");
+//       });
+//   }
+
+#include "test_options.h"
+#include "waveform.h"
+
+#include <verilated.h>
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+
+// Half ticks simulated so far, by whichever harness is running. Each test is its own translation
+// unit, so sc_time_stamp, which Verilator expects the wrapper to define, is only defined once.
+inline vluint64_t simTime = 0;
+double sc_time_stamp() { return static_cast<double>(simTime); }
+
+// Tick policies: which clock edge ends a tick. Every wrapper here ends it on the rising edge, so the
+// outputs read after tick() are what the registers just took on; kernel-test's own harness ends it on
+// the falling edge instead.
+struct FallThenRise {
+    template <typename VTop, typename Dump>
+    static void tick(VTop& top, Dump&& dump) {
+        top.clock = 0;
+        top.eval();
+        dump();
+
+        top.clock = 1;
+        top.eval();
+        dump();
+    }
+};
+
+struct RiseThenFall {
+    template <typename VTop, typename Dump>
+    static void tick(VTop& top, Dump&& dump) {
+        top.clock = 1;
+        top.eval();
+        dump();
+
+        top.clock = 0;
+        top.eval();
+        dump();
+    }
+};
+
+// Reset policies: a tick with reset (and enable) held, then a tick to let it go
+struct SyncReset {
+    template <typename H>
+    static void reset(H& h) {
+        h->reset = 1;
+        h->enable = 1;
+        h.tick();
+
+        h->reset = 0;
+        h.tick();
+    }
+};
+
+template <typename VTop, typename TickPolicy = FallThenRise, typename ResetPolicy = SyncReset>
+class Harness {
+public:
+    using Top = VTop;
+
+    // Waits for a replay when tracing the first mismatch (see runTest)
+    explicit Harness(const TraceOptions& trace = TraceOptions{}) : top(std::make_unique<VTop>()) {
+        simTime = 0;
+        if (trace.tracing() && !trace.onMismatch) waveform = std::make_unique<GatedWaveform>(top.get(), trace);
+    }
+
+    ~Harness() { top->final(); }
+
+    Harness(const Harness&) = delete;
+    Harness& operator=(const Harness&) = delete;
+
+    VTop* operator->() { return top.get(); }
+    VTop& operator*() { return *top; }
+
+    // Settles combinational logic on the inputs just driven, without a clock edge
+    void eval() { top->eval(); }
+
+    void tick() {
+        TickPolicy::tick(*top, [this] {
+            if (waveform) waveform->dump(simTime);
+            ++simTime;
+        });
+        ++cycle_;
+    }
+
+    void reset() { ResetPolicy::reset(*this); }
+
+    // Ticks so far, reset included; the cycles TraceOptions count
+    uint64_t cycle() const { return cycle_; }
+
+    // Records a check. describe is only called (to print what went wrong) when it fails, and only for
+    // the first few failures; the rest are just counted.
+    template <typename Describe>
+    bool expect(bool ok, Describe&& describe) {
+        ++checks;
+        if (ok) return true;
+
+        if (failures == 0) firstFailureCycle_ = cycle_ > 0 ? cycle_ - 1 : 0;
+        if (failures < kPrintedFailures && !quiet) {
+            std::ostringstream message;
+            describe(message);
+            std::cerr << "FAIL cycle " << cycle_ << ": " << message.str() << std::endl;
+        }
+        ++failures;
+        return false;
+    }
+
+    template <typename T>
+    bool expectEqual(const T& expected, const T& actual, const char* what) {
+        return expect(expected == actual, [&](std::ostream& out) {
+            out << what << " expected " << expected << ", got " << actual;
+        });
+    }
+
+    template <typename Describe>
+    void fail(Describe&& describe) { expect(false, std::forward<Describe>(describe)); }
+
+    bool passed() const { return failures == 0; }
+
+    // The last tick before the first failing check
+    uint64_t firstFailureCycle() const { return firstFailureCycle_; }
+
+    void report() const {
+        if (failures > kPrintedFailures) std::cerr << "... and " << failures - kPrintedFailures << " more failures" << std::endl;
+        std::cerr << checks << " checks, " << failures << " failed" << std::endl;
+    }
+
+    // Set on a replay, which would only print the same failures again
+    bool quiet = false;
+
+private:
+    static constexpr uint64_t kPrintedFailures = 10;
+
+    std::unique_ptr<VTop> top;
+    std::unique_ptr<GatedWaveform> waveform;
+
+    uint64_t cycle_ = 0;
+
+    uint64_t checks = 0;
+    uint64_t failures = 0;
+    uint64_t firstFailureCycle_ = 0;
+};
+
+// Runs test on a fresh H, traced as the command line asks (see test_options.h), and returns the exit
+// code. A test that takes the TestOptions too gets them, for its vectors. Tracing the first mismatch
+// runs the test untraced, then, if anything failed, again with the waveform narrowed to the first
+// failure - the test has to do the same thing both times.
+template <typename H, typename Test>
+int runTest(int argc, char** argv, Test&& test) {
+    Verilated::commandArgs(argc, argv);
+
+    const TestOptions options = parseTestOptions(argc, argv);
+    const TraceOptions& trace = options.trace;
+
+    auto run = [&](H& h) {
+        if constexpr (std::is_invocable_v<Test&, H&, const TestOptions&>) test(h, options);
+        else test(h);
+    };
+
+    bool passed;
+    uint64_t firstFailureCycle;
+    try {
+        {
+            H h(trace);
+            run(h);
+            h.report();
+
+            passed = h.passed();
+            firstFailureCycle = h.firstFailureCycle();
+        }
+
+        if (!passed && trace.tracing() && trace.onMismatch) {
+            H replay(trace.aroundMismatch(firstFailureCycle));
+            replay.quiet = true;
+            run(replay);
+        }
+    } catch (const std::exception& e) {
+        // A vector file that can't be read, say
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return passed ? 0 : 1;
+}
+
+#endif //HARNESS_H
@@ -0,0 +1,59 @@
+#ifndef HEX_H
+#define HEX_H
+
+// Hex strings as the test vectors write them: an optional 0x, and whitespace anywhere
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+inline std::string sanitizeHex(std::string_view text) {
+    if (text.size() >= 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) text.remove_prefix(2);
+
+    std::string hex;
+    hex.reserve(text.size());
+    for (const char c : text) {
+        if (!std::isspace(static_cast<unsigned char>(c))) hex.push_back(c);
+    }
+    return hex;
+}
+
+inline uint8_t hexNibble(char c) {
+    if (c >= '0' && c <= '9') return static_cast<uint8_t>(c - '0');
+    if (c >= 'a' && c <= 'f') return static_cast<uint8_t>(c - 'a' + 10);
+    if (c >= 'A' && c <= 'F') return static_cast<uint8_t>(c - 'A' + 10);
+    throw std::runtime_error(std::string("Invalid hex digit: ") + c);
+}
+
+inline std::vector<uint8_t> hexToBytes(std::string_view text) {
+    const std::string hex = sanitizeHex(text);
+    if (hex.size() % 2 != 0) {
+        throw std::runtime_error("hexToBytes: odd number of hex digits");
+    }
+
+    std::vector<uint8_t> bytes;
+    bytes.reserve(hex.size() / 2);
+
+    for (std::size_t i = 0; i < hex.size(); i += 2) {
+        bytes.push_back(static_cast<uint8_t>((hexNibble(hex[i]) << 4) | hexNibble(hex[i + 1])));
+    }
+    return bytes;
+}
+
+inline std::string bytesToHex(const std::vector<uint8_t>& bytes) {
+    static constexpr char kHex[] = "0123456789abcdef";
+
+    std::string hex;
+    hex.reserve(bytes.size() * 2);
+    for (const uint8_t b : bytes) {
+        hex.push_back(kHex[(b >> 4) & 0xF]);
+        hex.push_back(kHex[b & 0xF]);
+    }
+    return hex;
+}
+
+#endif //HEX_H
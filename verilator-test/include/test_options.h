@@ -0,0 +1,89 @@
+#ifndef TEST_OPTIONS_H
+#define TEST_OPTIONS_H
+
+// A wrapper's command line, which runSimulation builds from the test's test.properties:
+//
+//   test_<program>_<variation> [--waveform <path>] [--trace-cycles <start>:<stop>] [--trace-mismatch <cycles>]
+//                              [--vectors <file>] [--random-vectors <count>] [--seed <seed>]
+//
+// --trace-cycles dumps cycles [start, stop), either end of which can be left out, and --trace-mismatch
+// the first failing cycle and the given number before it (see waveform.h). --vectors replaces a
+// wrapper's built-in vectors with a file's (see vector_files.h), and --random-vectors adds that many
+// generated from --seed, for the wrappers that can work out what to expect of them (see
+// ReferenceSource in vectors.h). A wrapper ignores the options it has no use for.
+
+#include "waveform.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+struct TestOptions {
+    TraceOptions trace;
+
+    std::string vectorsPath;
+
+    uint64_t randomVectors = 0;
+    uint64_t seed          = 1;
+};
+
+inline uint64_t parseTestNumber(const std::string& option, const std::string& text, uint64_t fallback) {
+    if (text.empty()) return fallback;
+    if (text.find_first_not_of("0123456789") != std::string::npos) {
+        std::cerr << "Invalid value for " << option << ": " << text << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    return std::stoull(text);
+}
+
+inline TestOptions parseTestOptions(int argc, char** argv) {
+    TestOptions options;
+
+    for (int a = 1; a < argc; ++a) {
+        const std::string arg = argv[a];
+
+        // Verilator's own, which commandArgs has already taken
+        if (arg.rfind("+verilator+", 0) == 0) continue;
+
+        if (a + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        const std::string value = argv[++a];
+
+        if (arg == "--waveform") {
+            options.trace.path = value;
+        } else if (arg == "--trace-cycles") {
+            const std::size_t colon = value.find(':');
+            if (colon == std::string::npos) {
+                std::cerr << "Trace cycles look like <start>:<stop>, not " << value << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+            options.trace.startCycle = parseTestNumber(arg, value.substr(0, colon), 0);
+            options.trace.stopCycle  = parseTestNumber(arg, value.substr(colon + 1), UINT64_MAX);
+        } else if (arg == "--trace-mismatch") {
+            options.trace.onMismatch       = true;
+            options.trace.preTriggerCycles = parseTestNumber(arg, value, 0);
+        } else if (arg == "--vectors") {
+            options.vectorsPath = value;
+        } else if (arg == "--random-vectors") {
+            options.randomVectors = parseTestNumber(arg, value, 0);
+        } else if (arg == "--seed") {
+            options.seed = parseTestNumber(arg, value, 1);
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    if ((options.trace.startCycle != 0 || options.trace.stopCycle != UINT64_MAX || options.trace.onMismatch)
+        && !options.trace.tracing()) {
+        std::cerr << "--trace-cycles and --trace-mismatch need a --waveform to write" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    return options;
+}
+
+#endif //TEST_OPTIONS_H
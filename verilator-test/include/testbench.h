@@ -0,0 +1,15 @@
+#ifndef TESTBENCH_H
+#define TESTBENCH_H
+
+// Everything a test wrapper needs: the harness and its command line (harness.h, test_options.h), port
+// values (wide_int.h, hex.h), vector sources (vectors.h, vector_files.h) and waveforms (waveform.h)
+
+#include "harness.h"
+#include "hex.h"
+#include "test_options.h"
+#include "vector_files.h"
+#include "vectors.h"
+#include "waveform.h"
+#include "wide_int.h"
+
+#endif //TESTBENCH_H
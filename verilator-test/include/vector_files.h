@@ -0,0 +1,268 @@
+#ifndef VECTOR_FILES_H
+#define VECTOR_FILES_H
+
+// Test vectors read from a file as the test runs, rather than compiled into the wrapper, so the same
+// executable can be pointed at any number of them (see --vectors in test_options.h). A wrapper
+// describes its vectors' fields once, as a VectorLayout, and turns each VectorRecord into a vector;
+// the file's extension picks its format:
+//
+//   .jsonl  one JSON object per line, each field a hex string: {"i": "0011...", "o": "ffee..."}
+//   .bin    fixed-size records, memory-mapped: each field in layout order, most significant byte first
+//   other   one vector per line, its fields as hex in layout order, separated by whitespace or commas
+//
+// Blank lines, and lines starting with #, are skipped in either text format.
+
+#include "vectors.h"
+#include "wide_int.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct VectorLayout {
+    struct Field {
+        std::string name;
+        std::size_t bytes; // in a .bin record
+    };
+
+    std::vector<Field> fields;
+};
+
+// One vector's fields, by their index in the layout. Only valid until the source reads the next one.
+class VectorRecord {
+public:
+    template <std::size_t Bits>
+    WideInt<Bits> field(std::size_t index) const {
+        if (binary) return WideInt<Bits>::fromBytes(binary + offsets[index], layout->fields[index].bytes);
+        return WideInt<Bits>::fromHex(hex[index]);
+    }
+
+private:
+    template <typename Vector, typename Parse>
+    friend class FileSource;
+
+    const VectorLayout* layout = nullptr;
+
+    std::vector<std::string_view> hex;
+
+    const uint8_t* binary = nullptr;
+    std::vector<std::size_t> offsets;
+};
+
+// A read-only mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Can't open " + path);
+
+        struct stat st{};
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Can't stat " + path);
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+
+        if (size_ > 0) {
+            void* mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Can't map " + path);
+            }
+            // Read front to back, once
+            ::madvise(mapped, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const uint8_t*>(mapped);
+        }
+
+        ::close(fd);
+    }
+
+    ~MappedFile() {
+        if (data_) ::munmap(const_cast<uint8_t*>(data_), size_);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+template <typename Vector, typename Parse>
+class FileSource : public VectorSource<Vector> {
+public:
+    FileSource(const std::string& path, VectorLayout layout, Parse parse)
+        : path(path), layout(std::move(layout)), parse(std::move(parse)) {
+        record.layout = &this->layout;
+
+        if (endsWith(path, ".bin")) {
+            mapped = std::make_unique<MappedFile>(path);
+
+            std::size_t offset = 0;
+            for (const VectorLayout::Field& field : this->layout.fields) {
+                record.offsets.push_back(offset);
+                offset += field.bytes;
+            }
+
+            recordBytes = offset;
+            if (recordBytes == 0 || mapped->size() % recordBytes != 0) {
+                throw std::runtime_error(path + " isn't a whole number of " + std::to_string(recordBytes) + " byte records");
+            }
+        } else {
+            json = endsWith(path, ".jsonl");
+            text.open(path);
+            if (!text) throw std::runtime_error("Can't open " + path);
+        }
+    }
+
+    bool next(Vector& vector) override {
+        if (mapped) {
+            if (position == mapped->size()) return false;
+
+            record.binary = mapped->data() + position;
+            position += recordBytes;
+        } else {
+            if (!readLine()) return false;
+        }
+
+        vector = parse(record);
+        return true;
+    }
+
+private:
+    static bool endsWith(std::string_view text, std::string_view suffix) {
+        return text.size() >= suffix.size() && text.substr(text.size() - suffix.size()) == suffix;
+    }
+
+    static bool isSeparator(char c, bool comma) {
+        return c == ' ' || c == '\t' || c == '\r' || (comma && c == ',');
+    }
+
+    // Reads lines up to the next vector's, and points record at its fields
+    bool readLine() {
+        while (std::getline(text, line)) {
+            ++lineNumber;
+
+            std::size_t start = 0;
+            while (start < line.size() && isSeparator(line[start], false)) ++start;
+            if (start == line.size() || line[start] == '#') continue;
+
+            record.hex.assign(layout.fields.size(), std::string_view{});
+            if (json) parseJsonLine(std::string_view(line).substr(start));
+            else parseHexLine(std::string_view(line).substr(start));
+            return true;
+        }
+
+        return false;
+    }
+
+    void parseHexLine(std::string_view rest) {
+        std::size_t field = 0;
+        while (!rest.empty()) {
+            std::size_t end = 0;
+            while (end < rest.size() && !isSeparator(rest[end], true)) ++end;
+
+            if (end > 0) {
+                if (field == layout.fields.size()) error("more fields than the " + std::to_string(field) + " expected");
+                record.hex[field++] = rest.substr(0, end);
+            }
+
+            rest.remove_prefix(end);
+            while (!rest.empty() && isSeparator(rest.front(), true)) rest.remove_prefix(1);
+        }
+
+        if (field != layout.fields.size()) error(std::to_string(field) + " fields, not " + std::to_string(layout.fields.size()));
+    }
+
+    // Just enough JSON for a flat object of string fields
+    void parseJsonLine(std::string_view rest) {
+        auto skipSpace = [&] { while (!rest.empty() && isSeparator(rest.front(), false)) rest.remove_prefix(1); };
+        auto expectChar = [&](char c) {
+            skipSpace();
+            if (rest.empty() || rest.front() != c) error(std::string("expected '") + c + "'");
+            rest.remove_prefix(1);
+        };
+        auto string = [&] {
+            expectChar('"');
+            const std::size_t end = rest.find('"');
+            if (end == std::string_view::npos) error("unterminated string");
+            const std::string_view value = rest.substr(0, end);
+            rest.remove_prefix(end + 1);
+            return value;
+        };
+
+        std::size_t found = 0;
+
+        expectChar('{');
+        skipSpace();
+        if (!rest.empty() && rest.front() == '}') rest.remove_prefix(1);
+        else {
+            while (true) {
+                const std::string_view name = string();
+                expectChar(':');
+                const std::string_view value = string();
+
+                for (std::size_t f = 0; f < layout.fields.size(); ++f) {
+                    if (layout.fields[f].name == name && record.hex[f].empty()) {
+                        record.hex[f] = value;
+                        ++found;
+                    }
+                }
+
+                skipSpace();
+                if (!rest.empty() && rest.front() == ',') {
+                    rest.remove_prefix(1);
+                    continue;
+                }
+                expectChar('}');
+                break;
+            }
+        }
+
+        if (found != layout.fields.size()) {
+            for (std::size_t f = 0; f < layout.fields.size(); ++f) {
+                if (record.hex[f].empty()) error("no \"" + layout.fields[f].name + "\" field");
+            }
+        }
+    }
+
+    [[noreturn]] void error(const std::string& message) const {
+        throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": " + message);
+    }
+
+    std::string path;
+    VectorLayout layout;
+    Parse parse;
+    VectorRecord record;
+
+    std::unique_ptr<MappedFile> mapped;
+    std::size_t recordBytes = 0;
+    std::size_t position = 0;
+
+    std::ifstream text;
+    bool json = false;
+    std::string line;
+    std::size_t lineNumber = 0;
+};
+
+template <typename Vector, typename Parse>
+std::unique_ptr<VectorSource<Vector>> fileSource(const std::string& path, VectorLayout layout, Parse parse) {
+    return std::make_unique<FileSource<Vector, Parse>>(path, std::move(layout), std::move(parse));
+}
+
+#endif //VECTOR_FILES_H
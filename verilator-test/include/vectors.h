@@ -0,0 +1,109 @@
+#ifndef VECTORS_H
+#define VECTORS_H
+
+// Test vectors, handed out one at a time, so a test streams through them rather than building every
+// input and output up front, and a long list or a generator costs no more memory than a short one.
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+template <typename Vector>
+class VectorSource {
+public:
+    virtual ~VectorSource() = default;
+
+    // Sets vector to the next one, or returns false once there are no more
+    virtual bool next(Vector& vector) = 0;
+};
+
+// Vectors written out in the wrapper
+template <typename Vector>
+class ListSource : public VectorSource<Vector> {
+public:
+    explicit ListSource(std::vector<Vector> vectors) : vectors(std::move(vectors)) {}
+
+    bool next(Vector& vector) override {
+        if (index == vectors.size()) return false;
+        vector = vectors[index++];
+        return true;
+    }
+
+private:
+    std::vector<Vector> vectors;
+    std::size_t index = 0;
+};
+
+// count vectors, the i-th being generate(i)
+template <typename Vector, typename Generate>
+class GeneratedSource : public VectorSource<Vector> {
+public:
+    GeneratedSource(std::size_t count, Generate generate) : count(count), generate(std::move(generate)) {}
+
+    bool next(Vector& vector) override {
+        if (index == count) return false;
+        vector = generate(index++);
+        return true;
+    }
+
+private:
+    std::size_t count;
+    Generate generate;
+    std::size_t index = 0;
+};
+
+template <typename Vector, typename Generate>
+GeneratedSource<Vector, Generate> generatedSource(std::size_t count, Generate generate) {
+    return GeneratedSource<Vector, Generate>(count, std::move(generate));
+}
+
+// count random vectors, each made by generate(rng) and then completed by model(vector), a reference
+// model filling in what the hardware should produce. The same seed always gives the same vectors, so
+// a failure can be replayed (and runTest relies on that to trace one).
+template <typename Vector, typename Generate, typename Model>
+class ReferenceSource : public VectorSource<Vector> {
+public:
+    ReferenceSource(std::size_t count, uint64_t seed, Generate generate, Model model)
+        : count(count), rng(seed), generate(std::move(generate)), model(std::move(model)) {}
+
+    bool next(Vector& vector) override {
+        if (index == count) return false;
+        vector = generate(rng);
+        model(vector);
+        ++index;
+        return true;
+    }
+
+private:
+    std::size_t count;
+    std::mt19937_64 rng;
+    Generate generate;
+    Model model;
+    std::size_t index = 0;
+};
+
+template <typename Vector, typename Generate, typename Model>
+ReferenceSource<Vector, Generate, Model> referenceSource(std::size_t count, uint64_t seed, Generate generate, Model model) {
+    return ReferenceSource<Vector, Generate, Model>(count, seed, std::move(generate), std::move(model));
+}
+
+// One vector a cycle: drive(h, vector), a tick, then check(h, vector) on the outputs it produced.
+// Returns how many vectors there were.
+template <typename H, typename Vector, typename Drive, typename Check>
+std::size_t streamVectors(H& h, VectorSource<Vector>& source, Drive&& drive, Check&& check) {
+    std::size_t count = 0;
+
+    Vector vector;
+    while (source.next(vector)) {
+        drive(h, vector);
+        h.tick();
+        check(h, vector);
+        ++count;
+    }
+
+    return count;
+}
+
+#endif //VECTORS_H
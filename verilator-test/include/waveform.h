@@ -0,0 +1,101 @@
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+// Waveform tracing shared by the test wrappers, which runSimulation builds with this directory on the
+// include path.
+//
+// Verilator builds a model to trace in one format: VCD with --trace (the default), or FST with
+// --trace-fst (a test.properties' waveformFormat=fst), which also defines VM_TRACE_FST. Either
+// way, only the cycles asked for are dumped (--trace-cycles and --trace-mismatch, see
+// test_options.h), so a long test can leave tracing on.
+//
+// Cycles count ticks from the first (reset included). Tracing the first mismatch dumps nothing on the
+// first run: if the test fails, runTest (harness.h) replays it (it's deterministic) with the window
+// narrowed to the first failing cycle and the given number of cycles before it - see
+// TraceOptions::aroundMismatch.
+
+#include <verilated.h>
+
+#if VM_TRACE_FST
+#include <verilated_fst_c.h>
+#elif VM_TRACE
+#include <verilated_vcd_c.h>
+#endif
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+struct TraceOptions {
+    std::string path;
+
+    uint64_t startCycle = 0;
+    uint64_t stopCycle  = UINT64_MAX;
+
+    bool     onMismatch       = false;
+    uint64_t preTriggerCycles = 0;
+
+    bool tracing() const { return !path.empty(); }
+
+    // The options for replaying a run to trace a mismatch found just after mismatchCycle: that cycle,
+    // and the one after it, where inputs driven between the two first show up
+    TraceOptions aroundMismatch(uint64_t mismatchCycle) const {
+        TraceOptions replay = *this;
+        replay.onMismatch = false;
+        replay.startCycle = mismatchCycle > preTriggerCycles ? mismatchCycle - preTriggerCycles : 0;
+        replay.stopCycle  = mismatchCycle + 2;
+        return replay;
+    }
+};
+
+#if VM_TRACE
+
+// A waveform that only dumps the cycles its TraceOptions let through
+class GatedWaveform {
+public:
+#if VM_TRACE_FST
+    using Trace = VerilatedFstC;
+#else
+    using Trace = VerilatedVcdC;
+#endif
+
+    template <typename VTop>
+    GatedWaveform(VTop* top, const TraceOptions& options) : options(options) {
+        Verilated::traceEverOn(true);
+        top->trace(&trace, 99); // trace depth
+        trace.open(options.path.c_str());
+    }
+
+    ~GatedWaveform() { trace.close(); }
+
+    GatedWaveform(const GatedWaveform&) = delete;
+    GatedWaveform& operator=(const GatedWaveform&) = delete;
+
+    // Two dumps per tick, so the cycle's half the time
+    void dump(vluint64_t time) {
+        const uint64_t cycle = time / 2;
+        if (options.onMismatch || cycle < options.startCycle || cycle >= options.stopCycle) return;
+        trace.dump(time);
+    }
+
+private:
+    TraceOptions options;
+    Trace trace;
+};
+
+#else
+
+// Without waveform=true, the model's built without tracing, and runSimulation doesn't ask for one
+class GatedWaveform {
+public:
+    template <typename VTop>
+    GatedWaveform(VTop*, const TraceOptions& options) {
+        std::cerr << "Not writing " << options.path << ": the model was built without tracing" << std::endl;
+    }
+
+    void dump(vluint64_t) {}
+};
+
+#endif
+
+#endif //WAVEFORM_H
@@ -0,0 +1,136 @@
+#ifndef WIDE_INT_H
+#define WIDE_INT_H
+
+// Fixed-width values for ports of any width, laid out the way Verilator lays them out: 32-bit words,
+// least significant first. Ports up to 64 bits wide are plain integers in the model; wider ones are
+// VlWide arrays (or WData arrays, before Verilator 5), which drive/sample copy whole, rather than a
+// word at a time.
+
+#include "hex.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+template <std::size_t Bits>
+class WideInt {
+    static_assert(Bits > 0, "WideInt needs at least one bit");
+
+public:
+    static constexpr std::size_t Words = (Bits + 31) / 32;
+    static constexpr std::size_t Digits = (Bits + 3) / 4;
+
+    constexpr WideInt() = default;
+
+    constexpr explicit WideInt(uint64_t value) {
+        words_[0] = static_cast<uint32_t>(value);
+        if constexpr (Words > 1) words_[1] = static_cast<uint32_t>(value >> 32);
+        mask();
+    }
+
+    // Most significant digit first, and right-aligned: a short string is zero-extended
+    static WideInt fromHex(std::string_view text) {
+        const std::string hex = sanitizeHex(text);
+        if (hex.size() > Digits) {
+            throw std::runtime_error("WideInt<" + std::to_string(Bits) + ">: hex string " + hex + " is too wide");
+        }
+
+        WideInt value;
+        for (std::size_t d = 0; d < hex.size(); ++d) {
+            const std::size_t nibble = hex.size() - 1 - d;
+            value.words_[nibble / 8] |= static_cast<uint32_t>(hexNibble(hex[d])) << (4 * (nibble % 8));
+        }
+        value.checkFits();
+        return value;
+    }
+
+    // Most significant byte first, and right-aligned like fromHex
+    static WideInt fromBytes(const uint8_t* bytes, std::size_t count) {
+        if (count > (Bits + 7) / 8) {
+            throw std::runtime_error("WideInt<" + std::to_string(Bits) + ">: " + std::to_string(count) + " bytes is too wide");
+        }
+
+        WideInt value;
+        for (std::size_t b = 0; b < count; ++b) {
+            const std::size_t byte = count - 1 - b;
+            value.words_[byte / 4] |= static_cast<uint32_t>(bytes[b]) << (8 * (byte % 4));
+        }
+        value.checkFits();
+        return value;
+    }
+
+    static WideInt fromBytes(const std::vector<uint8_t>& bytes) { return fromBytes(bytes.data(), bytes.size()); }
+
+    // Digits digits, most significant first
+    std::string toHex() const {
+        static constexpr char kHex[] = "0123456789abcdef";
+
+        std::string hex(Digits, '0');
+        for (std::size_t nibble = 0; nibble < Digits; ++nibble) {
+            hex[Digits - 1 - nibble] = kHex[(words_[nibble / 8] >> (4 * (nibble % 8))) & 0xF];
+        }
+        return hex;
+    }
+
+    constexpr uint32_t word(std::size_t w) const { return words_[w]; }
+    constexpr const std::array<uint32_t, Words>& words() const { return words_; }
+    constexpr std::array<uint32_t, Words>& words() { return words_; }
+
+    constexpr uint64_t low64() const {
+        uint64_t value = words_[0];
+        if constexpr (Words > 1) value |= static_cast<uint64_t>(words_[1]) << 32;
+        return value;
+    }
+
+    friend constexpr bool operator==(const WideInt& a, const WideInt& b) { return a.words_ == b.words_; }
+    friend constexpr bool operator!=(const WideInt& a, const WideInt& b) { return !(a == b); }
+
+    friend std::ostream& operator<<(std::ostream& out, const WideInt& value) { return out << "0x" << value.toHex(); }
+
+private:
+    static constexpr uint32_t kTopMask = Bits % 32 == 0 ? 0xFFFFFFFFu : (1u << (Bits % 32)) - 1;
+
+    constexpr void mask() { words_[Words - 1] &= kTopMask; }
+
+    void checkFits() const {
+        if ((words_[Words - 1] & ~kTopMask) != 0) {
+            throw std::runtime_error("WideInt<" + std::to_string(Bits) + ">: value is too wide");
+        }
+    }
+
+    std::array<uint32_t, Words> words_{};
+};
+
+// Drives a model's input port with value
+template <typename Port, std::size_t Bits>
+void drive(Port& port, const WideInt<Bits>& value) {
+    if constexpr (std::is_arithmetic_v<Port>) {
+        static_assert(Bits <= 64, "A port this narrow can't hold the value");
+        port = static_cast<Port>(value.low64());
+    } else {
+        static_assert(sizeof(Port) == WideInt<Bits>::Words * sizeof(uint32_t), "Port and value widths differ");
+        std::memcpy(&port[0], value.words().data(), sizeof(Port));
+    }
+}
+
+// Reads a model's output port
+template <std::size_t Bits, typename Port>
+WideInt<Bits> sample(const Port& port) {
+    if constexpr (std::is_arithmetic_v<Port>) {
+        static_assert(Bits <= 64, "A port this narrow can't hold the value");
+        return WideInt<Bits>(static_cast<uint64_t>(port));
+    } else {
+        static_assert(sizeof(Port) == WideInt<Bits>::Words * sizeof(uint32_t), "Port and value widths differ");
+        WideInt<Bits> value;
+        std::memcpy(value.words().data(), &port[0], sizeof(Port));
+        return value;
+    }
+}
+
+#endif //WIDE_INT_H
@@ -1,26 +1,11 @@
 #include "Vtest.h"
-#include <verilated.h>
+#include "testbench.h"
+
 #include <cstdint>
-#include <iostream>
-#include <memory>
-#include <random>
+#include <string>
 #include <vector>
-#include <functional>
-
-// Simple simulation time for Verilator
-static vluint64_t sim_time = 0;
-double sc_time_stamp() { return sim_time; }
 
-// One clock tick: 0 -> 1 -> 0 with evals
-static void tick(Vtest* top) {
-    top->clock = 0;
-    top->eval();
-    ++sim_time;
-
-    top->clock = 1;
-    top->eval();
-    ++sim_time;
-}
+using TestHarness = Harness<Vtest>;
 
 // Input interface struct
 struct InputInterface {
@@ -28,69 +13,6 @@ struct InputInterface {
     bool last;       // 1-bit signal
 };
 
-// Output interface struct
-struct OutputInterface {
-    bool value;      // 1-bit output value
-    bool valid;      // 1-bit valid signal
-};
-
-// Simulation function
-std::vector<OutputInterface> simulate(
-    Vtest* top,
-    const std::vector<InputInterface>& inputs,
-    std::function<bool(const OutputInterface&)> stopCondition
-) {
-    std::vector<OutputInterface> outputs;
-    
-    // Initialize signals
-    top->reset = 1;   // assert reset initially
-    top->enable = 1;  // keep enabled
-    top->i__024value = 0;
-    top->i__024last  = 0;
-    tick(top);
-
-    // Finish reset
-    top->reset = 0;
-    tick(top);
-
-    OutputInterface currentOutput;
-    size_t input_index = 0;
-    bool shouldStop = false;
-
-    do {
-        // Apply input
-        if (input_index < inputs.size()) {
-            top->i__024value = inputs[input_index].value;
-            top->i__024last = inputs[input_index].last;
-
-            input_index++;
-        }
-
-        top->eval();
-
-        // Capture output
-        OutputInterface output = {
-            .value = static_cast<bool>(top->o__024value),
-            .valid = static_cast<bool>(top->o__024valid)
-        };
-
-        // Save output
-        outputs.push_back(output);
-
-        // Check the stop condition
-        shouldStop = stopCondition(output);
-
-        // Advance the simulation
-        tick(top);
-    } while (!shouldStop);
-    
-    return outputs;
-}
-
-bool isValidOutput(const OutputInterface& output) {
-    return output.valid;
-}
-
 std::vector<InputInterface> createInputsForString(const std::string &input) {
     std::vector<InputInterface> inputs;
     // Process string in chunks of 3 characters (3x8 = 24 bits)
@@ -117,78 +39,38 @@ std::vector<InputInterface> createInputsForString(const std::string &input) {
     return inputs;
 }
 
-// Check if simulation was successful
-bool checkSimulationSuccess(
-    const std::vector<InputInterface>& inputs,
-    const std::vector<OutputInterface>& outputs
-) {
-    // Look for an output with valid=true
-    for (const auto& output : outputs) {
-        if (output.valid) {
-            if (output.value) {
-                return true;
-            } else {
-                std::cerr << "Test 1: Unexpected output value" << std::endl;
-                return false;
-            }
+// Streams input's characters in, from reset, until the first valid output, and checks it's expected
+static void checkString(TestHarness& h, const std::string& input, bool expected) {
+    h->i__024value = 0;
+    h->i__024last  = 0;
+    h.reset();
+
+    ListSource<InputInterface> source(createInputsForString(input));
+
+    // Once the input runs out, the last chunk stays on the input until the output's valid
+    InputInterface in{};
+    while (true) {
+        source.next(in);
+        h->i__024value = in.value;
+        h->i__024last  = in.last;
+
+        h.eval();
+
+        if (h->o__024valid) {
+            h.expect(static_cast<bool>(h->o__024value) == expected, [&](std::ostream& message) {
+                message << "\"" << input << "\": expected " << (expected ? "valid" : "invalid")
+                        << ", got " << (expected ? "invalid" : "valid");
+            });
+            return;
         }
-    }
 
-    std::cerr << "Test 1: No output value found" << std::endl;
-    return false;
-}
-
-// Check if simulation was successful
-bool checkSimulationFailure(
-    const std::vector<InputInterface>& inputs,
-    const std::vector<OutputInterface>& outputs
-) {
-    // Look for an output with valid=true
-    for (const auto& output : outputs) {
-        if (output.valid) {
-            if (!output.value) {
-                return true;
-            } else {
-                std::cerr << "Test 2: Unexpected output value" << std::endl;
-                return false;
-            }
-        }
+        h.tick();
     }
-
-    std::cerr << "Test 2: No output value found" << std::endl;
-    return false;
 }
 
 int main(int argc, char** argv) {
-    Verilated::commandArgs(argc, argv);
-
-    Vtest* top = new Vtest();
-
-
-    // Create input sequence from a test string
-    std::string testString1 = "USER@DOMAIN.COM";
-    std::vector<InputInterface> inputs1 = createInputsForString(testString1);
-
-    // Run simulation with the isValidOutput stop condition
-    std::vector<OutputInterface> outputs1 = simulate(top, inputs1, isValidOutput);
-
-
-    // Create input sequence from a test string
-    std::string testString2 = "NOT AN EMAIL";
-    std::vector<InputInterface> inputs2 = createInputsForString(testString2);
-
-    // Run simulation with the isValidOutput stop condition
-    std::vector<OutputInterface> outputs2 = simulate(top, inputs2, isValidOutput);
-
-
-    top->final();
-    delete top;
-
-    bool testPass = checkSimulationSuccess(inputs1, outputs1) && checkSimulationFailure(inputs2, outputs2);
-
-    if (testPass) {
-        return 0;
-    } else {
-        return 1;
-    }
+    return runTest<TestHarness>(argc, argv, [](TestHarness& h) {
+        checkString(h, "USER@DOMAIN.COM", true);
+        checkString(h, "NOT AN EMAIL", false);
+    });
 }
@@ -1,157 +1,88 @@
 #include "Vtest.h"
-#include <verilated.h>
+#include "testbench.h"
+
 #include <cstdint>
-#include <iostream>
-#include <memory>
 #include <random>
-#include <vector>
-#include <functional>
-
-// Simple simulation time for Verilator
-static vluint64_t sim_time = 0;
-double sc_time_stamp() { return sim_time; }
 
-// One clock tick: 0 -> 1 -> 0 with evals
-static void tick(Vtest* top) {
-    top->clock = 0;
-    top->eval();
-    ++sim_time;
+using TestHarness = Harness<Vtest>;
 
-    top->clock = 1;
-    top->eval();
-    ++sim_time;
-}
-
-// Input interface struct
-struct InputInterface {
+struct TestVector {
     uint32_t selector;
     uint32_t i1;
     uint32_t i2;
+    uint32_t expected_o;
 };
 
-// Output interface struct
-struct OutputInterface {
-    uint32_t o;      // 1-bit output value
-};
-
-// Simulation function
-std::vector<OutputInterface> simulate(
-    Vtest* top,
-    const std::vector<InputInterface>& inputs
-) {
-    std::vector<OutputInterface> outputs;
-    
-    // Initialize signals
-    top->reset = 1;   // assert reset initially
-    top->enable = 1;  // keep enabled
-    top->selector = 0;
-    top->i1 = 0;
-    top->i2 = 0;
-    tick(top);
-
-    // Finish reset
-    top->reset = 0;
-    tick(top);
-
-    OutputInterface currentOutput;
-
-    for (size_t i = 0; i < inputs.size(); i++) {
-        top->selector = inputs[i].selector;
-        top->i1 = inputs[i].i1;
-        top->i2 = inputs[i].i2;
-
-        top->eval();
-
-        // Capture output
-        OutputInterface output = {
-            .o = static_cast<uint32_t>(top->o),
-        };
-
-        // Save output
-        outputs.push_back(output);
+// The reference model, on the design's 8-bit ports
+static uint32_t expectedOutput(const TestVector& in) {
+    switch (in.selector) {
+        case 0:
+            return (in.i1 + in.i2) & 0xFF;
+        case 1:
+            return (in.i1 * in.i2) & 0xFF;
+        case 2:
+            return (in.i1 - in.i2) & 0xFF;
+        case 3:
+            return in.i1 & in.i2;
+        default:
+            return 0;
     }
-
-    return outputs;
 }
 
-// Check if simulation was successful
-bool checkSimulationSuccess(
-    const std::vector<InputInterface>& inputs,
-    const std::vector<OutputInterface>& outputs
-) {
-    if (outputs.size() != inputs.size()) {
-        std::cerr << "Test Error: Inputs does not match outputs" << std::endl;
-        exit(1);
-    }
-
-    // Zip inputs and outputs into pairs
-    std::vector<std::pair<InputInterface, OutputInterface>> zipped;
-    zipped.reserve(inputs.size());
-    for (size_t i = 0; i < inputs.size(); ++i) {
-        zipped.emplace_back(inputs[i], outputs[i]);
-    }
-
-    for (const auto& pair : zipped) {
-        const InputInterface& in = pair.first;
-        const OutputInterface& out = pair.second;
-
-        uint32_t expected = 0;
-
-        switch (in.selector) {
-            case 0:
-                expected = in.i1 + in.i2;
-                break;
-            case 1:
-                expected = in.i1 * in.i2;
-                break;
-            case 2:
-                expected = in.i1 - in.i2;
-                break;
-            case 3:
-                expected = in.i1 & in.i2;
-                break;
-        }
-
-        if (out.o != expected) {
-            std::cerr << "Test Error: Output does not match expected,"
-                << " selector: " << in.selector
-                << " i1: " << in.i1
-                << " i2: " << in.i2
-                << " o: " << out.o
-                << " expected: " << expected
-                << std::endl;
-
-            return false;
-        }
-    }
-
-    return true;
+static TestVector testVector(uint32_t selector, uint32_t i1, uint32_t i2) {
+    TestVector vector{selector, i1, i2, 0};
+    vector.expected_o = expectedOutput(vector);
+    return vector;
 }
 
 int main(int argc, char** argv) {
-    Verilated::commandArgs(argc, argv);
-
-    Vtest* top = new Vtest();
+    return runTest<TestHarness>(argc, argv, [](TestHarness& h, const TestOptions& options) {
+        h->selector = 0;
+        h->i1 = 0;
+        h->i2 = 0;
+        h.reset();
+
+        // Combinational, so each vector's checked as soon as it settles, without a tick
+        auto check = [&h](const TestVector& in) {
+            h->selector = in.selector;
+            h->i1 = in.i1;
+            h->i2 = in.i2;
+
+            h.eval();
+
+            const uint32_t out = static_cast<uint32_t>(h->o);
+            h.expect(out == in.expected_o, [&](std::ostream& message) {
+                message << "Output does not match expected,"
+                        << " selector: " << in.selector
+                        << " i1: " << in.i1
+                        << " i2: " << in.i2
+                        << " o: " << out
+                        << " expected: " << in.expected_o;
+            });
+        };
 
-    std::vector<InputInterface> inputs;
-    for (uint32_t selector = 0; selector <= 3; ++selector) {
-        for (uint32_t lhs = 0; lhs <= 9; ++lhs) {
-            for (uint32_t rhs = 0; rhs <= lhs; ++rhs) {
-                inputs.push_back(InputInterface{selector, lhs, rhs});
+        for (uint32_t selector = 0; selector <= 3; ++selector) {
+            for (uint32_t lhs = 0; lhs <= 9; ++lhs) {
+                for (uint32_t rhs = 0; rhs <= lhs; ++rhs) {
+                    check(testVector(selector, lhs, rhs));
+                }
             }
         }
-    }
 
-    std::vector<OutputInterface> outputs = simulate(top, inputs);
-
-    top->final();
-    delete top;
-
-    bool testPass = checkSimulationSuccess(inputs, outputs);
-
-    if (testPass) {
-        return 0;
-    } else {
-        return 1;
-    }
+        // Then any random ones asked for, over every selector and operand
+        auto random = referenceSource<TestVector>(options.randomVectors, options.seed,
+            [](std::mt19937_64& rng) {
+                return TestVector{
+                    .selector   = static_cast<uint32_t>(rng() & 0x3),
+                    .i1         = static_cast<uint32_t>(rng() & 0xFF),
+                    .i2         = static_cast<uint32_t>(rng() & 0xFF),
+                    .expected_o = 0, // the model fills it in
+                };
+            },
+            [](TestVector& vector) { vector.expected_o = expectedOutput(vector); }
+        );
+
+        TestVector vector;
+        while (random.next(vector)) check(vector);
+    });
 }